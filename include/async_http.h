@@ -0,0 +1,151 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Non-blocking HTTP/1.1 GET (and POST) over BSD sockets: lwIP on the device, Linux on the host, where the
+// tools build it unchanged to test and benchmark it.
+//
+// A request is a state machine that poll() advances as far as it can without waiting, so one task
+// can keep several requests in flight and go on drawing in between; asyncHttpWait() sleeps in
+// select() until one of them can move. An AsyncHttp object is about 2.5 KB, mostly the request
+// buffer, and needs no stack of its own. The body goes to a sink as it arrives, plain or chunked.
+// HTTPS runs mbedTLS over the same non-blocking socket (device builds only; like
+// WiFiClientSecure::setInsecure() the certificate is not checked). Connections are kept alive and
+// reused by the next request to the same host, with one retry if the server had closed it.
+// Names are resolved with lwIP's asynchronous dns_gethostbyname() on the device, polled like the
+// other phases (host builds call getaddrinfo(), which blocks), and cached for AHTTP_DNS_TTL.
+
+const size_t AHTTP_REQUEST_MAX = 2048;      // Request line and headers
+const size_t AHTTP_READ_CHUNK = 1024;       // Bytes read per call, from the caller's stack
+const uint32_t AHTTP_DNS_TTL = 600000;      // ms
+const uint32_t AHTTP_DNS_POLL = 10;         // asyncHttpWait() wakes this often while a name is looked up
+
+typedef enum {
+  AHTTP_IDLE,
+  AHTTP_RESOLVING,
+  AHTTP_CONNECTING,
+  AHTTP_HANDSHAKE,                          // TLS
+  AHTTP_SENDING,
+  AHTTP_HEADERS,
+  AHTTP_BODY,
+  AHTTP_DONE,
+  AHTTP_FAILED,
+} ahttp_state;
+
+// status() of a failed request. Negative, like HTTPClient's errors.
+typedef enum {
+  AHTTP_ERROR_URL = -1,
+  AHTTP_ERROR_DNS = -2,
+  AHTTP_ERROR_CONNECT = -3,
+  AHTTP_ERROR_TLS = -4,
+  AHTTP_ERROR_SEND = -5,
+  AHTTP_ERROR_RECEIVE = -6,
+  AHTTP_ERROR_CLOSED = -7,                  // Connection closed before the end of the response
+  AHTTP_ERROR_PROTOCOL = -8,                // Not an HTTP response we understand
+  AHTTP_ERROR_TIMEOUT = -9,
+  AHTTP_ERROR_SINK = -10,                   // The sink refused the body
+} ahttp_error;
+
+// Receives the body as it arrives. Returning false aborts the request.
+typedef bool (*ahttp_sink)(void *ctx, const uint8_t *data, size_t len);
+
+class AsyncHttp {
+public:
+  AsyncHttp();
+  ~AsyncHttp();
+  AsyncHttp(const AsyncHttp &) = delete;
+  AsyncHttp &operator=(const AsyncHttp &) = delete;
+
+  // Phase timeouts, in ms. The read timeout applies between two reads of the response.
+  void setConnectTimeout(uint32_t ms) { _connectTimeout = ms; }
+  void setHandshakeTimeout(uint32_t ms) { _handshakeTimeout = ms; }
+  void setTimeout(uint32_t ms) { _readTimeout = ms; }
+
+  // Start a GET of url ("http://" or "https://"). now_ms is the caller's millisecond clock.
+  // Returns false, with status() set, if it could not even start.
+  bool get(const char *url, ahttp_sink sink, void *ctx, uint32_t now_ms);
+
+  // Start a POST of len bytes of payload, which must stay valid until the request is done
+  bool post(const char *url, const char *content_type, const uint8_t *payload, size_t len, ahttp_sink sink,
+            void *ctx, uint32_t now_ms);
+
+  // Advance without blocking; returns the new state
+  ahttp_state poll(uint32_t now_ms);
+
+  // Abort the request and close the connection
+  void stop();
+
+  ahttp_state state() const { return _state; }
+  bool busy() const { return _state != AHTTP_IDLE && _state != AHTTP_DONE && _state != AHTTP_FAILED; }
+  int status() const { return _status; }    // HTTP status, or an ahttp_error
+  int64_t contentLength() const { return _contentLength; }
+  size_t received() const { return _received; }
+  bool reused() const { return _reused; }   // Sent over a connection kept from an earlier request
+
+  // For asyncHttpWait()
+  int fd() const { return _fd; }
+  bool wantsWrite() const;
+  bool readable() const;                    // Data already buffered (decrypted TLS), no need to wait
+
+private:
+  enum body_mode { BODY_NONE, BODY_LENGTH, BODY_CHUNKED, BODY_CLOSE };
+  enum chunk_state { CHUNK_SIZE, CHUNK_DATA, CHUNK_DATA_END, CHUNK_TRAILER };
+
+  bool start(const char *method, const char *url, const char *content_type, const uint8_t *payload, size_t len,
+             ahttp_sink sink, void *ctx, uint32_t now_ms);
+  bool connectStart(uint32_t now_ms);
+  bool stepResolve(uint32_t now_ms);
+  bool openSocket(const struct in_addr &addr);
+  bool stepConnect();
+  bool stepHandshake();
+  bool stepSend();
+  bool stepReceive();
+  void consume(const uint8_t *data, size_t len);
+  void headerLine();
+  void finish();
+  void fail(int error);
+  void closeConnection();
+  bool retryStale(uint32_t now_ms);
+  int ioRead(uint8_t *buf, size_t len);
+  int ioWrite(const uint8_t *buf, size_t len);
+  uint32_t phaseTimeout() const;
+
+  ahttp_state _state = AHTTP_IDLE;
+  int _status = 0;
+  int _fd = -1;
+  void *_tls = nullptr;
+  bool _https = false;
+  char _host[64] = "";
+  uint16_t _port = 0;
+  char _request[AHTTP_REQUEST_MAX];
+  size_t _requestLen = 0;
+  const uint8_t *_payload = nullptr;        // The caller's, for a POST
+  size_t _payloadLen = 0;
+  size_t _sent = 0;                         // Of the request, then the payload
+  ahttp_sink _sink = nullptr;
+  void *_ctx = nullptr;
+  uint32_t _since = 0;                      // Last progress
+  uint32_t _connectTimeout = 5000;
+  uint32_t _handshakeTimeout = 8000;
+  uint32_t _readTimeout = 5000;
+
+  char _line[256];                          // Header or chunk size line being read
+  size_t _lineLen = 0;
+  body_mode _body = BODY_NONE;
+  chunk_state _chunk = CHUNK_SIZE;
+  int64_t _contentLength = -1;
+  uint64_t _remaining = 0;
+  size_t _received = 0;
+  bool _chunked = false;
+  bool _keepAlive = true;
+  bool _reused = false;
+  bool _retried = false;
+  bool _responded = false;                  // Some of the response arrived
+};
+
+// Sleep until one of the busy requests can make progress, or timeout_ms passes.
+// Returns the number of requests that are ready.
+int asyncHttpWait(AsyncHttp *const *requests, int count, uint32_t timeout_ms);
+
+const char *asyncHttpErrorName(int status);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+const uint32_t BACKLIGHT_FULL_MA = 20;     // Approximate backlight current at full brightness
+
+// LEDC PWM backlight. Brightness follows a schedule keyed to US market hours (local time must
+// be set to the exchange's timezone) and changes with hardware fades, so no CPU time is spent
+// ramping. A press on BTN_PIN brings the backlight to full brightness instantly for a while.
+
+void backlightBegin();
+
+// Re-evaluate the schedule and start a fade if the target changed. Call every frame.
+void backlightPoll();
+
+// Average backlight duty since boot, in percent of full brightness
+uint32_t backlightAverageDuty();
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "candles.h"
+
+// Candlestick chart of one symbol with a previous close reference line. Repeated calls for the
+// same symbol and width only repaint the current candle's column, until its bucket rolls over
+// or it grows out of the drawn price range.
+
+// Draw the candle page for watchlist entry symbol; full forces a complete redraw. Returns false
+// (and draws nothing) when there are no candles for it yet.
+bool drawCandlePage(int symbol, candle_interval interval, bool full);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// OHLC candles aggregated on the fly from the quote stream, at several bucket widths at once.
+// A tick only touches the current candle of each width; a tick in a new bucket starts a new
+// candle and drops the oldest one. Buckets are aligned to multiples of their width.
+// No Arduino dependencies, so it can be built on the host.
+
+typedef enum {
+  CANDLE_1M,
+  CANDLE_5M,
+  CANDLE_15M,
+  CANDLE_INTERVALS
+} candle_interval;
+
+const uint32_t CANDLE_SECONDS[CANDLE_INTERVALS] = { 60, 5 * 60, 15 * 60 };
+const int CANDLE_COUNT = 32;                // Candles kept per symbol and width, one screen full
+
+typedef struct {
+  uint32_t start;                           // Bucket start time (seconds)
+  float open, high, low, close;
+} candle;
+
+// Reserve room for series symbols. Returns false if the memory is not available.
+bool candlesBegin(int series);
+
+// Fold one tick at time t (seconds) into the current candle of every width
+void candlesAdd(int series, uint32_t t, double price);
+
+// Candles held for a series and width; index 0 is the oldest, count - 1 the current one
+int candlesCount(int series, candle_interval interval);
+const candle &candleAt(int series, candle_interval interval, int index);
+
+// Forget everything, e.g. when the watchlist changes
+void candlesClear();
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// Line chart of one symbol's history, downsampled with LTTB to one point per pixel column
+
+typedef enum {
+  ZOOM_HOURS,                 // Last 2 hours
+  ZOOM_DAY,                   // Last 24 hours
+  ZOOM_WEEK,                  // Last 5 days
+  ZOOM_LEVELS
+} chart_zoom;
+
+// Draw the chart page for watchlist entry symbol. Returns false (and draws nothing) when
+// there is not enough history yet.
+bool drawChartPage(int symbol, chart_zoom zoom);
+
+// Drop the cached downsampled series, e.g. when the watchlist changes
+void chartReset();
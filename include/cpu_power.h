@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+// Dynamic CPU frequency scaling. The CPU idles at CPU_IDLE_MHZ and is boosted to CPU_BOOST_MHZ
+// while a CpuBoost object is alive, around TLS handshakes, JSON parsing and frame rendering.
+// Uses ESP-IDF power management locks when the SDK is built with CONFIG_PM_ENABLE, and plain
+// setCpuFrequencyMhz() otherwise. Build with -D CPU_DFS=0 to stay at full speed for comparison.
+
+#ifndef CPU_DFS
+#define CPU_DFS 1
+#endif
+
+const int CPU_IDLE_MHZ = 80;
+const int CPU_BOOST_MHZ = 240;
+
+void cpuPowerBegin();
+
+// Time spent at each frequency since boot, in ms. Without working DFS it is all full speed.
+uint32_t cpuPowerIdleMs();
+uint32_t cpuPowerBoostMs();
+
+// Estimated average CPU current in mA since boot, from the time spent at each frequency
+uint32_t cpuPowerAverageMa();
+
+void cpuBoostAcquire();
+void cpuBoostRelease();
+
+// Holds the CPU at full speed for the lifetime of the object. Boosts nest.
+class CpuBoost {
+public:
+  CpuBoost() { cpuBoostAcquire(); }
+  ~CpuBoost() { cpuBoostRelease(); }
+  CpuBoost(const CpuBoost &) = delete;
+  CpuBoost &operator=(const CpuBoost &) = delete;
+};
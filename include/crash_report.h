@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+// Post-mortem crash reports. The panic handler writes a core dump to the coredump partition;
+// on the next boot a compact summary (PC, backtrace, heap state, last trace events) is built
+// from it, kept in NVS and POSTed as JSON to the collector URL once Wi-Fi is up. tools/crash_decode.py
+// symbolises the report against the firmware ELF.
+
+// Things worth knowing about the last seconds before a crash. Kept in RTC memory, which
+// survives a software reset.
+typedef enum : uint8_t {
+  TRACE_BOOT,
+  TRACE_FETCH_START,
+  TRACE_FETCH_DONE,           // arg: HTTP status (negative for transport errors)
+  TRACE_PARSE_DONE,           // arg: 1 if the quotes were updated
+  TRACE_RENDER,               // arg: page
+  TRACE_WIFI,                 // arg: provisioning state
+  TRACE_RECOVERY,             // arg: recovery step
+  TRACE_EVENTS
+} trace_event;
+
+// Record an event in the trace ring. Cheap enough for the hot path.
+void crashTrace(trace_event event, int32_t arg = 0);
+
+// Turn a crash of the previous run into a pending report. Call early in setup().
+void crashReportBegin();
+
+// Upload a pending report when connected. Call from loop(); does nothing most of the time.
+void crashReportPoll(bool connected);
+
+// Where reports are POSTed (e.g. http://192.168.1.10:8080/crash). Empty disables uploading.
+void crashReportSetCollector(const char *url);
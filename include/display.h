@@ -0,0 +1,7 @@
+#pragma once
+
+#include "render_stats.h"
+
+// The screen, shared by the page renderers. It is rotated to landscape, so it is
+// TFT_HEIGHT pixels wide and TFT_WIDTH pixels high.
+extern CountingTFT tft;
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "async_http.h"
+
+// Request broker between the code that wants data and the HTTP connections. Callers submit
+// items (symbols) to an endpoint, a URL prefix the items are appended to comma separated;
+// the broker batches everything queued for an endpoint into as few URLs as fit BROKER_URL_MAX,
+// asks only once for an item that is already queued or in flight, starts requests in priority
+// order on up to BROKER_SLOTS AsyncHttp connections and keeps every host within its token
+// bucket and connection limit. No Arduino dependencies, so the tools build it on the host.
+
+#ifndef BROKER_URL_MAX
+#define BROKER_URL_MAX 1536                 // Leaves the rest of AHTTP_REQUEST_MAX for the headers
+#endif
+#ifndef BROKER_QUEUE
+#define BROKER_QUEUE 160                    // Items queued or in flight, over all endpoints
+#endif
+
+const int BROKER_SLOTS = 2;                 // Requests in flight at once
+const int BROKER_HOSTS = 4;
+const int BROKER_ENDPOINTS = 4;
+const int BROKER_ITEM_SIZE = 24;
+const size_t BROKER_BODY_MAX = 128 * 1024;  // Longer responses fail with AHTTP_ERROR_SINK
+
+typedef enum {
+  PRIORITY_LIVE,                            // On screen now
+  PRIORITY_BACKFILL,                        // Wanted, but can wait for a quiet connection
+  PRIORITIES
+} broker_priority;
+
+extern const char *PRIORITY_NAMES[PRIORITIES];
+
+// Limits of one host. Hosts never given limits get BROKER_DEFAULT_LIMITS.
+typedef struct {
+  float rate;                               // Requests per second, sustained
+  int burst;                                // Requests at once after a quiet spell
+  int connections;                          // Requests in flight at once
+} broker_limits;
+
+const broker_limits BROKER_DEFAULT_LIMITS = { 1.0f, 2, 1 };
+
+// One finished request, as handed out by brokerPoll()
+typedef struct {
+  int endpoint;
+  int status;                               // HTTP status, or an ahttp_error
+  const char *body;                         // Valid until the next brokerPoll()
+  size_t length;
+  uint32_t hash;                            // xxHash32 of the body
+  uint32_t key;                             // Hash of the URL
+  bool unchanged;                           // Same body as the last 200 answer to the same URL
+  const char *const *items;                 // The items it asked for
+  int count;
+  broker_priority priority;                 // Of its most urgent item
+  uint32_t elapsed_ms;                      // From the start of the request
+  uint32_t waited_ms;                       // Its oldest item in the queue before that
+} broker_response;
+
+typedef struct {
+  uint32_t submitted;                       // Items asked for
+  uint32_t coalesced;                       // Already queued or in flight, not asked for again
+  uint32_t dropped;                         // Queue full
+  uint32_t requests;                        // By priority below
+  uint32_t batched;                         // Items carried by those requests
+  uint32_t throttled;                       // Requests held back by a token bucket
+  uint32_t failed;
+  int depth[PRIORITIES];                    // Items queued now, not yet in flight
+  int depthMax[PRIORITIES];
+  int inFlight;                             // Requests
+  uint32_t started[PRIORITIES];
+  uint32_t waitMs[PRIORITIES];              // Sum of waited_ms, divide by started
+  uint32_t waitMaxMs[PRIORITIES];
+} broker_stats;
+
+// Set the limits of host ("query1.finance.yahoo.com")
+void brokerHost(const char *host, const broker_limits &limits);
+
+// Register an endpoint: a request is prefix, the URL-encoded items separated by commas, then
+// suffix. Returns its number, or -1 when there are BROKER_ENDPOINTS already.
+int brokerEndpoint(const char *prefix, const char *suffix = "");
+
+// Phase timeouts of every request, in ms, as AsyncHttp takes them
+void brokerSetTimeouts(uint32_t connect_ms, uint32_t handshake_ms, uint32_t read_ms);
+
+// Queue item for endpoint. An item already queued there keeps its place, moving up to priority
+// if that is more urgent; one in flight is left to the request that carries it.
+// Returns false if the queue is full.
+bool brokerSubmit(int endpoint, const char *item, broker_priority priority, uint32_t now_ms);
+
+// Start the queued requests the limits allow, without waiting for the next brokerPoll()
+void brokerStart(uint32_t now_ms);
+
+// Advance the requests in flight and start queued ones the limits allow. Returns true with one
+// finished request in out; call again until it returns false.
+bool brokerPoll(uint32_t now_ms, broker_response &out);
+
+// Items of endpoint (any endpoint if -1) queued or in flight
+int brokerPending(int endpoint = -1);
+
+// A request is in flight, so brokerWait() has something to wait for
+bool brokerInFlight();
+
+// Sleep until a request in flight can make progress, or timeout_ms passes
+int brokerWait(uint32_t timeout_ms);
+
+// The body of out was unusable: do not take the next identical one as unchanged
+void brokerForget(const broker_response &out);
+
+// Abort the requests in flight, close their connections and empty the queue
+void brokerStop();
+
+const broker_stats &brokerStats();
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "quote.h"
+
+// Currency conversion. Every currency we meet (in quotes or positions) is registered, and for
+// each one other than the base currency its Yahoo FX pair (e.g. "EURUSD=X") is fetched in the
+// same request as the watchlist. A dense matrix of cross rates is kept: a new rate to the base
+// currency updates only its own row and column.
+// The conversion core has no Arduino dependencies; saving the base currency is device only.
+
+const int FX_MAX = 8;                       // Currencies, base included
+
+// Base currency, "USD" unless set
+const char *fxBase();
+
+// Index of currency code, registering it if new. Returns -1 for an empty code or a full table.
+int fxCurrency(const char *code);
+
+// Yahoo symbols of the FX pairs to fetch, and the currency each one prices
+int fxPairs(const char **symbols, int *currencies);
+
+// New rate of currency (units of base currency per unit)
+void fxUpdate(int currency, double to_base);
+
+// Rate between two currencies, or 0 while unknown
+double fxRate(int from, int to);
+
+// amount in currency from expressed in the base currency. Returns false while the rate is unknown.
+bool fxToBase(double amount, const char *from, double &out);
+
+// Quotes in a minor unit (GBp, ZAc, ILA) are moved to the major one, so every price is in an ISO currency
+void fxNormalise(quote &q);
+
+// Same for reference data
+void fxNormaliseReference(reference &r);
+
+#ifdef ARDUINO
+// Load the saved base currency
+void fxBegin();
+
+// Change and save the base currency; all rates are fetched again
+void fxSetBase(const char *code);
+#endif
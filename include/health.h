@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+// Hang protection for the fetch pipeline. Tasks that must not stall register with the ESP task
+// watchdog and call healthHeartbeat() regularly; a task that misses HEALTH_WDT_TIMEOUT reboots the
+// board. Below that backstop, consecutive fetch failures climb a recovery ladder:
+//
+//   abort the request -> reset the TLS socket -> restart Wi-Fi -> reboot
+//
+// Every step taken (and every watchdog reset) is counted in NVS, so it survives the reboot.
+
+const int HEALTH_WDT_TIMEOUT = 30;          // Seconds, longer than the sum of all network timeouts
+
+// Network phase timeouts for a fetch
+const int NET_CONNECT_TIMEOUT = 5000;       // ms, TCP connect
+const int NET_TLS_TIMEOUT = 8;              // s, TLS handshake
+const int NET_READ_TIMEOUT = 5000;          // ms, waiting for response data
+
+typedef enum {
+  RECOVER_ABORT,                            // Request was dropped, try again next cycle
+  RECOVER_SOCKET,                           // Close the TLS connection
+  RECOVER_WIFI,                             // Disconnect and rejoin Wi-Fi
+  RECOVER_REBOOT,                           // Restart the board
+  RECOVER_STEPS
+} recovery_step;
+
+typedef struct {
+  uint32_t steps[RECOVER_STEPS];            // Times each recovery step was taken
+  uint32_t watchdogResets;                  // Boots that followed a watchdog timeout
+  uint32_t boots;
+} health_counters;
+
+// Configure the watchdog, load the counters and account the reason for this boot
+void healthBegin();
+
+// Tasks under the watchdog, each feeding its own entry from the point where it waits for work:
+//
+//   loopTask  once per frame, at the top of loop()
+//   log       each time the drain task finds the ring empty, before it sleeps
+//
+// Left unwatched on purpose:
+//
+//   mqtt_task (two of them, the quote publisher and the MQTT quote source) - esp-mqtt owns their
+//   loops and offers no hook to feed the watchdog between its socket waits, which last up to the
+//   network timeout plus the reconnect delay. A stuck broker link is dropped by esp-mqtt's own
+//   timeouts and shows up on the loop as the broker being down.
+
+// Put the calling task under the watchdog. From then on it must call healthHeartbeat() at least
+// every HEALTH_WDT_TIMEOUT seconds. name is only used in the log.
+void healthWatchTask(const char *name);
+
+// Tell the watchdog the calling task is alive. Only the calling task's entry is fed, so a stalled
+// task still times out while the others carry on.
+void healthHeartbeat();
+
+// Record a failed fetch. Returns the recovery step the caller must carry out.
+recovery_step healthFetchFailed();
+
+// Record a successful fetch, which resets the ladder
+void healthFetchSucceeded();
+
+const health_counters &healthCounters();
@@ -0,0 +1,9 @@
+#pragma once
+
+// Whole watchlist as a grid of cells coloured by percent change, for lists too long for the
+// text pages. The layout is computed once per watchlist change, and a cell is repainted only
+// when its colour bucket changes.
+
+// Draw the heatmap; full forces a complete redraw, otherwise only changed cells are painted.
+// Returns the number of cells painted.
+int drawHeatmapPage(bool full);
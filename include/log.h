@@ -0,0 +1,117 @@
+#pragma once
+
+// Leveled, deferred logging.
+//
+// LOG_xxx() calls below LOG_LEVEL compile to nothing. The others copy the format pointer and the
+// raw arguments into a lock-free ring and return; a task at the loop's priority does the printf-style
+// formatting and the (possibly blocking) write to Serial. If the ring is full the message is
+// dropped and counted, so the caller never waits for the USB host.
+//
+// The format string must be a literal (only its pointer is stored). String arguments are copied,
+// up to LOG_TEXT_SIZE bytes per message in total.
+
+#include <stdint.h>
+#include <type_traits>
+#include <WString.h>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) logWrite(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) logWrite(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) logWrite(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) logWrite(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) do {} while (0)
+#endif
+
+const int LOG_MAX_ARGS = 8;
+const int LOG_TEXT_SIZE = 48;
+
+// A raw, not yet formatted argument
+typedef struct {
+  enum : uint8_t { INT, UINT, DOUBLE, STR, PTR } type;
+  union {
+    int64_t i;
+    uint64_t u;
+    double d;
+    const char *s;      // Only valid until logCommit() copies it
+    const void *p;
+  };
+} log_arg;
+
+// Start the drain task. Messages logged before this are queued and printed once it runs. It
+// first times a few thousand calls and logs their mean cost.
+void logBegin();
+
+// Number of messages dropped because the ring was full
+uint32_t logDropped();
+
+// Queue a message. Use the LOG_xxx macros instead so that disabled levels cost nothing.
+void logCommit(uint8_t level, const char *fmt, const log_arg *args, int nargs);
+
+// ------------------------------------------------------------------------------------
+// Argument capture
+
+template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type>
+inline log_arg logArg(T v) {
+  log_arg a;
+  if (std::is_floating_point<T>::value) {
+    a.type = log_arg::DOUBLE;
+    a.d = (double)v;
+  } else if (std::is_signed<T>::value) {
+    a.type = log_arg::INT;
+    a.i = (int64_t)v;
+  } else {
+    a.type = log_arg::UINT;
+    a.u = (uint64_t)v;
+  }
+  return a;
+}
+
+inline log_arg logArg(const char *v) {
+  log_arg a;
+  a.type = log_arg::STR;
+  a.s = v;
+  return a;
+}
+
+inline log_arg logArg(char *v) { return logArg((const char *)v); }
+inline log_arg logArg(const String &v) { return logArg(v.c_str()); }
+
+inline log_arg logArg(const void *v) {
+  log_arg a;
+  a.type = log_arg::PTR;
+  a.p = v;
+  return a;
+}
+
+template <typename... Args>
+inline void logWrite(uint8_t level, const char *fmt, const Args &...args) {
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+  log_arg packed[sizeof...(Args) + 1] = { logArg(args)... };
+  logCommit(level, fmt, packed, sizeof...(Args));
+}
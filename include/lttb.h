@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest-Triangle-Three-Buckets downsampling of a tick history series onto a fixed number of
+// pixel columns. Buckets are aligned to wall-clock multiples of the bucket width, so as time
+// passes only the newest buckets change: an update re-reads and re-selects just those, and
+// shifts the rest when the window slides. Each bucket keeps the point that forms the largest
+// triangle with the previous bucket's pick and the next bucket's average; the newest bucket
+// keeps its latest point so the chart ends at the current price.
+
+typedef struct {
+  uint32_t t;
+  float v;
+} chart_point;
+
+class ChartCache {
+public:
+  // A window of window seconds mapped onto columns buckets. Allocates the buffers.
+  ChartCache(int series, uint32_t window, int columns);
+  ~ChartCache();
+  ChartCache(const ChartCache &) = delete;
+  ChartCache &operator=(const ChartCache &) = delete;
+
+  // Bring the buckets up to date with the history at time now (seconds)
+  void update(uint32_t now);
+
+  // Forget everything, e.g. after the history was cleared
+  void invalidate() { _valid = false; }
+
+  int series() const { return _series; }
+  uint32_t window() const { return _window; }
+  int columns() const { return _columns; }
+
+  // Selected point of each column; empty columns have count(i) == 0
+  const chart_point &point(int i) const { return _points[i]; }
+  uint32_t count(int i) const { return _counts[i]; }
+
+  // Samples read from the history by the last update, to see the incremental saving
+  uint32_t lastScanned() const { return _scanned; }
+
+private:
+  void accumulate(int from);
+  void select(int from);
+
+  int _series;
+  uint32_t _window;
+  int _columns;
+  uint32_t _width;          // Seconds per bucket
+  uint32_t _origin;         // Start of bucket 0
+  bool _valid;
+  uint32_t _scanned;
+
+  chart_point *_points;
+  double *_sums;            // For the bucket averages
+  uint32_t *_counts;
+};
+
+// ------------------------------------------------------------------------------------
+// The chart pages step through every series at every zoom level, so their cache keeps one
+// ChartCache per (series, zoom) pair, made on first use. Series from CHART_CACHE_SERIES on share
+// a single slot that is rebuilt each time, which bounds the memory with a long watchlist.
+
+#ifndef CHART_CACHE_SERIES
+#define CHART_CACHE_SERIES 6                // 3.2 KB per zoom level each at 160 columns
+#endif
+const int CHART_CACHE_ZOOMS = 4;
+
+typedef struct {
+  uint32_t hits;                            // Found with its buckets, so updated incrementally
+  uint32_t misses;                          // Made or rebuilt from scratch
+} chart_cache_stats;
+
+// The cached series of series at zoom level zoom, a new one if it was not there
+ChartCache *chartCacheFor(int series, int zoom, uint32_t window, int columns);
+
+// Drop every cached series, e.g. when the watchlist changes
+void chartCacheClear();
+
+chart_cache_stats chartCacheStats();
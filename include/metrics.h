@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// Runtime counters, reported to the log every METRICS_INTERVAL ms
+
+const unsigned long METRICS_INTERVAL = 60000;
+
+// Fetch latency is bucketed by the RSSI at the time of the fetch: >= -55, -65, -75, below
+const int RSSI_BANDS = 4;
+const int RSSI_BAND_FLOOR[RSSI_BANDS] = { -55, -65, -75, -128 };
+
+typedef struct {
+  uint32_t fetches;
+  uint32_t fetchErrors;
+  uint32_t bandFetches[RSSI_BANDS];
+  uint32_t bandLatencyMs[RSSI_BANDS];     // Sum, divide by bandFetches for the average
+  uint32_t bandLatencyMaxMs[RSSI_BANDS];
+  uint32_t roams;
+  uint32_t parses;
+  uint32_t parseErrors;                   // Responses that were not a complete, valid quote list
+  uint64_t parseBytes;
+  uint64_t parseUs;
+  uint32_t unchanged;                     // Responses identical to the previous one, not parsed
+  uint32_t framesSkipped;                 // Live page frames not redrawn since nothing changed
+  uint32_t ticksDrawn;                    // Frames showing quotes pushed over MQTT
+  uint64_t tickToPixelUs;                 // Sum, from the arrival of the oldest quote to the end of the frame
+  uint32_t tickToPixelMaxUs;
+} metrics_t;
+
+extern metrics_t metrics;
+
+// Account one fetch cycle that took ms milliseconds at the given signal strength
+void metricsRecordFetch(uint32_t ms, int rssi, bool ok);
+
+// Account one response of len bytes parsed in us microseconds
+void metricsRecordParse(uint32_t len, uint32_t us, bool ok);
+
+// Account one response skipped because it was identical to the previous one, and one
+// page frame not redrawn because of that
+void metricsRecordUnchanged();
+void metricsRecordFrameSkipped();
+
+// Account one frame that showed quotes pushed over MQTT, us after the oldest of them arrived
+void metricsRecordTickToPixel(uint32_t us);
+
+// Log the counters when METRICS_INTERVAL has elapsed. Call from loop().
+void metricsPoll();
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Arduino.h>
+#include <mqtt_client.h>
+
+// What the quote publisher (mqtt_publish) and the quote source (mqtt_source) share: both use
+// "<prefix>/<symbol>" topics, so a dongle publishing can feed another one subscribing.
+
+const int MQTT_TOPIC_SIZE = 64;
+
+// Topic for symbol under prefix; MQTT wildcards and separators in the symbol are replaced
+void mqttTopicFor(const char *prefix, const char *symbol, char *topic);
+
+// prefix trimmed and without trailing '/', or fallback when nothing is left
+String mqttCleanPrefix(const char *prefix, const char *fallback);
+
+// A client for uri with id "<id_base>-<MAC suffix>" and onEvent for every event, or nullptr if the
+// URI is bad (logged under tag). config carries the caller's own settings, e.g. a last will.
+esp_mqtt_client_handle_t mqttCreateClient(esp_mqtt_client_config_t &config, const char *uri, const char *id_base,
+                                          esp_event_handler_t onEvent, const char *tag);
+
+// Stop and free client, if any, and clear the handle
+void mqttDestroyClient(esp_mqtt_client_handle_t &client);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Publishes every quote update to a local MQTT broker as one retained message per symbol,
+// "<prefix>/<symbol>" with a compact JSON payload:
+//   {"p":4512.34,"pc":4490.12,"chg":0.4877,"open":1,"cur":"USD","t":1700000000}
+// Messages are handed to the ESP-IDF MQTT client, which sends them from its own task, so a slow
+// or missing broker never holds up the fetch or the display. Nothing is published while no broker
+// is set.
+
+const int MQTT_QOS_MAX = 1;
+
+typedef struct {
+  uint32_t batches;                         // Fetch cycles that published something
+  uint32_t published;                       // Messages handed to the client
+  uint32_t acked;                           // QoS 1 messages acknowledged by the broker
+  uint32_t unchanged;                       // Symbols skipped because the broker already has them
+  uint32_t dropped;                         // Messages not sent because the broker was unreachable
+  uint32_t connects;
+  uint32_t enqueueUs;                       // Time spent handing the last batch to the client
+} mqtt_stats;
+
+// Load the broker settings and create the client. It connects once Wi-Fi is up.
+void mqttBegin();
+
+// Start the client when the network comes up. Call from loop().
+void mqttPoll(bool connected);
+
+// Queue one message for every symbol whose quote changed since it was last published.
+// Returns the number of messages queued.
+int mqttPublishQuotes();
+
+// Change and save the broker ("mqtt://host:1883", empty to disable), topic prefix and QoS (0 or 1)
+void mqttSetBroker(const char *uri, const char *prefix, int qos);
+
+// Saved settings, for the setup portal
+String mqttBroker();
+String mqttPrefix();
+int mqttQos();
+
+const mqtt_stats &mqttStats();
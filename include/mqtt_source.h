@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "quote.h"
+#include "quote_decode.h"
+
+// Quotes pushed over MQTT, as an alternative to polling Yahoo. When a source broker is set, every
+// symbol (watchlist and FX pairs) is subscribed as "<prefix>/<symbol>" and each message is decoded
+// in the MQTT client task as it arrives. The loop takes the latest quote of every symbol that
+// changed, so no HTTP request or JSON document is involved between the bus and the screen.
+
+const int MQTT_SOURCE_MAX = 72;             // Watchlist and FX pairs
+
+typedef struct {
+  uint32_t received;                        // Messages decoded into a quote
+  uint32_t malformed;                       // Messages of a subscribed symbol that did not decode
+  uint32_t overwritten;                     // Quotes replaced by a newer one before the loop took them
+  uint32_t connects;
+} mqtt_source_stats;
+
+// Load the source settings and create the client. It connects once Wi-Fi is up.
+void mqttSourceBegin();
+
+// Start the client when the network comes up. Call from loop().
+void mqttSourcePoll(bool connected);
+
+// True when quotes come from MQTT instead of HTTP
+bool mqttSourceActive();
+
+// Subscribe to symbols[0..count), dropping the symbols no longer in the list. Cheap when the list
+// did not change, so it can be called before every take.
+void mqttSourceSubscribe(const char *const *symbols, int count);
+
+// Copy the quotes received since the last call into out[i] for each subscribed symbols[i], and
+// set updated[i]. first_us is the esp_timer time the oldest of them arrived. Returns how many.
+int mqttSourceTake(quote *out, bool *updated, int64_t &first_us);
+
+// Change and save the source broker ("mqtt://host:1883", empty to poll Yahoo), topic prefix and payload format
+void mqttSourceSet(const char *uri, const char *prefix, payload_format format);
+
+// Saved settings, for the setup portal
+String mqttSourceBroker();
+String mqttSourcePrefix();
+payload_format mqttSourceFormat();
+
+const mqtt_source_stats &mqttSourceStats();
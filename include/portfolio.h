@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Portfolio of positions with daily and total P&L, kept up to date incrementally: positions
+// are chained per quote series, so a quote update only touches the positions in that symbol,
+// and each one adds the change of its contribution to the totals of its currency.
+// Everything is fixed point in PORTFOLIO_SCALE units, and since the totals are sums of the
+// stored contributions they never drift from a full recomputation.
+//
+// The engine has no Arduino dependencies, so it can be built and benchmarked on the host;
+// loading, parsing and saving the positions (NVS) is only built for the device.
+
+#ifndef PORTFOLIO_MAX
+#define PORTFOLIO_MAX 64                    // Positions, which also bounds the NVS blob
+#endif
+
+const int64_t PORTFOLIO_SCALE = 10000;      // Four decimals, as the history and the binary feed
+const int PORTFOLIO_SERIES = 64;            // Quote series positions can refer to
+const int PORTFOLIO_CURRENCIES = 8;
+
+typedef struct {
+  char symbol[16];
+  char currency[4];                         // ISO code, e.g. "USD"
+  int64_t quantity;                         // PORTFOLIO_SCALE units, fractional shares allowed
+  int64_t cost;                             // Cost basis per share, PORTFOLIO_SCALE units
+} position;
+
+typedef struct {
+  char currency[4];
+  int64_t value;                            // Market value of the priced positions
+  int64_t cost;                             // Their cost
+  int64_t dayPnl;                           // Change since the previous close
+  int positions;
+  int priced;                               // Positions with a quote so far
+} portfolio_total;
+
+// Forget all positions
+void portfolioClear();
+
+// Add a position fed by quote series series. Returns its index, or -1 when full.
+int portfolioAdd(const position &p, int series);
+
+// New quote for series. Positions are only touched if the price or previous close changed.
+void portfolioUpdate(int series, double current, double previous_close);
+
+// Currency series is quoted in, as the quote reports it. Its positions are counted in that
+// currency from then on, whatever they were entered with. Returns the number of positions that
+// were entered in another currency and moved, 0 when the currency is unchanged.
+int portfolioSetCurrency(int series, const char *currency);
+
+int portfolioCount();
+const position &portfolioPosition(int index);
+
+// Totals per currency, in the order the currencies first appeared
+int portfolioCurrencies();
+const portfolio_total &portfolioTotal(int index);
+
+// Positions touched by updates so far, to see the incremental saving
+uint32_t portfolioTouched();
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+// Load the saved positions and bind them to the watchlist, adding missing symbols to it
+void portfolioBegin();
+
+// Re-resolve the positions' symbols, e.g. after the watchlist changed
+void portfolioBind();
+
+// Replace and save the positions. text is comma separated "SYMBOL QUANTITY COST [CURRENCY]"
+// entries, the currency defaulting to USD; a ":LABEL" after the symbol is dropped. Returns false,
+// keeping the current ones, if an entry does not parse or an amount is not a finite number below
+// 1e9 (costs not negative either). An empty text clears the portfolio.
+bool portfolioSet(const char *text);
+
+// The positions in the format portfolioSet() takes
+String portfolioText();
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+
+// Portfolio summary: day and total P&L and market value in the base currency
+
+// Draw the summary page. Returns false (and draws nothing) when there are no positions.
+bool drawPortfolioPage();
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+// CPU time, call counts and heap allocations per pipeline stage, so that regressions in
+// loop() show up in the metrics. Allocations are counted by wrapping malloc/calloc/realloc
+// at link time (see build_flags); counts include other tasks allocating during a stage.
+
+typedef enum {
+  STAGE_NETWORK,              // Provisioning, roaming and power management
+  STAGE_FETCH,                // HTTP request and body download
+  STAGE_PARSE,                // JSON to quotes
+  STAGE_UPDATE,               // Filtering and applying quotes: history, candles, portfolio
+  STAGE_RENDER,               // Drawing a page
+  STAGE_COUNT
+} stage;
+
+typedef struct {
+  uint32_t calls;
+  uint64_t us;
+  uint32_t allocs;
+} stage_stats;
+
+extern stage_stats stage_totals[STAGE_COUNT];
+extern const char *STAGE_NAMES[STAGE_COUNT];
+
+// Heap allocations since boot, all tasks
+uint32_t profileAllocations();
+
+// Accounts the time and allocations between construction and destruction to a stage
+class StageTimer {
+public:
+  explicit StageTimer(stage s);
+  ~StageTimer();
+  StageTimer(const StageTimer &) = delete;
+  StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+  stage _stage;
+  int64_t _started;
+  uint32_t _allocs;
+};
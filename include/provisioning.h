@@ -0,0 +1,31 @@
+#pragma once
+
+// Wi-Fi provisioning as a background state machine. provisioningPoll() must be called every
+// frame from loop(); it never blocks, so the display keeps running while we connect or while
+// the configuration portal is up.
+//
+//   CONNECTING --(associated)--> CONNECTED --(link lost too long)--> CONNECTING
+//   CONNECTING --(timeout)-----> PORTAL    --(credentials saved and associated)--> CONNECTED
+//                                PORTAL    --(timeout)--> CONNECTING (retry saved networks)
+
+typedef enum {
+  PROV_CONNECTING,
+  PROV_CONNECTED,
+  PROV_PORTAL,
+} prov_state;
+
+extern const char *PORTAL_AP_NAME;
+
+// Start connecting with the saved credentials
+void provisioningBegin();
+
+// Advance the state machine and serve the portal. Cheap when there is nothing to do.
+void provisioningPoll();
+
+// Drop the current link and go through network selection again
+void provisioningRestart();
+
+prov_state provisioningState();
+
+inline bool provisioningConnected() { return provisioningState() == PROV_CONNECTED; }
+inline bool provisioningPortalActive() { return provisioningState() == PROV_PORTAL; }
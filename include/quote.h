@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+// A structure that represents a stock quote with its value, previous close, change, if the market is open
+// and the currency it is priced in
+typedef struct {
+  double current;
+  double previousClose;
+  double percentageChange;
+  bool marketOpen;
+  char currency[4];           // As Yahoo reports it, empty when unknown
+} quote;
+
+// Slow-changing data of a symbol, fetched once a day. Prices are as Yahoo reports them, in
+// minor units where the currency is one.
+typedef struct {
+  double previousClose;
+  double yearHigh;            // 52-week range, NAN when unknown
+  double yearLow;
+  char currency[4];
+  char timezone[6];           // Exchange time zone, e.g. "EST"
+  int32_t gmtOffset;          // Exchange time minus UTC, s
+} reference;
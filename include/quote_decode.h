@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "quote.h"
+
+// Decoders for single quote messages pushed over MQTT, one symbol per message (the topic names
+// the symbol). Like the Yahoo parser they have no Arduino dependencies, so host tools can use them.
+//
+//   PAYLOAD_JSON    {"p":4512.34,"pc":4490.12,"chg":0.4877,"open":1,"cur":"USD"}, as mqtt_publish
+//                   sends it. "p" and "pc" are required; "chg" is derived when missing.
+//   PAYLOAD_BINARY  a feed_quote (see quote_feed.h), optionally followed by the 3 letter currency.
+//                   No text parsing at all: a length check, two fixed point conversions and a copy.
+
+typedef enum {
+  PAYLOAD_JSON,
+  PAYLOAD_BINARY,
+  PAYLOAD_FORMATS,
+} payload_format;
+
+extern const char *const PAYLOAD_FORMAT_NAMES[PAYLOAD_FORMATS];
+
+// Fill out from one message. Nothing is written unless the whole message is valid.
+bool decodeQuote(payload_format format, const uint8_t *data, size_t len, quote &out);
@@ -0,0 +1,149 @@
+#pragma once
+
+// Binary quote feed streamed over USB CDC, interleaved with the human-readable debug lines.
+// This header has no Arduino dependencies so that host tools can include it as-is.
+//
+// Frame layout (all fields little-endian, no padding):
+//
+//   sync0 sync1 | version type length | seq | timestamp_us | payload[length] | crc16
+//     0xA5 0x5A |   u8     u8    u16  | u32 |     u64      |                 |  u16
+//
+// The CRC (CRC-16/CCITT-FALSE) covers everything from version up to the end of the payload.
+// seq increments on every frame the device tries to send, so a gap means frames were dropped
+// (the device never blocks waiting for the host to drain the port). timestamp_us is the
+// device's monotonic clock when the data was produced.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+const uint8_t FEED_SYNC0 = 0xA5;
+const uint8_t FEED_SYNC1 = 0x5A;
+const uint8_t FEED_VERSION = 1;
+const size_t FEED_MAX_PAYLOAD = 64;
+const int64_t FEED_PRICE_SCALE = 10000;   // Prices are fixed point with four decimals
+
+enum feed_type : uint8_t {
+  FEED_HELLO = 1,                         // Sent once at boot, empty payload
+  FEED_QUOTE = 2,                         // One feed_quote per symbol per update
+};
+
+#pragma pack(push, 1)
+typedef struct {
+  uint8_t sync0;
+  uint8_t sync1;
+  uint8_t version;
+  uint8_t type;
+  uint16_t length;
+  uint32_t seq;
+  uint64_t timestamp_us;
+} feed_header;
+
+typedef struct {
+  char symbol[8];                         // Zero padded display label (e.g. "SPX")
+  int64_t price;                          // FEED_PRICE_SCALE units
+  int64_t previousClose;                  // FEED_PRICE_SCALE units
+  int32_t changeBp;                       // Change from previous close in basis points
+  uint8_t marketOpen;
+} feed_quote;
+#pragma pack(pop)
+
+const size_t FEED_MAX_FRAME = sizeof(feed_header) + FEED_MAX_PAYLOAD + 2;
+
+// CRC-16/CCITT-FALSE, bitwise. Frames are tiny so a table is not worth the flash.
+inline uint16_t feedCrc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF) {
+  while (len--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// Write a complete frame into out (at least FEED_MAX_FRAME bytes). Returns the frame size.
+inline size_t feedEncode(uint8_t *out, uint8_t type, uint32_t seq, uint64_t timestamp_us,
+                         const void *payload, uint16_t length) {
+  feed_header hdr = { FEED_SYNC0, FEED_SYNC1, FEED_VERSION, type, length, seq, timestamp_us };
+  memcpy(out, &hdr, sizeof(hdr));
+  if (length) memcpy(out + sizeof(hdr), payload, length);
+  size_t n = sizeof(hdr) + length;
+  uint16_t crc = feedCrc16(out + 2, n - 2);
+  out[n++] = crc & 0xFF;
+  out[n++] = crc >> 8;
+  return n;
+}
+
+// Incremental frame decoder. Feed it bytes as they arrive; push() returns true whenever a
+// complete, CRC-valid frame is available in header()/payload(), valid until the next push().
+// Text and garbage between frames is skipped by hunting for the sync bytes again. A frame that
+// fails its header or CRC check gives up only its first byte: the bytes after it are searched
+// again, so a good frame swallowed by a corrupted length is still found.
+class FeedDecoder {
+public:
+  bool push(uint8_t b) {
+    release();
+    _buf[_pos++] = b;
+    return scan();
+  }
+
+  // True if another complete frame was already buffered, e.g. behind one that failed its CRC.
+  // Call after the last push() of a read until it returns false.
+  bool next() {
+    release();
+    return scan();
+  }
+
+  const feed_header &header() const { return _hdr; }
+  const uint8_t *payload() const { return _buf + sizeof(feed_header); }
+  uint32_t badFrames() const { return _badFrames; }
+
+private:
+  // Look for a complete frame at the start of the buffer, resyncing past bad ones
+  bool scan() {
+    for (;;) {
+      size_t skip = 0;
+      while (skip < _pos && !(_buf[skip] == FEED_SYNC0 && (skip + 1 == _pos || _buf[skip + 1] == FEED_SYNC1))) {
+        skip++;
+      }
+      drop(skip);
+      if (_pos < sizeof(feed_header)) return false;
+
+      memcpy(&_hdr, _buf, sizeof(_hdr));
+      if (_hdr.version != FEED_VERSION || _hdr.length > FEED_MAX_PAYLOAD) {
+        _badFrames++;
+        drop(1);
+        continue;
+      }
+      size_t n = sizeof(feed_header) + _hdr.length;
+      if (_pos < n + 2) return false;
+
+      uint16_t crc = _buf[n] | (_buf[n + 1] << 8);
+      if (crc != feedCrc16(_buf + 2, n - 2)) {
+        _badFrames++;
+        drop(1);
+        continue;
+      }
+      _done = n + 2;            // Handed out now, removed by the next push() or next()
+      return true;
+    }
+  }
+
+  // Remove the frame handed out last
+  void release() {
+    drop(_done);
+    _done = 0;
+  }
+
+  void drop(size_t n) {
+    if (n == 0) return;
+    memmove(_buf, _buf + n, _pos - n);
+    _pos -= n;
+  }
+
+  uint8_t _buf[FEED_MAX_FRAME];
+  size_t _pos = 0;
+  size_t _done = 0;
+  feed_header _hdr;
+  uint32_t _badFrames = 0;
+};
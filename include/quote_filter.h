@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "quote.h"
+
+// Data quality stage between the parser and everything that uses quotes. Every tick is checked
+// in constant time against:
+//   - zero, negative and non-finite prices
+//   - a sane distance from the previous close
+//   - the median of the last FILTER_WINDOW accepted prices, using the median absolute deviation
+//     (with a floor, so a flat market does not reject every move)
+// A rejected tick leaves the last good quote in place. A move that persists for
+// FILTER_CONFIRM ticks is a real level shift, and is accepted.
+// No Arduino dependencies, so it can be exercised with synthetic streams on the host.
+
+const int FILTER_SERIES = 64;
+const int FILTER_WINDOW = 9;                // Odd, so the median is one sample
+const int FILTER_CONFIRM = 3;               // Consecutive consistent outliers that make a new level
+const double FILTER_MAD_K = 10.0;           // Outlier distance, in MADs
+const double FILTER_MAD_FLOOR = 0.001;      // Smallest MAD, relative to the median
+const double FILTER_MAX_DAY_MOVE = 0.5;     // Largest believable change from the previous close
+
+typedef enum {
+  FILTER_OK,
+  FILTER_INVALID,                           // Zero, negative, NaN or infinite
+  FILTER_BOUNDS,                            // Too far from the previous close
+  FILTER_SPIKE,                             // Too far from the recent median
+  FILTER_RESULTS
+} filter_result;
+
+typedef struct {
+  uint32_t accepted;
+  uint32_t rejected[FILTER_RESULTS];        // By reason, rejected[FILTER_OK] unused
+  uint32_t levelShifts;                     // Outlier runs accepted as a new level
+} filter_stats;
+
+// Check the new quote q of series. Returns FILTER_OK if it may be used.
+filter_result quoteFilter(int series, quote &q);
+
+// Forget the history of every series, e.g. when the watchlist changes
+void quoteFilterReset();
+
+filter_stats quoteFilterStats();
+const char *filterResultName(filter_result result);
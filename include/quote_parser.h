@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "quote.h"
+
+// Parser for Yahoo Finance v7 quote responses. It does not depend on the Arduino core, so it
+// can be built on the host for fuzzing and benchmarks.
+//
+// Results are matched to the requested symbols by their "symbol" field, not by position, and
+// every field is type checked: an error object, missing or reordered results, nulls and wrong
+// types leave the affected quotes untouched instead of reading through null pointers.
+// Memory is bounded by a filter that keeps only the fields we use and by a document size
+// proportional to the symbol count; time is linear in the payload size, which is capped at
+// PARSE_MAX_PAYLOAD.
+//
+// Only the price is required. A response asked for the fast fields alone has no previous
+// close, which is left NAN for the reference data to fill in, and the percent change is NAN
+// when neither it nor the previous close came with the quote.
+
+const size_t PARSE_MAX_PAYLOAD = 64 * 1024;
+const size_t PARSE_DOC_BASE = 512;
+const size_t PARSE_DOC_PER_QUOTE = 320;
+
+typedef enum {
+  PARSE_OK,                   // Every requested symbol was updated
+  PARSE_PARTIAL,              // Some symbols were missing or malformed
+  PARSE_NO_RESULT,            // Valid JSON but no usable quote (e.g. an error response)
+  PARSE_BAD_JSON,             // Not JSON, truncated, too deep or too large
+} parse_status;
+
+// Update out[i] for each symbols[i] found in the payload. updated[i] tells which ones were.
+// With refs, the reference data of the updated ones goes to refs[i], with a NAN previous close
+// when the response did not carry it.
+parse_status parseQuotes(const char *payload, size_t len, const char *const *symbols, int count,
+                         quote *out, bool *updated, reference *refs = nullptr);
+
+const char *parseStatusName(parse_status status);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <time.h>
+
+#include "quote.h"
+
+// Reference data of the watchlist symbols: previous close, 52-week range, currency and exchange
+// time zone. It changes once a day, so the hot poll asks Yahoo only for the fast fields and takes
+// the rest from here. A symbol is fetched again once its exchange starts a new day (REF_DAY_START
+// local time), or sooner if its cached close disagrees with the day's change in the fast fields.
+// The cache is kept in NVS and loaded at boot, so the first poll is already a fast one.
+
+const int REF_DAY_START = 6 * 3600;         // s after exchange midnight; the previous close is final by then
+const time_t REF_RECHECK = 3600;            // s before a close that disagrees with the live change is fetched again
+const double REF_TOLERANCE = 0.001;         // Relative difference from the close implied by the change
+
+// Load the saved reference data of the current watchlist
+void refBegin();
+
+// Keep the data of the symbols still in a new watchlist, in its order
+void refBind();
+
+// Reference data of watchlist entry i, or nullptr until it has been fetched
+const reference *refGet(int i);
+
+// Entry i is missing, from an earlier exchange day or suspect, and should be fetched
+bool refDue(int i, time_t now);
+
+// New reference data of entry i, fetched at now
+void refStore(int i, const reference &r, time_t now);
+
+// The reference data of entry i was fetched again and had not changed
+void refTouch(int i, time_t now);
+
+// Complete a quote of entry i made of the fast fields: previous close, currency and change.
+// A cached close that disagrees with the change is replaced by the implied one and marked
+// suspect. Returns false if the quote still has no previous close.
+bool refFill(int i, quote &q);
+
+// Save to NVS if anything changed since the last save
+void refSave();
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <TFT_eSPI.h>
+
+// Per-frame rendering counters. CountingTFT is a drop-in TFT_eSPI that counts draw calls and
+// the pixels they cover by hooking the virtual primitives every higher level call goes through
+// (text is drawn one drawChar() at a time, lines as fast horizontal and vertical runs and single
+// pixels). Wrap each page redraw in renderFrameBegin/End.
+
+typedef struct {
+  uint32_t calls;             // Primitive draw calls
+  uint32_t pixels;            // Pixels written (rectangle area for fills and glyph cells)
+} render_counts;
+
+typedef struct {
+  uint32_t frames;
+  uint64_t calls;
+  uint64_t pixels;
+  uint64_t us;                // Time spent rendering
+  uint32_t maxPixels;         // Largest single frame
+} render_totals;
+
+extern render_counts render_frame;
+extern render_totals render_total;
+
+void renderFrameBegin();
+void renderFrameEnd();
+
+class CountingTFT : public TFT_eSPI {
+public:
+  void drawPixel(int32_t x, int32_t y, uint32_t color) override {
+    render_frame.calls++;
+    render_frame.pixels++;
+    TFT_eSPI::drawPixel(x, y, color);
+  }
+
+  // drawLine() goes through these for its straight runs, as do the candle wicks
+  void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color) override {
+    render_frame.calls++;
+    render_frame.pixels += clippedArea(x, y, 1, h);
+    TFT_eSPI::drawFastVLine(x, y, h, color);
+  }
+
+  void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color) override {
+    render_frame.calls++;
+    render_frame.pixels += clippedArea(x, y, w, 1);
+    TFT_eSPI::drawFastHLine(x, y, w, color);
+  }
+
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) override {
+    render_frame.calls++;
+    render_frame.pixels += clippedArea(x, y, w, h);
+    TFT_eSPI::fillRect(x, y, w, h, color);
+  }
+
+  int16_t drawChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t font) override {
+    int16_t w = TFT_eSPI::drawChar(uniCode, x, y, font);
+    render_frame.calls++;
+    render_frame.pixels += clippedArea(x, y, w, fontHeight(font));
+    return w;
+  }
+
+private:
+  uint32_t clippedArea(int32_t x, int32_t y, int32_t w, int32_t h) {
+    int32_t x1 = max(x, (int32_t)0), y1 = max(y, (int32_t)0);
+    int32_t x2 = min(x + w, (int32_t)width()), y2 = min(y + h, (int32_t)height());
+    return (x2 > x1 && y2 > y1) ? (x2 - x1) * (y2 - y1) : 0;
+  }
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+// The text pages: label and value, or label and percent change, of the first TEXT_ROWS
+// watchlist entries, and the connection banner shown until there are quotes.
+
+const int TEXT_ROWS = 3;                    // Quotes that fit on the screen
+
+// Draw the values, with the 52-week range bar under each; labels also draws the labels, needed
+// when the screen was used by another page. The values page and the change page share them.
+void drawValuesPage(bool labels);
+
+// Same with the percent change from the previous close
+void drawChangePage(bool labels);
+
+// Connection banner: joining the saved networks, or how to reach the setup portal at address
+void drawStatusPage(bool portal, const char *address);
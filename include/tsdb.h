@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compressed tick history, Gorilla style. Each series is a chain of fixed-size blocks holding
+// bit-packed samples: timestamps as delta-of-delta, values as deltas of a fixed point
+// representation (TSDB_SCALE units), both with variable length prefix codes. A regular
+// 1-minute series that does not move costs 2 bits per sample.
+//
+// Blocks come from one pool with a byte budget (PSRAM when the board has it). When the pool is
+// exhausted the oldest block of any series is recycled, so history degrades gracefully.
+// No Arduino dependencies, so the codec can be built and benchmarked on the host.
+
+const int64_t TSDB_SCALE = 10000;           // Four decimals
+const size_t TSDB_BLOCK_BYTES = 256;        // Size of one block, header included
+const int TSDB_MAX_SERIES = 64;
+
+typedef struct {
+  uint32_t samples;                         // Samples currently stored
+  uint32_t blocks;                          // Blocks in use
+  uint32_t bytes;                           // Bytes in use, headers included
+  uint32_t evictions;                       // Blocks recycled to make room
+} tsdb_stats;
+
+// Naive layout we compare against: one timestamp and one double per sample
+const size_t TSDB_NAIVE_SAMPLE_BYTES = sizeof(uint32_t) + sizeof(double);
+
+// Reserve budget bytes for series series. Returns false if the memory is not available.
+bool tsdbBegin(int series, size_t budget);
+
+// Append a sample. Timestamps (seconds) must not go backwards; older samples are ignored.
+void tsdbAppend(int series, uint32_t t, double value);
+
+// Number of samples and first timestamp of a series
+uint32_t tsdbCount(int series);
+uint32_t tsdbFirstTime(int series);
+
+tsdb_stats tsdbStats();
+
+// Forget everything
+void tsdbClear();
+
+struct tsdb_block;
+
+// Streaming decoder over one series, oldest sample first
+class TsdbReader {
+public:
+  TsdbReader(int series, uint32_t from = 0);
+  bool next(uint32_t &t, double &value);
+
+private:
+  bool nextRaw(uint32_t &t, int64_t &v);
+
+  tsdb_block *_block;
+  uint32_t _from;
+  uint32_t _index;          // Sample index within the block
+  uint32_t _bit;            // Read position within the block data
+  uint32_t _t;
+  int32_t _dt;
+  int64_t _v;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "quote.h"
+
+// Device side of the binary quote feed (see quote_feed.h for the wire format)
+
+// Announce the feed to the host. Call once after Serial.begin().
+void feedBegin();
+
+// Send one quote update. Never blocks: if the host is not draining the CDC port the frame is dropped.
+void feedPublish(const char *label, const quote &q);
+
+// Number of frames dropped because the USB buffer was full
+uint32_t feedDropped();
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+// Time source for the firmware logic. On the device these are millis(), delay() and time().
+// Built with -D VIRTUAL_CLOCK, time only moves when the firmware sleeps or the harness calls
+// clockAdvance(), so the scheduler, fetch and render logic can replay a recorded trading day
+// much faster than real time.
+
+#ifdef VIRTUAL_CLOCK
+
+extern uint64_t virtual_now_us;             // Since boot
+extern time_t virtual_epoch;                // Wall clock at boot, 0 if not set
+
+inline unsigned long clockMillis() { return virtual_now_us / 1000; }
+inline void clockAdvance(uint64_t us) { virtual_now_us += us; }
+inline void clockDelay(unsigned long ms) { clockAdvance((uint64_t)ms * 1000); }
+inline time_t clockTime() { return virtual_epoch ? virtual_epoch + (time_t)(virtual_now_us / 1000000) : 0; }
+
+#else
+
+inline unsigned long clockMillis() { return millis(); }
+inline void clockDelay(unsigned long ms) { delay(ms); }
+inline time_t clockTime() { return time(nullptr); }
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "quote.h"
+
+// The symbols we fetch and show, and their latest quotes
+
+const int WATCHLIST_MAX = 64;
+
+typedef struct {
+  char symbol[16];            // Yahoo Finance symbol, e.g. "^SPX"
+  char label[8];              // Name shown on the display
+  float scale;                // Display multiplier (the 10 year yield is shown x1000)
+  char sep;                   // Thousands separator used on the display
+} watch_entry;
+
+extern watch_entry watchlist[WATCHLIST_MAX];
+extern quote quotes[WATCHLIST_MAX];
+extern int watchlist_count;
+extern uint32_t watchlist_version;  // Bumped on every change, for layouts derived from the list
+
+// Load the saved watchlist, or the default one
+void watchlistBegin();
+
+// Replace and save the watchlist. list is comma separated "SYMBOL" or "SYMBOL:LABEL" entries.
+// Returns false, keeping the current list, if it holds no valid entry.
+bool watchlistSet(const char *list);
+
+// Index of symbol in the watchlist, or -1
+int watchlistFind(const char *symbol);
+
+// Append symbol ("SYMBOL" or "SYMBOL:LABEL") and save the list. Returns its index, the index it
+// already had if listed, or -1 when the list is full.
+int watchlistAdd(const char *symbol);
+
+// The watchlist in the format watchlistSet() takes
+String watchlistText();
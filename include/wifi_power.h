@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+// Power-aware Wi-Fi: between fetches the station sits in modem sleep, waking for the AP's beacon
+// only every listen interval, which is derived from the poll interval. Shortly before each
+// scheduled fetch the radio is switched fully on, and it goes back to sleep right after.
+
+// Tell the power manager how long it was since the last fetch, or the expected interval before
+// the first one. The listen interval follows a running average, and takes effect on the next association.
+void wifiPowerSetPollInterval(unsigned long ms);
+
+// Listen interval the next association will use, in beacon intervals
+uint16_t wifiPowerListenInterval();
+
+// Write the listen interval into the station config. Call between WiFi.begin(..., false) and esp_wifi_connect().
+void wifiPowerConfigure();
+
+// Wake the radio if next_fetch (millis) is close, and account radio time. Call every frame.
+void wifiPowerPoll(bool connected, unsigned long next_fetch);
+
+// Back to modem sleep after a fetch
+void wifiPowerSleep();
+
+// Keep the radio fully on while held, e.g. through a scan, which misses access points in modem sleep
+void wifiPowerHold(bool on);
+
+// Estimated radio-on time, in ms per hour, since boot
+uint32_t wifiPowerRadioOnPerHour();
@@ -0,0 +1,19 @@
+#pragma once
+
+// Saved Wi-Fi networks, most recently added first, kept in NVS
+
+const int WIFI_MAX_NETWORKS = 5;
+
+typedef struct {
+  char ssid[33];
+  char pass[65];
+} wifi_network;
+
+// Read the saved networks into nets (WIFI_MAX_NETWORKS entries). Returns how many there are.
+int wifiStoreLoad(wifi_network *nets);
+
+// Save a network, replacing one with the same SSID. The oldest one is forgotten when full.
+void wifiStoreAdd(const char *ssid, const char *pass);
+
+// The saved entry for ssid, or nullptr if it is not saved
+const wifi_network *wifiStoreFind(const wifi_network *nets, int count, const char *ssid);
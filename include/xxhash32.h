@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Incremental xxHash32, so a response can be hashed chunk by chunk while it is being received.
+// No Arduino dependencies.
+
+class XXHash32 {
+public:
+  explicit XXHash32(uint32_t seed = 0) { reset(seed); }
+
+  void reset(uint32_t seed = 0);
+  void update(const void *data, size_t len);
+  uint32_t digest() const;
+
+  // Hash of a whole buffer at once
+  static uint32_t hash(const void *data, size_t len, uint32_t seed = 0);
+
+private:
+  uint32_t _v[4];
+  uint32_t _seed;
+  uint64_t _total;
+  uint8_t _buf[16];                         // Bytes waiting for a full stripe
+  size_t _buffered;
+};
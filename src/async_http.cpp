@@ -0,0 +1,808 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include "async_http.h"
+
+#ifndef AHTTP_TLS
+#ifdef ARDUINO
+#define AHTTP_TLS 1
+#else
+#define AHTTP_TLS 0
+#endif
+#endif
+
+#ifndef AHTTP_LWIP_DNS
+#ifdef ARDUINO
+#define AHTTP_LWIP_DNS 1
+#else
+#define AHTTP_LWIP_DNS 0
+#endif
+#endif
+
+#if AHTTP_LWIP_DNS
+#include <atomic>
+#include <lwip/dns.h>
+#include <lwip/priv/tcpip_priv.h>
+#endif
+
+#if AHTTP_TLS
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// ------------------------------------------------------------------------------------
+const int IO_WOULD_BLOCK = -1;
+const int IO_ERROR = -2;
+const int DNS_CACHE = 4;
+const char *USER_AGENT = "ESP32HTTPClient";
+
+typedef struct {
+  char host[64];
+  struct in_addr addr;
+  uint32_t at;
+} dns_entry;
+
+static dns_entry dns_cache[DNS_CACHE];
+static int dns_next = 0;
+// ------------------------------------------------------------------------------------
+
+// Address of host if the cache has it fresh
+static bool dnsCached(const char *host, uint32_t now_ms, struct in_addr &out) {
+  for (dns_entry &e : dns_cache) {
+    if (e.host[0] != '\0' && strcmp(e.host, host) == 0 && now_ms - e.at < AHTTP_DNS_TTL) {
+      out = e.addr;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void dnsStore(const char *host, const struct in_addr &addr, uint32_t now_ms) {
+  dns_entry &e = dns_cache[dns_next];
+  dns_next = (dns_next + 1) % DNS_CACHE;
+  snprintf(e.host, sizeof(e.host), "%s", host);
+  e.addr = addr;
+  e.at = now_ms;
+}
+
+#if AHTTP_LWIP_DNS
+// ------------------------------------------------------------------------------------
+// Lookups in the background: dns_gethostbyname() answers from lwIP's own cache right away, or
+// later through a callback on the tcpip thread, which fills a slot for the next poll to pick up
+
+enum { LOOKUP_FREE, LOOKUP_RUNNING, LOOKUP_FOUND, LOOKUP_FAILED };
+
+typedef struct {
+  char host[64];
+  std::atomic<int> state;                   // LOOKUP_xxx
+  struct in_addr addr;
+} dns_lookup;
+
+typedef struct {
+  struct tcpip_api_call_data call;          // First: tcpip_api_call() hands over a pointer to it
+  dns_lookup *lookup;
+  ip_addr_t addr;
+} dns_call;
+
+static dns_lookup dns_lookups[DNS_CACHE];
+
+static void dnsFound(const char *, const ip_addr_t *ip, void *arg) {
+  dns_lookup *l = (dns_lookup *)arg;
+  if (ip != nullptr && IP_IS_V4(ip)) {
+    l->addr.s_addr = ip4_addr_get_u32(ip_2_ip4(ip));
+    l->state.store(LOOKUP_FOUND);
+  } else {
+    l->state.store(LOOKUP_FAILED);
+  }
+}
+
+// Runs on the tcpip thread, where lwIP wants its DNS calls
+static err_t dnsStart(struct tcpip_api_call_data *call) {
+  dns_call *c = (dns_call *)call;
+  return dns_gethostbyname(c->lookup->host, &c->addr, dnsFound, c->lookup);
+}
+
+// IPv4 address of host: 1 with out set, 0 while the lookup is running, -1 when it failed
+static int resolve(const char *host, uint32_t now_ms, struct in_addr &out) {
+  if (dnsCached(host, now_ms, out)) {
+    return 1;
+  }
+
+  // A lookup of the same name, perhaps started by another request
+  dns_lookup *free_slot = nullptr;
+  for (dns_lookup &l : dns_lookups) {
+    int state = l.state.load();
+    if (state != LOOKUP_FREE && strcmp(l.host, host) == 0) {
+      if (state == LOOKUP_RUNNING) {
+        return 0;
+      }
+      l.state.store(LOOKUP_FREE);
+      if (state == LOOKUP_FAILED) {
+        return -1;
+      }
+      out = l.addr;
+      dnsStore(host, out, now_ms);
+      return 1;
+    }
+    if (state != LOOKUP_RUNNING && free_slot == nullptr) {
+      free_slot = &l;                       // An answer nobody came back for can go
+    }
+  }
+  if (free_slot == nullptr) {
+    return 0;                               // All slots busy, try again on the next poll
+  }
+
+  snprintf(free_slot->host, sizeof(free_slot->host), "%s", host);
+  free_slot->state.store(LOOKUP_RUNNING);
+  dns_call c = {};
+  c.lookup = free_slot;
+  err_t err = tcpip_api_call(dnsStart, &c.call);
+  if (err == ERR_INPROGRESS) {
+    return 0;
+  }
+  free_slot->state.store(LOOKUP_FREE);
+  if (err != ERR_OK || !IP_IS_V4(&c.addr)) {
+    return -1;
+  }
+  out.s_addr = ip4_addr_get_u32(ip_2_ip4(&c.addr));
+  dnsStore(host, out, now_ms);
+  return 1;
+}
+#else
+// IPv4 address of host: 1 with out set, -1 when the lookup failed. getaddrinfo() blocks, so it
+// only runs on a cache miss.
+static int resolve(const char *host, uint32_t now_ms, struct in_addr &out) {
+  if (dnsCached(host, now_ms, out)) {
+    return 1;
+  }
+  struct addrinfo hints = {};
+  struct addrinfo *res = nullptr;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, nullptr, &hints, &res) != 0 || res == nullptr) {
+    return -1;
+  }
+  out = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+  freeaddrinfo(res);
+  dnsStore(host, out, now_ms);
+  return 1;
+}
+#endif
+
+#if AHTTP_TLS
+// ------------------------------------------------------------------------------------
+// mbedTLS over the non-blocking socket
+
+typedef struct {
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_entropy_context entropy;
+  int fd;
+  bool wantWrite;
+} tls_session;
+
+static int tlsSend(void *ctx, const unsigned char *buf, size_t len) {
+  int n = send(((tls_session *)ctx)->fd, buf, len, MSG_NOSIGNAL);
+  if (n < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+  }
+  return n;
+}
+
+static int tlsRecv(void *ctx, unsigned char *buf, size_t len) {
+  int n = recv(((tls_session *)ctx)->fd, buf, len, 0);
+  if (n < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+  }
+  return n;
+}
+
+static void tlsFree(void *p) {
+  tls_session *t = (tls_session *)p;
+  if (t == nullptr) {
+    return;
+  }
+  mbedtls_ssl_free(&t->ssl);
+  mbedtls_ssl_config_free(&t->conf);
+  mbedtls_ctr_drbg_free(&t->drbg);
+  mbedtls_entropy_free(&t->entropy);
+  free(t);
+}
+
+static void *tlsOpen(int fd, const char *host) {
+  tls_session *t = (tls_session *)calloc(1, sizeof(tls_session));
+  if (t == nullptr) {
+    return nullptr;
+  }
+  t->fd = fd;
+  mbedtls_ssl_init(&t->ssl);
+  mbedtls_ssl_config_init(&t->conf);
+  mbedtls_ctr_drbg_init(&t->drbg);
+  mbedtls_entropy_init(&t->entropy);
+  if (mbedtls_ctr_drbg_seed(&t->drbg, mbedtls_entropy_func, &t->entropy, nullptr, 0) != 0 ||
+      mbedtls_ssl_config_defaults(&t->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                  MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+    tlsFree(t);
+    return nullptr;
+  }
+  mbedtls_ssl_conf_authmode(&t->conf, MBEDTLS_SSL_VERIFY_NONE);
+  mbedtls_ssl_conf_rng(&t->conf, mbedtls_ctr_drbg_random, &t->drbg);
+  if (mbedtls_ssl_setup(&t->ssl, &t->conf) != 0 || mbedtls_ssl_set_hostname(&t->ssl, host) != 0) {
+    tlsFree(t);
+    return nullptr;
+  }
+  mbedtls_ssl_set_bio(&t->ssl, t, tlsSend, tlsRecv, nullptr);
+  return t;
+}
+
+// 1 when done, 0 to be called again, -1 on failure
+static int tlsHandshake(void *p) {
+  tls_session *t = (tls_session *)p;
+  int r = mbedtls_ssl_handshake(&t->ssl);
+  t->wantWrite = r == MBEDTLS_ERR_SSL_WANT_WRITE;
+  if (r == 0) {
+    return 1;
+  }
+  return r == MBEDTLS_ERR_SSL_WANT_READ || r == MBEDTLS_ERR_SSL_WANT_WRITE ? 0 : -1;
+}
+
+static int tlsRead(void *p, uint8_t *buf, size_t len) {
+  tls_session *t = (tls_session *)p;
+  int r = mbedtls_ssl_read(&t->ssl, buf, len);
+  t->wantWrite = r == MBEDTLS_ERR_SSL_WANT_WRITE;
+  if (r >= 0) {
+    return r;
+  }
+  if (r == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+    return 0;
+  }
+  return r == MBEDTLS_ERR_SSL_WANT_READ || r == MBEDTLS_ERR_SSL_WANT_WRITE ? IO_WOULD_BLOCK : IO_ERROR;
+}
+
+static int tlsWrite(void *p, const uint8_t *buf, size_t len) {
+  tls_session *t = (tls_session *)p;
+  int r = mbedtls_ssl_write(&t->ssl, buf, len);
+  t->wantWrite = r == MBEDTLS_ERR_SSL_WANT_WRITE;
+  if (r >= 0) {
+    return r;
+  }
+  return r == MBEDTLS_ERR_SSL_WANT_READ || r == MBEDTLS_ERR_SSL_WANT_WRITE ? IO_WOULD_BLOCK : IO_ERROR;
+}
+
+static bool tlsWantsWrite(void *p) {
+  return ((tls_session *)p)->wantWrite;
+}
+
+static bool tlsPending(void *p) {
+  return mbedtls_ssl_get_bytes_avail(&((tls_session *)p)->ssl) > 0;
+}
+#else
+// Host builds: plain HTTP only
+static void *tlsOpen(int, const char *) { return nullptr; }
+static void tlsFree(void *) {}
+static int tlsHandshake(void *) { return -1; }
+static int tlsRead(void *, uint8_t *, size_t) { return IO_ERROR; }
+static int tlsWrite(void *, const uint8_t *, size_t) { return IO_ERROR; }
+static bool tlsWantsWrite(void *) { return false; }
+static bool tlsPending(void *) { return false; }
+#endif
+
+// ------------------------------------------------------------------------------------
+
+AsyncHttp::AsyncHttp() {
+}
+
+AsyncHttp::~AsyncHttp() {
+  closeConnection();
+}
+
+bool AsyncHttp::get(const char *url, ahttp_sink sink, void *ctx, uint32_t now_ms) {
+  return start("GET", url, nullptr, nullptr, 0, sink, ctx, now_ms);
+}
+
+bool AsyncHttp::post(const char *url, const char *content_type, const uint8_t *payload, size_t len,
+                     ahttp_sink sink, void *ctx, uint32_t now_ms) {
+  return start("POST", url, content_type, payload, len, sink, ctx, now_ms);
+}
+
+bool AsyncHttp::start(const char *method, const char *url, const char *content_type, const uint8_t *payload,
+                      size_t len, ahttp_sink sink, void *ctx, uint32_t now_ms) {
+  // Split "scheme://host[:port]/path"
+  bool https;
+  if (strncmp(url, "https://", 8) == 0) {
+    https = true;
+    url += 8;
+  } else if (strncmp(url, "http://", 7) == 0) {
+    https = false;
+    url += 7;
+  } else {
+    fail(AHTTP_ERROR_URL);
+    return false;
+  }
+  const char *path = strchr(url, '/');
+  size_t authority = path ? path - url : strlen(url);
+  const char *colon = (const char *)memchr(url, ':', authority);
+  size_t host_len = colon ? colon - url : authority;
+  uint16_t port = colon ? atoi(colon + 1) : https ? 443 : 80;
+  if (host_len == 0 || host_len >= sizeof(_host) || port == 0 || (https && !AHTTP_TLS)) {
+    fail(AHTTP_ERROR_URL);
+    return false;
+  }
+  char host[sizeof(_host)];
+  memcpy(host, url, host_len);
+  host[host_len] = '\0';
+
+  int n = snprintf(_request, sizeof(_request),
+                   "%s %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: %s\r\nConnection: keep-alive\r\n", method,
+                   path ? path : "/", host, USER_AGENT);
+  if (n > 0 && (size_t)n < sizeof(_request) && payload != nullptr) {
+    n += snprintf(_request + n, sizeof(_request) - n, "Content-Type: %s\r\nContent-Length: %u\r\n",
+                  content_type, (unsigned)len);
+  }
+  if (n > 0 && (size_t)n < sizeof(_request)) {
+    n += snprintf(_request + n, sizeof(_request) - n, "\r\n");
+  }
+  if (n <= 0 || (size_t)n >= sizeof(_request)) {
+    fail(AHTTP_ERROR_URL);
+    return false;
+  }
+  _requestLen = n;
+  _payload = payload;
+  _payloadLen = payload != nullptr ? len : 0;
+  _sent = 0;
+  _sink = sink;
+  _ctx = ctx;
+  _status = 0;
+  _lineLen = 0;
+  _body = BODY_NONE;
+  _contentLength = -1;
+  _received = 0;
+  _chunked = false;
+  _retried = false;
+  _responded = false;
+  _since = now_ms;
+
+  // Reuse the connection of the previous request if it is to the same server and was kept open
+  _reused = _fd >= 0 && _state == AHTTP_DONE && _keepAlive && _https == https && _port == port &&
+            strcmp(_host, host) == 0;
+  _keepAlive = true;
+  if (_reused) {
+    _state = AHTTP_SENDING;
+    return true;
+  }
+  closeConnection();
+  memcpy(_host, host, host_len + 1);
+  _port = port;
+  _https = https;
+  return connectStart(now_ms);
+}
+
+bool AsyncHttp::connectStart(uint32_t now_ms) {
+  _since = now_ms;
+  _state = AHTTP_RESOLVING;
+  stepResolve(now_ms);
+  return _state != AHTTP_FAILED;
+}
+
+// Connect as soon as the name is resolved
+bool AsyncHttp::stepResolve(uint32_t now_ms) {
+  struct in_addr addr;
+  int r = resolve(_host, now_ms, addr);
+  if (r == 0) {
+    return false;
+  }
+  if (r < 0) {
+    fail(AHTTP_ERROR_DNS);
+  } else {
+    openSocket(addr);
+  }
+  return true;
+}
+
+bool AsyncHttp::openSocket(const struct in_addr &ip) {
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_port);
+  addr.sin_addr = ip;
+  _fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (_fd < 0) {
+    fail(AHTTP_ERROR_CONNECT);
+    return false;
+  }
+  fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+  int one = 1;
+  setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (connect(_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 && errno != EINPROGRESS) {
+    fail(AHTTP_ERROR_CONNECT);
+    return false;
+  }
+  _state = AHTTP_CONNECTING;
+  return true;
+}
+
+ahttp_state AsyncHttp::poll(uint32_t now_ms) {
+  bool progress = true;
+  while (progress && busy()) {
+    switch (_state) {
+      case AHTTP_RESOLVING:
+        progress = stepResolve(now_ms);
+        break;
+      case AHTTP_CONNECTING:
+        progress = stepConnect();
+        break;
+      case AHTTP_HANDSHAKE:
+        progress = stepHandshake();
+        break;
+      case AHTTP_SENDING:
+        progress = stepSend();
+        break;
+      default:
+        progress = stepReceive();
+        break;
+    }
+    if (progress) {
+      _since = now_ms;
+    }
+  }
+  // A kept-alive connection the server has dropped in the meantime fails before any response
+  if (_state == AHTTP_FAILED && _reused && !_retried && !_responded &&
+      (_status == AHTTP_ERROR_SEND || _status == AHTTP_ERROR_RECEIVE || _status == AHTTP_ERROR_CLOSED)) {
+    return retryStale(now_ms) ? poll(now_ms) : _state;
+  }
+  if (busy() && now_ms - _since > phaseTimeout()) {
+    fail(AHTTP_ERROR_TIMEOUT);
+  }
+  return _state;
+}
+
+bool AsyncHttp::retryStale(uint32_t now_ms) {
+  _retried = true;
+  _reused = false;
+  _sent = 0;
+  _status = 0;
+  closeConnection();
+  return connectStart(now_ms);
+}
+
+uint32_t AsyncHttp::phaseTimeout() const {
+  switch (_state) {
+    case AHTTP_RESOLVING:
+    case AHTTP_CONNECTING:
+      return _connectTimeout;
+    case AHTTP_HANDSHAKE:
+      return _handshakeTimeout;
+    default:
+      return _readTimeout;
+  }
+}
+
+bool AsyncHttp::stepConnect() {
+  fd_set wr;
+  FD_ZERO(&wr);
+  FD_SET(_fd, &wr);
+  struct timeval zero = { 0, 0 };
+  if (select(_fd + 1, nullptr, &wr, nullptr, &zero) <= 0) {
+    return false;
+  }
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+    fail(AHTTP_ERROR_CONNECT);
+    return true;
+  }
+  if (_https) {
+    _tls = tlsOpen(_fd, _host);
+    if (_tls == nullptr) {
+      fail(AHTTP_ERROR_TLS);
+      return true;
+    }
+    _state = AHTTP_HANDSHAKE;
+  } else {
+    _state = AHTTP_SENDING;
+  }
+  return true;
+}
+
+bool AsyncHttp::stepHandshake() {
+  int r = tlsHandshake(_tls);
+  if (r < 0) {
+    fail(AHTTP_ERROR_TLS);
+    return true;
+  }
+  if (r == 0) {
+    return false;
+  }
+  _state = AHTTP_SENDING;
+  return true;
+}
+
+// The request line and headers, then the payload of a POST
+bool AsyncHttp::stepSend() {
+  int n = _sent < _requestLen ? ioWrite((const uint8_t *)_request + _sent, _requestLen - _sent)
+                              : ioWrite(_payload + (_sent - _requestLen), _requestLen + _payloadLen - _sent);
+  if (n == IO_WOULD_BLOCK) {
+    return false;
+  }
+  if (n <= 0) {
+    fail(AHTTP_ERROR_SEND);
+    return true;
+  }
+  _sent += n;
+  if (_sent == _requestLen + _payloadLen) {
+    _state = AHTTP_HEADERS;
+  }
+  return true;
+}
+
+bool AsyncHttp::stepReceive() {
+  uint8_t buf[AHTTP_READ_CHUNK];
+  int n = ioRead(buf, sizeof(buf));
+  if (n == IO_WOULD_BLOCK) {
+    return false;
+  }
+  if (n == IO_ERROR) {
+    fail(AHTTP_ERROR_RECEIVE);
+  } else if (n == 0) {
+    // The end of the connection is the end of a body without a length
+    if (_state == AHTTP_BODY && _body == BODY_CLOSE) {
+      _keepAlive = false;
+      finish();
+    } else {
+      fail(AHTTP_ERROR_CLOSED);
+    }
+  } else {
+    _responded = true;
+    consume(buf, n);
+  }
+  return true;
+}
+
+void AsyncHttp::consume(const uint8_t *data, size_t len) {
+  size_t i = 0;
+  while (i < len && busy()) {
+    if (_state == AHTTP_HEADERS || (_body == BODY_CHUNKED && _chunk != CHUNK_DATA)) {
+      char c = data[i++];
+      if (c == '\n') {
+        _line[_lineLen] = '\0';
+        headerLine();
+        _lineLen = 0;
+      } else if (c != '\r' && _lineLen < sizeof(_line) - 1) {
+        _line[_lineLen++] = c;
+      }
+      continue;
+    }
+
+    // Body bytes: up to the end of the length or chunk, or everything until the connection closes
+    size_t n = len - i;
+    if (_body != BODY_CLOSE && n > _remaining) {
+      n = _remaining;
+    }
+    if (_sink != nullptr && !_sink(_ctx, data + i, n)) {
+      fail(AHTTP_ERROR_SINK);
+      return;
+    }
+    i += n;
+    _received += n;
+    if (_body == BODY_CLOSE) {
+      continue;
+    }
+    _remaining -= n;
+    if (_remaining == 0) {
+      if (_body == BODY_LENGTH) {
+        finish();
+      } else {
+        _chunk = CHUNK_DATA_END;
+      }
+    }
+  }
+}
+
+// A complete line of the headers, or of the chunk framing
+void AsyncHttp::headerLine() {
+  if (_state == AHTTP_BODY) {
+    switch (_chunk) {
+      case CHUNK_SIZE:
+        _remaining = strtoull(_line, nullptr, 16);
+        _chunk = _remaining > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+        break;
+      case CHUNK_DATA_END:
+        _chunk = CHUNK_SIZE;
+        break;
+      default:
+        if (_lineLen == 0) {
+          finish();                         // End of the trailers
+        }
+        break;
+    }
+    return;
+  }
+
+  if (_status == 0) {
+    int major, minor;
+    if (sscanf(_line, "HTTP/%d.%d %d", &major, &minor, &_status) != 3 || _status < 100) {
+      fail(AHTTP_ERROR_PROTOCOL);
+      return;
+    }
+    _keepAlive = major > 1 || minor >= 1;
+    return;
+  }
+  if (_lineLen == 0) {
+    if (_status < 200) {
+      _status = 0;                          // 100 Continue and the like, the real status follows
+    } else if (_status == 204 || _status == 304 || _contentLength == 0) {
+      finish();
+    } else if (_chunked) {
+      _body = BODY_CHUNKED;
+      _chunk = CHUNK_SIZE;
+      _state = AHTTP_BODY;
+    } else if (_contentLength > 0) {
+      _body = BODY_LENGTH;
+      _remaining = _contentLength;
+      _state = AHTTP_BODY;
+    } else {
+      _body = BODY_CLOSE;
+      _keepAlive = false;
+      _state = AHTTP_BODY;
+    }
+    return;
+  }
+
+  char *value = strchr(_line, ':');
+  if (value == nullptr) {
+    return;
+  }
+  *value++ = '\0';
+  while (*value == ' ' || *value == '\t') {
+    value++;
+  }
+  if (strcasecmp(_line, "Content-Length") == 0) {
+    _contentLength = strtoll(value, nullptr, 10);
+  } else if (strcasecmp(_line, "Transfer-Encoding") == 0) {
+    _chunked = strcasestr(value, "chunked") != nullptr;
+  } else if (strcasecmp(_line, "Connection") == 0) {
+    if (strcasestr(value, "close") != nullptr) {
+      _keepAlive = false;
+    } else if (strcasestr(value, "keep-alive") != nullptr) {
+      _keepAlive = true;
+    }
+  }
+}
+
+void AsyncHttp::finish() {
+  _state = AHTTP_DONE;
+  if (!_keepAlive) {
+    closeConnection();
+  }
+}
+
+void AsyncHttp::fail(int error) {
+  _status = error;
+  _state = AHTTP_FAILED;
+  closeConnection();
+}
+
+void AsyncHttp::stop() {
+  closeConnection();
+  _state = AHTTP_IDLE;
+}
+
+void AsyncHttp::closeConnection() {
+  if (_tls != nullptr) {
+    tlsFree(_tls);
+    _tls = nullptr;
+  }
+  if (_fd >= 0) {
+    close(_fd);
+    _fd = -1;
+  }
+}
+
+int AsyncHttp::ioRead(uint8_t *buf, size_t len) {
+  if (_tls != nullptr) {
+    return tlsRead(_tls, buf, len);
+  }
+  int n = recv(_fd, buf, len, 0);
+  if (n < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? IO_WOULD_BLOCK : IO_ERROR;
+  }
+  return n;
+}
+
+int AsyncHttp::ioWrite(const uint8_t *buf, size_t len) {
+  if (_tls != nullptr) {
+    return tlsWrite(_tls, buf, len);
+  }
+  int n = send(_fd, buf, len, MSG_NOSIGNAL);
+  if (n < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? IO_WOULD_BLOCK : IO_ERROR;
+  }
+  return n;
+}
+
+bool AsyncHttp::wantsWrite() const {
+  if (_state == AHTTP_CONNECTING || _state == AHTTP_SENDING) {
+    return true;
+  }
+  return _tls != nullptr && tlsWantsWrite(_tls);
+}
+
+bool AsyncHttp::readable() const {
+  return _tls != nullptr && tlsPending(_tls);
+}
+
+int asyncHttpWait(AsyncHttp *const *requests, int count, uint32_t timeout_ms) {
+  fd_set rd, wr;
+  FD_ZERO(&rd);
+  FD_ZERO(&wr);
+  int max_fd = -1;
+  bool resolving = false;
+  for (int i = 0; i < count; i++) {
+    const AsyncHttp *r = requests[i];
+    resolving |= r->state() == AHTTP_RESOLVING;
+    if (!r->busy() || r->fd() < 0) {
+      continue;
+    }
+    if (r->readable()) {
+      return 1;
+    }
+    FD_SET(r->fd(), r->wantsWrite() ? &wr : &rd);
+    if (r->fd() > max_fd) {
+      max_fd = r->fd();
+    }
+  }
+  if (max_fd < 0 && !resolving) {
+    return 0;
+  }
+  // A lookup finishing has no descriptor to wake us, so look again shortly
+  if (resolving && timeout_ms > AHTTP_DNS_POLL) {
+    timeout_ms = AHTTP_DNS_POLL;
+  }
+  struct timeval tv = { (long)(timeout_ms / 1000), (long)(timeout_ms % 1000) * 1000 };
+  int n = select(max_fd + 1, &rd, &wr, nullptr, &tv);
+  return n > 0 ? n : 0;
+}
+
+const char *asyncHttpErrorName(int status) {
+  switch (status) {
+    case AHTTP_ERROR_URL:
+      return "bad URL";
+    case AHTTP_ERROR_DNS:
+      return "DNS failed";
+    case AHTTP_ERROR_CONNECT:
+      return "connect failed";
+    case AHTTP_ERROR_TLS:
+      return "TLS failed";
+    case AHTTP_ERROR_SEND:
+      return "send failed";
+    case AHTTP_ERROR_RECEIVE:
+      return "receive failed";
+    case AHTTP_ERROR_CLOSED:
+      return "connection closed";
+    case AHTTP_ERROR_PROTOCOL:
+      return "bad response";
+    case AHTTP_ERROR_TIMEOUT:
+      return "timeout";
+    case AHTTP_ERROR_SINK:
+      return "body refused";
+    default:
+      return status > 0 ? "HTTP status" : "unknown";
+  }
+}
@@ -0,0 +1,137 @@
+
+#include <Arduino.h>
+#include <time.h>
+#include <driver/ledc.h>
+#include <soc/soc_caps.h>
+
+#include "pin_config.h"
+#include "backlight.h"
+#include "log.h"
+#include "vclock.h"
+
+// ------------------------------------------------------------------------------------
+const ledc_mode_t BL_MODE = LEDC_LOW_SPEED_MODE;
+const ledc_channel_t BL_CHANNEL = LEDC_CHANNEL_0;
+const ledc_timer_t BL_TIMER = LEDC_TIMER_0;
+const uint32_t BL_FREQ = 5000;
+const uint32_t BL_MAX = 255;                // 8 bit duty
+
+const uint32_t LEVEL_MARKET = 255;          // Regular session
+const uint32_t LEVEL_EXTENDED = 100;        // Pre-market and after hours
+const uint32_t LEVEL_NIGHT = 20;            // Nights and weekends
+const int FADE_MS = 1500;
+const unsigned long WAKE_MS = 30000;        // How long a button press keeps the backlight up
+
+// Schedule in minutes since midnight, exchange time, weekdays only
+const int PRE_MARKET_OPEN = 7 * 60;
+const int MARKET_OPEN = 9 * 60 + 30;
+const int MARKET_CLOSE = 16 * 60;
+const int AFTER_HOURS_CLOSE = 20 * 60;
+
+static volatile bool button_pressed = false;
+static unsigned long wake_until = 0;
+static uint32_t target = BL_MAX;
+static unsigned long fade_until = 0;        // The fade API blocks while a fade is running, so we wait it out
+static unsigned long last_account;
+static uint64_t duty_ms = 0;                // Integral of duty * time, for the power estimate
+static uint64_t total_ms = 0;
+// ------------------------------------------------------------------------------------
+
+static void IRAM_ATTR onButton() {
+  button_pressed = true;
+}
+
+// Brightness the schedule asks for right now. Full brightness until the clock is set.
+static uint32_t scheduledLevel() {
+  time_t now = clockTime();
+  struct tm t;
+  localtime_r(&now, &t);
+  if (t.tm_year < 2020 - 1900) {
+    return LEVEL_MARKET;
+  }
+  if (t.tm_wday == 0 || t.tm_wday == 6) {
+    return LEVEL_NIGHT;
+  }
+  int minute = t.tm_hour * 60 + t.tm_min;
+  if (minute >= MARKET_OPEN && minute < MARKET_CLOSE) {
+    return LEVEL_MARKET;
+  }
+  if (minute >= PRE_MARKET_OPEN && minute < AFTER_HOURS_CLOSE) {
+    return LEVEL_EXTENDED;
+  }
+  return LEVEL_NIGHT;
+}
+
+void backlightBegin() {
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = BL_MODE;
+  timer.duty_resolution = LEDC_TIMER_8_BIT;
+  timer.timer_num = BL_TIMER;
+  timer.freq_hz = BL_FREQ;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_timer_config(&timer);
+
+  // The backlight is on when TFT_LEDA_PIN is low
+  ledc_channel_config_t channel = {};
+  channel.gpio_num = TFT_LEDA_PIN;
+  channel.speed_mode = BL_MODE;
+  channel.channel = BL_CHANNEL;
+  channel.timer_sel = BL_TIMER;
+  channel.duty = target;
+  channel.flags.output_invert = 1;
+  ledc_channel_config(&channel);
+  ledc_fade_func_install(0);
+
+  pinMode(BTN_PIN, INPUT_PULLUP);
+  attachInterrupt(BTN_PIN, onButton, FALLING);
+  last_account = clockMillis();
+}
+
+void backlightPoll() {
+  unsigned long now = clockMillis();
+  unsigned long dt = now - last_account;
+  last_account = now;
+  duty_ms += (uint64_t)ledc_get_duty(BL_MODE, BL_CHANNEL) * dt;
+  total_ms += dt;
+
+  bool fading = (long)(fade_until - now) > 0;
+#ifndef SOC_LEDC_SUPPORT_FADE_STOP
+  if (fading) {
+    return;                                 // No way to stop a fade: its end interrupt would restore its target
+  }
+#endif
+
+  // The button is served even during a fade: the user is looking at it now, so the fade is cut
+  // short and the duty set directly
+  if (button_pressed) {
+    button_pressed = false;
+    wake_until = now + WAKE_MS;
+    if (target != BL_MAX || fading) {
+      target = BL_MAX;
+#ifdef SOC_LEDC_SUPPORT_FADE_STOP
+      ledc_fade_stop(BL_MODE, BL_CHANNEL);
+#endif
+      ledc_set_duty(BL_MODE, BL_CHANNEL, target);
+      ledc_update_duty(BL_MODE, BL_CHANNEL);
+      fade_until = now;
+    }
+    return;
+  }
+
+  if (fading) {
+    return;
+  }
+
+  uint32_t level = (long)(wake_until - now) > 0 ? BL_MAX : scheduledLevel();
+  if (level != target) {
+    LOG_DEBUG("Backlight fading to %u/%u.", level, BL_MAX);
+    target = level;
+    ledc_set_fade_with_time(BL_MODE, BL_CHANNEL, target, FADE_MS);
+    ledc_fade_start(BL_MODE, BL_CHANNEL, LEDC_FADE_NO_WAIT);
+    fade_until = now + FADE_MS + 50;
+  }
+}
+
+uint32_t backlightAverageDuty() {
+  return total_ms ? duty_ms * 100 / (total_ms * BL_MAX) : 100;
+}
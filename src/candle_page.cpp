@@ -0,0 +1,103 @@
+
+#include <Arduino.h>
+
+#include "candle_page.h"
+#include "display.h"
+#include "watchlist.h"
+
+// ------------------------------------------------------------------------------------
+const char *INTERVAL_NAMES[CANDLE_INTERVALS] = { "1m", "5m", "15m" };
+const int HEADER_H = 18;                    // Label and price line above the chart
+const int COLUMN_W = TFT_HEIGHT / CANDLE_COUNT;
+const int BODY_INSET = 1;                   // Gap between candle bodies
+const int CHART_TOP = HEADER_H;
+const int CHART_H = TFT_WIDTH - HEADER_H - 1;
+const float RANGE_MARGIN = 0.1f;            // Head room above and below, so the current candle rarely outgrows the scale
+
+// What is on screen, to decide between a full and a one-column redraw
+static struct {
+  int symbol;
+  candle_interval interval;
+  uint32_t newest;                          // Start of the current candle
+  int count;
+  float lo, hi;                             // Price range of the chart area
+} drawn = { -1, CANDLE_1M, 0, 0, 0.0f, 0.0f };
+// ------------------------------------------------------------------------------------
+
+static int priceY(float v) {
+  return CHART_TOP + (int)((drawn.hi - v) * CHART_H / (drawn.hi - drawn.lo));
+}
+
+// Left edge of the column of candle index, candles being right aligned
+static int columnX(int index) {
+  return (CANDLE_COUNT - drawn.count + index) * COLUMN_W;
+}
+
+// Dotted previous close line over [x, x + w)
+static void drawReference(float previous_close, int x, int w) {
+  int y = priceY(previous_close);
+  for (int px = (x + 3) & ~3; px < x + w; px += 4) {
+    tft.drawPixel(px, y, TFT_DARKGREY);
+  }
+}
+
+static void drawCandle(const candle &c, int x) {
+  uint16_t colour = c.close >= c.open ? TFT_GREEN : TFT_RED;
+  int high = priceY(c.high), low = priceY(c.low);
+  int open = priceY(c.open), close = priceY(c.close);
+  tft.drawFastVLine(x + COLUMN_W / 2, high, low - high + 1, colour);
+  int top = min(open, close);
+  tft.fillRect(x + BODY_INSET, top, COLUMN_W - 2 * BODY_INSET, abs(open - close) + 1, colour);
+}
+
+// Current price at the top right, over the previous one
+static void drawPrice(const quote &q, const watch_entry &entry) {
+  uint16_t colour = !q.marketOpen ? TFT_DARKGREY : q.current >= q.previousClose ? TFT_GREEN : TFT_RED;
+  tft.fillRect(TFT_HEIGHT / 2, 0, TFT_HEIGHT / 2, HEADER_H, TFT_BLACK);
+  tft.setTextColor(colour, TFT_BLACK);
+  tft.setTextDatum(TR_DATUM);
+  tft.drawString(String(q.current * entry.scale, 1), TFT_HEIGHT, 0, 2);
+}
+
+bool drawCandlePage(int symbol, candle_interval interval, bool full) {
+  int count = symbol < watchlist_count ? candlesCount(symbol, interval) : 0;
+  if (count == 0) {
+    return false;
+  }
+  const quote &q = quotes[symbol];
+  const candle &current = candleAt(symbol, interval, count - 1);
+
+  // Only the current candle changed, and it still fits: repaint its column
+  if (!full && drawn.symbol == symbol && drawn.interval == interval && drawn.newest == current.start &&
+      current.low >= drawn.lo && current.high <= drawn.hi) {
+    int x = columnX(count - 1);
+    tft.fillRect(x, CHART_TOP, COLUMN_W, CHART_H + 1, TFT_BLACK);
+    drawReference(q.previousClose, x, COLUMN_W);
+    drawCandle(current, x);
+    drawPrice(q, watchlist[symbol]);
+    return true;
+  }
+
+  float lo = q.previousClose, hi = q.previousClose;
+  for (int i = 0; i < count; i++) {
+    const candle &c = candleAt(symbol, interval, i);
+    lo = min(lo, c.low);
+    hi = max(hi, c.high);
+  }
+  float margin = (hi - lo) * RANGE_MARGIN;
+  if (margin < hi * 1e-4f) {
+    margin = hi * 1e-4f + 1e-6f;
+  }
+  drawn = { symbol, interval, current.start, count, lo - margin, hi + margin };
+
+  tft.fillScreen(TFT_BLACK);
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  tft.setTextDatum(TL_DATUM);
+  tft.drawString(String(watchlist[symbol].label) + " " + INTERVAL_NAMES[interval], 0, 0, 2);
+  drawPrice(q, watchlist[symbol]);
+  drawReference(q.previousClose, 0, TFT_HEIGHT);
+  for (int i = 0; i < count; i++) {
+    drawCandle(candleAt(symbol, interval, i), columnX(i));
+  }
+  return true;
+}
@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <esp_heap_caps.h>
+#endif
+
+#include "candles.h"
+
+// ------------------------------------------------------------------------------------
+typedef struct {
+  candle ring[CANDLE_COUNT];
+  int newest;                               // Slot of the current candle
+  int count;
+} candle_series;
+
+static candle_series *store = nullptr;      // series_count * CANDLE_INTERVALS rings
+static int series_count = 0;
+// ------------------------------------------------------------------------------------
+
+static candle_series *ringFor(int series, candle_interval interval) {
+  if (store == nullptr || series < 0 || series >= series_count || interval < 0 || interval >= CANDLE_INTERVALS) {
+    return nullptr;
+  }
+  return &store[series * CANDLE_INTERVALS + interval];
+}
+
+bool candlesBegin(int series) {
+  size_t bytes = (size_t)series * CANDLE_INTERVALS * sizeof(candle_series);
+#ifdef ARDUINO
+  store = (candle_series *)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+  if (store == nullptr) {
+    store = (candle_series *)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+  }
+#else
+  store = (candle_series *)malloc(bytes);
+#endif
+  if (store == nullptr) {
+    series_count = 0;
+    return false;
+  }
+  series_count = series;
+  candlesClear();
+  return true;
+}
+
+void candlesAdd(int series, uint32_t t, double price) {
+  float p = (float)price;
+  for (int i = 0; i < CANDLE_INTERVALS; i++) {
+    candle_series *s = ringFor(series, (candle_interval)i);
+    if (s == nullptr) {
+      return;
+    }
+    uint32_t start = t - t % CANDLE_SECONDS[i];
+    candle *c = &s->ring[s->newest];
+
+    if (s->count > 0 && start == c->start) {
+      if (p > c->high) {
+        c->high = p;
+      }
+      if (p < c->low) {
+        c->low = p;
+      }
+      c->close = p;
+      continue;
+    }
+    if (s->count > 0 && start < c->start) {
+      continue;                             // Late tick for a closed candle
+    }
+
+    // First tick of a new bucket
+    s->newest = (s->newest + 1) % CANDLE_COUNT;
+    if (s->count < CANDLE_COUNT) {
+      s->count++;
+    }
+    c = &s->ring[s->newest];
+    c->start = start;
+    c->open = p;
+    c->high = p;
+    c->low = p;
+    c->close = p;
+  }
+}
+
+int candlesCount(int series, candle_interval interval) {
+  candle_series *s = ringFor(series, interval);
+  return s == nullptr ? 0 : s->count;
+}
+
+const candle &candleAt(int series, candle_interval interval, int index) {
+  candle_series *s = ringFor(series, interval);
+  return s->ring[(s->newest - s->count + 1 + index + CANDLE_COUNT) % CANDLE_COUNT];
+}
+
+void candlesClear() {
+  if (store == nullptr) {
+    return;
+  }
+  memset(store, 0, (size_t)series_count * CANDLE_INTERVALS * sizeof(candle_series));
+  for (int i = 0; i < series_count * CANDLE_INTERVALS; i++) {
+    store[i].newest = CANDLE_COUNT - 1;
+  }
+}
@@ -0,0 +1,81 @@
+
+#include <Arduino.h>
+
+#include "chart_page.h"
+#include "display.h"
+#include "lttb.h"
+#include "tsdb.h"
+#include "vclock.h"
+#include "watchlist.h"
+
+// ------------------------------------------------------------------------------------
+const uint32_t ZOOM_WINDOW[ZOOM_LEVELS] = { 2 * 3600, 24 * 3600, 5 * 24 * 3600 };
+const char *ZOOM_NAMES[ZOOM_LEVELS] = { "2H", "1D", "5D" };
+const int HEADER_H = 18;                  // Label and price line above the chart
+
+static_assert(ZOOM_LEVELS <= CHART_CACHE_ZOOMS, "every zoom level needs a cache slot");
+// ------------------------------------------------------------------------------------
+
+void chartReset() {
+  chartCacheClear();
+}
+
+bool drawChartPage(int symbol, chart_zoom zoom) {
+  if (symbol >= watchlist_count || tsdbCount(symbol) < 2) {
+    return false;
+  }
+  ChartCache *chart = chartCacheFor(symbol, zoom, ZOOM_WINDOW[zoom], TFT_HEIGHT);
+  chart->update(clockTime());
+
+  // Vertical range, including the previous close so the reference line is always visible
+  const quote &q = quotes[symbol];
+  float lo = q.previousClose, hi = q.previousClose;
+  int points = 0;
+  for (int x = 0; x < chart->columns(); x++) {
+    if (chart->count(x) > 0) {
+      lo = min(lo, chart->point(x).v);
+      hi = max(hi, chart->point(x).v);
+      points++;
+    }
+  }
+  if (points < 2) {
+    return false;
+  }
+  if (hi - lo < 1e-6f) {
+    hi = lo + 1.0f;
+  }
+  const int top = HEADER_H, height = TFT_WIDTH - HEADER_H - 1;
+  auto y = [&](float v) { return top + (int)((hi - v) * height / (hi - lo)); };
+
+  uint16_t colour = !q.marketOpen ? TFT_DARKGREY : q.current >= q.previousClose ? TFT_GREEN : TFT_RED;
+
+  tft.fillScreen(TFT_BLACK);
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  tft.setTextDatum(TL_DATUM);
+  tft.drawString(String(watchlist[symbol].label) + " " + ZOOM_NAMES[zoom], 0, 0, 2);
+  tft.setTextColor(colour, TFT_BLACK);
+  tft.setTextDatum(TR_DATUM);
+  tft.drawString(String(q.current * watchlist[symbol].scale, 1), TFT_HEIGHT, 0, 2);
+
+  // Previous close reference, dotted
+  int yc = y(q.previousClose);
+  for (int x = 0; x < TFT_HEIGHT; x += 4) {
+    tft.drawPixel(x, yc, TFT_DARKGREY);
+  }
+
+  int px = -1, py = 0;
+  for (int x = 0; x < chart->columns(); x++) {
+    if (chart->count(x) == 0) {
+      continue;
+    }
+    int cy = y(chart->point(x).v);
+    if (px >= 0) {
+      tft.drawLine(px, py, x, cy, colour);
+    } else {
+      tft.drawPixel(x, cy, colour);
+    }
+    px = x;
+    py = cy;
+  }
+  return true;
+}
@@ -0,0 +1,90 @@
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <esp_pm.h>
+
+#include "cpu_power.h"
+#include "log.h"
+
+// ------------------------------------------------------------------------------------
+// Typical ESP32-S3 active current with the radio idle, used for the power estimate
+const uint32_t IDLE_MA = 28;
+const uint32_t BOOST_MA = 43;
+
+static int boost_depth = 0;             // Nested CpuBoost objects alive (loop task only)
+static int64_t boosted_since = 0;       // esp_timer time when the current boost started
+static int64_t boost_us = 0;            // Total time boosted
+static int64_t started_us = 0;
+static bool dfs_active = false;         // The frequency really drops when idle; if not, all time is full speed
+#if CPU_DFS && CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t boost_lock;
+#endif
+// ------------------------------------------------------------------------------------
+
+void cpuPowerBegin() {
+  started_us = esp_timer_get_time();
+#if CPU_DFS && CONFIG_PM_ENABLE
+  esp_pm_config_esp32s3_t pm = {};
+  pm.max_freq_mhz = CPU_BOOST_MHZ;
+  pm.min_freq_mhz = CPU_IDLE_MHZ;
+  pm.light_sleep_enable = false;
+  if (esp_pm_configure(&pm) != ESP_OK ||
+      esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "boost", &boost_lock) != ESP_OK) {
+    LOG_ERROR("Power management not available, staying at %d MHz.", CPU_BOOST_MHZ);
+    return;
+  }
+  dfs_active = true;
+#elif CPU_DFS
+  if (!setCpuFrequencyMhz(CPU_IDLE_MHZ)) {
+    LOG_ERROR("Could not lower the CPU clock, staying at %d MHz.", CPU_BOOST_MHZ);
+    return;
+  }
+  dfs_active = true;
+#endif
+  LOG_INFO("CPU at %d MHz when idle, %d MHz when busy.", CPU_DFS ? CPU_IDLE_MHZ : CPU_BOOST_MHZ, CPU_BOOST_MHZ);
+}
+
+void cpuBoostAcquire() {
+  if (boost_depth++ > 0) {
+    return;
+  }
+  boosted_since = esp_timer_get_time();
+#if CPU_DFS && CONFIG_PM_ENABLE
+  if (boost_lock) esp_pm_lock_acquire(boost_lock);
+#elif CPU_DFS
+  if (dfs_active) setCpuFrequencyMhz(CPU_BOOST_MHZ);
+#endif
+}
+
+void cpuBoostRelease() {
+  if (--boost_depth > 0) {
+    return;
+  }
+#if CPU_DFS && CONFIG_PM_ENABLE
+  if (boost_lock) esp_pm_lock_release(boost_lock);
+#elif CPU_DFS
+  if (dfs_active) setCpuFrequencyMhz(CPU_IDLE_MHZ);
+#endif
+  boost_us += esp_timer_get_time() - boosted_since;
+}
+
+uint32_t cpuPowerBoostMs() {
+  int64_t us = boost_us;
+  if (boost_depth > 0) {
+    us += esp_timer_get_time() - boosted_since;
+  }
+  return dfs_active ? us / 1000 : (esp_timer_get_time() - started_us) / 1000;
+}
+
+uint32_t cpuPowerIdleMs() {
+  return (esp_timer_get_time() - started_us) / 1000 - cpuPowerBoostMs();
+}
+
+uint32_t cpuPowerAverageMa() {
+  uint64_t idle = cpuPowerIdleMs();
+  uint64_t boost = cpuPowerBoostMs();
+  if (idle + boost == 0) {
+    return 0;
+  }
+  return (idle * IDLE_MA + boost * BOOST_MA) / (idle + boost);
+}
@@ -0,0 +1,264 @@
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <esp_core_dump.h>
+#include <esp_ota_ops.h>
+
+#include "async_http.h"
+#include "crash_report.h"
+#include "log.h"
+#include "vclock.h"
+
+// ------------------------------------------------------------------------------------
+const int TRACE_SIZE = 16;                  // Events kept in the ring
+const int BT_DEPTH = 16;                    // Backtrace frames kept in the report
+const uint32_t TRACE_MAGIC = 0x54524331;    // Marks the RTC memory as initialised
+const unsigned long UPLOAD_RETRY = 60000;   // Wait between failed uploads
+const uint32_t UPLOAD_TIMEOUT = 2000;       // Per phase of the POST
+
+const char *TRACE_NAMES[TRACE_EVENTS] = {
+  "boot", "fetch_start", "fetch_done", "parse_done", "render", "wifi", "recovery"
+};
+
+typedef struct {
+  uint32_t ms;
+  int32_t arg;
+  uint8_t event;
+} trace_entry;
+
+// Survives a panic or watchdog reset, not a power cycle
+typedef struct {
+  uint32_t magic;
+  uint32_t next;
+  trace_entry events[TRACE_SIZE];
+  uint32_t heapFree;
+  uint32_t heapMinFree;
+  uint32_t heapLargest;
+} rtc_trace;
+
+// What is kept in NVS until it has been uploaded
+typedef struct {
+  uint32_t resetReason;
+  uint32_t pc;
+  uint32_t cause;
+  uint32_t vaddr;
+  uint32_t bt[BT_DEPTH];
+  uint32_t btDepth;
+  bool btCorrupted;
+  bool haveDump;                            // The fields above come from a core dump
+  char task[16];
+  char elfSha[17];                          // Prefix of the firmware ELF's SHA-256
+  uint32_t heapFree;
+  uint32_t heapMinFree;
+  uint32_t heapLargest;
+  uint32_t traceCount;
+  trace_entry trace[TRACE_SIZE];            // Oldest first
+} crash_summary;
+
+RTC_NOINIT_ATTR static rtc_trace rtc;
+static Preferences prefs;
+static bool pending = false;
+static unsigned long last_attempt = 0;
+static bool attempted = false;
+static AsyncHttp *upload = nullptr;         // The POST in flight, polled from the loop
+static String upload_url;
+static String upload_body;                  // Sent from here, so kept until the POST is done
+// ------------------------------------------------------------------------------------
+
+void crashTrace(trace_event event, int32_t arg) {
+  trace_entry &e = rtc.events[rtc.next % TRACE_SIZE];
+  e.ms = clockMillis();
+  e.arg = arg;
+  e.event = event;
+  rtc.next++;
+
+  // Finding the largest free block walks the heap, so only snapshot once per fetch and frame
+  if (event == TRACE_FETCH_START || event == TRACE_RENDER) {
+    rtc.heapFree = ESP.getFreeHeap();
+    rtc.heapMinFree = ESP.getMinFreeHeap();
+    rtc.heapLargest = ESP.getMaxAllocHeap();
+  }
+}
+
+static bool crashed(esp_reset_reason_t reason) {
+  return reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+         reason == ESP_RST_WDT || reason == ESP_RST_BROWNOUT;
+}
+
+// Fill the summary from the core dump in flash, when the SDK was built to write one
+static void readCoreDump(crash_summary &s) {
+#if CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH && CONFIG_ESP_COREDUMP_DATA_FORMAT_ELF
+  if (esp_core_dump_image_check() != ESP_OK) {
+    return;
+  }
+  esp_core_dump_summary_t *dump = (esp_core_dump_summary_t *)malloc(sizeof(esp_core_dump_summary_t));
+  if (dump == nullptr) {
+    return;
+  }
+  if (esp_core_dump_get_summary(dump) == ESP_OK) {
+    s.haveDump = true;
+    s.pc = dump->exc_pc;
+    s.cause = dump->ex_info.exc_cause;
+    s.vaddr = dump->ex_info.exc_vaddr;
+    s.btDepth = min((uint32_t)BT_DEPTH, (uint32_t)dump->exc_bt_info.depth);
+    memcpy(s.bt, dump->exc_bt_info.bt, s.btDepth * sizeof(uint32_t));
+    s.btCorrupted = dump->exc_bt_info.corrupted;
+    strlcpy(s.task, dump->exc_task, sizeof(s.task));
+    strlcpy(s.elfSha, (const char *)dump->app_elf_sha256, sizeof(s.elfSha));
+  }
+  free(dump);
+#endif
+}
+
+void crashReportBegin() {
+  bool valid = rtc.magic == TRACE_MAGIC;
+  esp_reset_reason_t reason = esp_reset_reason();
+
+  if (crashed(reason)) {
+    crash_summary *s = (crash_summary *)calloc(1, sizeof(crash_summary));
+    if (s != nullptr) {
+      s->resetReason = reason;
+      esp_ota_get_app_elf_sha256(s->elfSha, sizeof(s->elfSha));
+      readCoreDump(*s);
+
+      if (valid) {
+        s->heapFree = rtc.heapFree;
+        s->heapMinFree = rtc.heapMinFree;
+        s->heapLargest = rtc.heapLargest;
+        s->traceCount = min((uint32_t)TRACE_SIZE, rtc.next);
+        for (uint32_t i = 0; i < s->traceCount; i++) {
+          s->trace[i] = rtc.events[(rtc.next - s->traceCount + i) % TRACE_SIZE];
+        }
+      }
+
+      prefs.begin("crash", false);
+      prefs.putBytes("report", s, sizeof(crash_summary));
+      prefs.end();
+      LOG_WARN("Crash report saved (reset reason %d, pc 0x%08x).", (int)reason, (unsigned)s->pc);
+      free(s);
+    }
+  }
+
+  prefs.begin("crash", true);
+  pending = prefs.getBytesLength("report") == sizeof(crash_summary);
+  prefs.end();
+
+  // Start a fresh trace for this run
+  memset(&rtc, 0, sizeof(rtc));
+  rtc.magic = TRACE_MAGIC;
+  crashTrace(TRACE_BOOT, reason);
+}
+
+void crashReportSetCollector(const char *url) {
+  prefs.begin("crash", false);
+  prefs.putString("url", url);
+  prefs.end();
+}
+
+// Render the summary as the JSON document tools/crash_decode.py reads
+static String reportJson(const crash_summary &s) {
+  DynamicJsonDocument doc(3072);
+  char hex[11];
+
+  doc["device"] = WiFi.macAddress();
+  doc["elf_sha256"] = s.elfSha;
+  doc["reset_reason"] = s.resetReason;
+  doc["core_dump"] = s.haveDump;
+  if (s.haveDump) {
+    doc["task"] = s.task;
+    snprintf(hex, sizeof(hex), "0x%08x", (unsigned)s.pc);
+    doc["pc"] = hex;
+    doc["exc_cause"] = s.cause;
+    snprintf(hex, sizeof(hex), "0x%08x", (unsigned)s.vaddr);
+    doc["exc_vaddr"] = hex;
+    doc["bt_corrupted"] = s.btCorrupted;
+    JsonArray bt = doc.createNestedArray("backtrace");
+    for (uint32_t i = 0; i < s.btDepth; i++) {
+      snprintf(hex, sizeof(hex), "0x%08x", (unsigned)s.bt[i]);
+      bt.add(hex);
+    }
+  }
+
+  JsonObject heap = doc.createNestedObject("heap");
+  heap["free"] = s.heapFree;
+  heap["min_free"] = s.heapMinFree;
+  heap["largest_block"] = s.heapLargest;
+
+  JsonArray trace = doc.createNestedArray("trace");
+  for (uint32_t i = 0; i < s.traceCount; i++) {
+    JsonObject e = trace.createNestedObject();
+    e["ms"] = s.trace[i].ms;
+    e["event"] = s.trace[i].event < TRACE_EVENTS ? TRACE_NAMES[s.trace[i].event] : "?";
+    e["arg"] = s.trace[i].arg;
+  }
+
+  String out;
+  serializeJson(doc, out);
+  return out;
+}
+
+// The collector's answer is not used
+static bool discardBody(void *, const uint8_t *, size_t) {
+  return true;
+}
+
+// Forget the report once the collector took it
+static void uploadDone() {
+  int code = upload->status();
+  if (code >= 200 && code < 300) {
+    LOG_INFO("Crash report uploaded to %s.", upload_url);
+    prefs.begin("crash", false);
+    prefs.remove("report");
+    prefs.end();
+#if CONFIG_ESP_COREDUMP_ENABLE_TO_FLASH
+    esp_core_dump_image_erase();
+#endif
+    pending = false;
+  } else {
+    LOG_WARN("Crash report upload to %s failed (%d).", upload_url, code);
+  }
+  delete upload;
+  upload = nullptr;
+  upload_body = String();
+}
+
+void crashReportPoll(bool connected) {
+  if (upload != nullptr) {
+    upload->poll(clockMillis());
+    if (!upload->busy()) {
+      uploadDone();
+    }
+    return;
+  }
+  if (!pending || !connected || (attempted && clockMillis() - last_attempt < UPLOAD_RETRY)) {
+    return;
+  }
+  attempted = true;
+  last_attempt = clockMillis();
+
+  prefs.begin("crash", true);
+  upload_url = prefs.getString("url", "");
+  crash_summary *s = (crash_summary *)malloc(sizeof(crash_summary));
+  bool loaded = s != nullptr && prefs.getBytes("report", s, sizeof(crash_summary)) == sizeof(crash_summary);
+  prefs.end();
+
+  if (upload_url.length() == 0 || !loaded) {
+    free(s);
+    return;
+  }
+  upload_body = reportJson(*s);
+  free(s);
+
+  // Posted over the non-blocking client, a step per frame, so a slow collector never stalls the loop
+  upload = new AsyncHttp();
+  upload->setConnectTimeout(UPLOAD_TIMEOUT);
+  upload->setHandshakeTimeout(UPLOAD_TIMEOUT);
+  upload->setTimeout(UPLOAD_TIMEOUT);
+  upload->post(upload_url.c_str(), "application/json", (const uint8_t *)upload_body.c_str(), upload_body.length(),
+               discardBody, nullptr, clockMillis());
+  if (!upload->busy()) {
+    uploadDone();                           // Could not even start, e.g. a bad URL
+  }
+}
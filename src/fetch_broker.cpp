@@ -0,0 +1,453 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fetch_broker.h"
+#include "xxhash32.h"
+
+// ------------------------------------------------------------------------------------
+const int BROKER_HASHES = 8;                // URLs whose last good body hash is remembered
+const char *PRIORITY_NAMES[PRIORITIES] = { "live", "backfill" };
+
+typedef struct {
+  char name[64];
+  broker_limits limits;
+  float tokens;
+  uint32_t refilled_ms;
+  int in_flight;
+  bool held;                                // A request is waiting for a token
+} host_state;
+
+typedef struct {
+  char prefix[160];
+  char suffix[192];
+  int host;
+} endpoint_state;
+
+typedef enum { ITEM_FREE, ITEM_QUEUED, ITEM_IN_FLIGHT } item_state;
+
+typedef struct {
+  char name[BROKER_ITEM_SIZE];
+  uint8_t state;
+  uint8_t priority;
+  int8_t endpoint;
+  int8_t slot;
+  uint32_t queued_ms;
+} queue_item;
+
+typedef struct {
+  AsyncHttp http;
+  int endpoint;                             // -1 when free
+  broker_priority priority;
+  uint32_t key;
+  char *body;                               // Kept between requests, grown as needed
+  size_t length;
+  size_t capacity;
+  XXHash32 hash;
+  uint32_t started_ms;
+  uint32_t waited_ms;
+} slot_state;
+
+static host_state hosts[BROKER_HOSTS];
+static int host_count = 0;
+static endpoint_state endpoints[BROKER_ENDPOINTS];
+static int endpoint_count = 0;
+static queue_item queue[BROKER_QUEUE];
+static slot_state slots[BROKER_SLOTS];
+static bool slots_ready = false;
+static uint32_t known_keys[BROKER_HASHES];
+static uint32_t known_hashes[BROKER_HASHES];
+static int known_count = 0;
+static int known_next = 0;
+static char delivered[BROKER_QUEUE][BROKER_ITEM_SIZE];
+static const char *delivered_items[BROKER_QUEUE];
+static char url[BROKER_URL_MAX + 1];
+static broker_stats stats;
+// ------------------------------------------------------------------------------------
+
+static void initSlots() {
+  if (slots_ready) {
+    return;
+  }
+  for (int s = 0; s < BROKER_SLOTS; s++) {
+    slots[s].endpoint = -1;
+  }
+  slots_ready = true;
+}
+
+// Host entry for name, created with the default limits and a full bucket if new
+static int findHost(const char *name, size_t len) {
+  for (int i = 0; i < host_count; i++) {
+    if (strlen(hosts[i].name) == len && strncmp(hosts[i].name, name, len) == 0) {
+      return i;
+    }
+  }
+  if (host_count == BROKER_HOSTS || len >= sizeof(hosts[0].name)) {
+    return -1;
+  }
+  host_state &h = hosts[host_count];
+  memcpy(h.name, name, len);
+  h.name[len] = '\0';
+  h.limits = BROKER_DEFAULT_LIMITS;
+  h.tokens = h.limits.burst;
+  return host_count++;
+}
+
+void brokerHost(const char *host, const broker_limits &limits) {
+  int h = findHost(host, strlen(host));
+  if (h >= 0) {
+    hosts[h].limits = limits;
+    hosts[h].tokens = limits.burst;
+  }
+}
+
+int brokerEndpoint(const char *prefix, const char *suffix) {
+  const char *host = strstr(prefix, "://");
+  if (endpoint_count == BROKER_ENDPOINTS || host == nullptr ||
+      strlen(prefix) >= sizeof(endpoints[0].prefix) || strlen(suffix) >= sizeof(endpoints[0].suffix)) {
+    return -1;
+  }
+  host += 3;
+  int h = findHost(host, strcspn(host, ":/?"));
+  if (h < 0) {
+    return -1;
+  }
+  endpoint_state &e = endpoints[endpoint_count];
+  strcpy(e.prefix, prefix);
+  strcpy(e.suffix, suffix);
+  e.host = h;
+  return endpoint_count++;
+}
+
+void brokerSetTimeouts(uint32_t connect_ms, uint32_t handshake_ms, uint32_t read_ms) {
+  for (int s = 0; s < BROKER_SLOTS; s++) {
+    slots[s].http.setConnectTimeout(connect_ms);
+    slots[s].http.setHandshakeTimeout(handshake_ms);
+    slots[s].http.setTimeout(read_ms);
+  }
+}
+
+bool brokerSubmit(int endpoint, const char *item, broker_priority priority, uint32_t now_ms) {
+  if (endpoint < 0 || endpoint >= endpoint_count) {
+    return false;
+  }
+  stats.submitted++;
+  int free_item = -1;
+  for (int i = 0; i < BROKER_QUEUE; i++) {
+    queue_item &q = queue[i];
+    if (q.state == ITEM_FREE) {
+      if (free_item < 0) {
+        free_item = i;
+      }
+      continue;
+    }
+    if (q.endpoint != endpoint || strcmp(q.name, item) != 0) {
+      continue;
+    }
+    stats.coalesced++;
+    if (q.state == ITEM_QUEUED && priority < q.priority) {
+      stats.depth[q.priority]--;
+      stats.depth[priority]++;
+      q.priority = priority;
+    }
+    return true;
+  }
+  if (free_item < 0 || strlen(item) >= BROKER_ITEM_SIZE) {
+    stats.dropped++;
+    return false;
+  }
+
+  queue_item &q = queue[free_item];
+  strcpy(q.name, item);
+  q.state = ITEM_QUEUED;
+  q.priority = priority;
+  q.endpoint = endpoint;
+  q.slot = -1;
+  q.queued_ms = now_ms;
+  if (++stats.depth[priority] > stats.depthMax[priority]) {
+    stats.depthMax[priority] = stats.depth[priority];
+  }
+  return true;
+}
+
+// Top up the bucket of host h; true if it may start a request now
+static bool hostReady(int h, uint32_t now_ms) {
+  host_state &host = hosts[h];
+  float refill = (now_ms - host.refilled_ms) * host.limits.rate / 1000.0f;
+  host.tokens = host.tokens + refill > host.limits.burst ? host.limits.burst : host.tokens + refill;
+  host.refilled_ms = now_ms;
+  if (host.in_flight >= host.limits.connections) {
+    return false;
+  }
+  if (host.tokens < 1.0f) {
+    host.held = true;
+    return false;
+  }
+  return true;
+}
+
+// Length of item once URL-encoded, and the encoded item appended at url + n if it fits
+static size_t appendEncoded(size_t n, const char *item, size_t room) {
+  size_t len = 0;
+  for (const char *c = item; *c; c++) {
+    len += isalnum((unsigned char)*c) || *c == '.' || *c == '-' || *c == '_' ? 1 : 3;
+  }
+  if (n + len > room) {
+    return len;
+  }
+  for (const char *c = item; *c; c++) {
+    if (isalnum((unsigned char)*c) || *c == '.' || *c == '-' || *c == '_') {
+      url[n++] = *c;
+    } else {
+      snprintf(url + n, 4, "%%%02X", (unsigned char)*c);
+      n += 3;
+    }
+  }
+  return len;
+}
+
+// The request body arrives here, hashed on the way in
+static bool collect(void *ctx, const uint8_t *data, size_t len) {
+  slot_state &slot = *(slot_state *)ctx;
+  if (slot.length + len > BROKER_BODY_MAX) {
+    return false;
+  }
+  if (slot.length + len + 1 > slot.capacity) {
+    size_t capacity = slot.capacity ? slot.capacity : 4096;
+    while (capacity < slot.length + len + 1) {
+      capacity *= 2;
+    }
+    char *body = (char *)realloc(slot.body, capacity);
+    if (body == nullptr) {
+      return false;
+    }
+    slot.body = body;
+    slot.capacity = capacity;
+  }
+  memcpy(slot.body + slot.length, data, len);
+  slot.length += len;
+  slot.body[slot.length] = '\0';
+  slot.hash.update(data, len);
+  return true;
+}
+
+// Start one request on slot s for endpoint e, carrying as many of its queued items as fit,
+// the most urgent first
+static void launch(int s, int e, uint32_t now_ms) {
+  const endpoint_state &ep = endpoints[e];
+  slot_state &slot = slots[s];
+  size_t suffix = strlen(ep.suffix);
+  size_t n = strlen(ep.prefix);
+  memcpy(url, ep.prefix, n);
+  int count = 0;
+  uint32_t oldest = now_ms;
+  slot.priority = PRIORITY_BACKFILL;
+  for (int p = 0; p < PRIORITIES; p++) {
+    for (int i = 0; i < BROKER_QUEUE; i++) {
+      queue_item &q = queue[i];
+      if (q.state != ITEM_QUEUED || q.endpoint != e || q.priority != p) {
+        continue;
+      }
+      size_t comma = count > 0 ? 1 : 0;
+      size_t len = appendEncoded(n + comma, q.name, BROKER_URL_MAX - suffix);
+      if (n + comma + len + suffix > BROKER_URL_MAX) {
+        if (count == 0) {
+          q.state = ITEM_FREE;              // Too long for any URL
+          stats.depth[p]--;
+          stats.dropped++;
+        }
+        continue;
+      }
+      if (comma) {
+        url[n] = ',';
+      }
+      n += comma + len;
+      q.state = ITEM_IN_FLIGHT;
+      q.slot = s;
+      stats.depth[p]--;
+      if (count == 0) {
+        slot.priority = (broker_priority)p;
+      }
+      if ((int32_t)(q.queued_ms - oldest) < 0) {
+        oldest = q.queued_ms;
+      }
+      count++;
+    }
+  }
+  if (count == 0) {
+    return;
+  }
+  memcpy(url + n, ep.suffix, suffix + 1);
+  n += suffix;
+
+  host_state &host = hosts[ep.host];
+  host.tokens -= 1.0f;
+  host.in_flight++;
+  if (host.held) {
+    stats.throttled++;
+    host.held = false;
+  }
+  slot.endpoint = e;
+  slot.key = XXHash32::hash(url, n);
+  slot.length = 0;
+  slot.hash.reset();
+  slot.started_ms = now_ms;
+  slot.waited_ms = now_ms - oldest;
+  stats.requests++;
+  stats.batched += count;
+  stats.inFlight++;
+  stats.started[slot.priority]++;
+  stats.waitMs[slot.priority] += slot.waited_ms;
+  if (slot.waited_ms > stats.waitMaxMs[slot.priority]) {
+    stats.waitMaxMs[slot.priority] = slot.waited_ms;
+  }
+  slot.http.get(url, collect, &slot, now_ms);
+}
+
+// Requests start while a slot is free and some host with queued items is within its limits,
+// each seeded with the most urgent, oldest item
+void brokerStart(uint32_t now_ms) {
+  initSlots();
+  for (int s = 0; s < BROKER_SLOTS; s++) {
+    if (slots[s].endpoint >= 0) {
+      continue;
+    }
+    int best = -1;
+    for (int i = 0; i < BROKER_QUEUE; i++) {
+      const queue_item &q = queue[i];
+      if (q.state != ITEM_QUEUED) {
+        continue;
+      }
+      if (best >= 0 && (q.priority > queue[best].priority ||
+                        (q.priority == queue[best].priority && (int32_t)(q.queued_ms - queue[best].queued_ms) >= 0))) {
+        continue;
+      }
+      if (hostReady(endpoints[q.endpoint].host, now_ms)) {
+        best = i;
+      }
+    }
+    if (best < 0) {
+      return;
+    }
+    launch(s, queue[best].endpoint, now_ms);
+  }
+}
+
+// Hand out the finished request on slot s and free it
+static void deliver(int s, uint32_t now_ms, broker_response &out) {
+  slot_state &slot = slots[s];
+  out.endpoint = slot.endpoint;
+  out.status = slot.http.status();
+  out.body = slot.body ? slot.body : "";
+  out.length = slot.length;
+  out.hash = slot.hash.digest();
+  out.key = slot.key;
+  out.unchanged = false;
+  out.priority = slot.priority;
+  out.elapsed_ms = now_ms - slot.started_ms;
+  out.waited_ms = slot.waited_ms;
+
+  if (out.status == 200) {
+    int k = 0;
+    while (k < known_count && known_keys[k] != slot.key) {
+      k++;
+    }
+    if (k == known_count) {
+      k = known_next;
+      known_next = (known_next + 1) % BROKER_HASHES;
+      known_count = known_count < BROKER_HASHES ? known_count + 1 : BROKER_HASHES;
+      known_keys[k] = slot.key;
+    } else {
+      out.unchanged = known_hashes[k] == out.hash;
+    }
+    known_hashes[k] = out.hash;
+  } else {
+    stats.failed++;
+  }
+
+  // In the order of the URL
+  out.count = 0;
+  for (int p = 0; p < PRIORITIES; p++) {
+    for (int i = 0; i < BROKER_QUEUE; i++) {
+      queue_item &q = queue[i];
+      if (q.state == ITEM_IN_FLIGHT && q.slot == s && q.priority == p) {
+        memcpy(delivered[out.count], q.name, BROKER_ITEM_SIZE);
+        delivered_items[out.count] = delivered[out.count];
+        out.count++;
+        q.state = ITEM_FREE;
+      }
+    }
+  }
+  out.items = delivered_items;
+
+  hosts[endpoints[slot.endpoint].host].in_flight--;
+  stats.inFlight--;
+  slot.endpoint = -1;
+}
+
+bool brokerPoll(uint32_t now_ms, broker_response &out) {
+  brokerStart(now_ms);
+  for (int s = 0; s < BROKER_SLOTS; s++) {
+    if (slots[s].endpoint < 0) {
+      continue;
+    }
+    slots[s].http.poll(now_ms);
+    if (!slots[s].http.busy()) {
+      deliver(s, now_ms, out);
+      return true;
+    }
+  }
+  return false;
+}
+
+int brokerPending(int endpoint) {
+  int pending = 0;
+  for (int i = 0; i < BROKER_QUEUE; i++) {
+    if (queue[i].state != ITEM_FREE && (endpoint < 0 || queue[i].endpoint == endpoint)) {
+      pending++;
+    }
+  }
+  return pending;
+}
+
+bool brokerInFlight() {
+  return stats.inFlight > 0;
+}
+
+int brokerWait(uint32_t timeout_ms) {
+  AsyncHttp *waiting[BROKER_SLOTS];
+  int count = 0;
+  for (int s = 0; s < BROKER_SLOTS; s++) {
+    if (slots_ready && slots[s].endpoint >= 0) {
+      waiting[count++] = &slots[s].http;
+    }
+  }
+  return asyncHttpWait(waiting, count, timeout_ms);
+}
+
+void brokerForget(const broker_response &out) {
+  for (int k = 0; k < known_count; k++) {
+    if (known_keys[k] == out.key) {
+      known_hashes[k] = ~out.hash;
+    }
+  }
+}
+
+void brokerStop() {
+  initSlots();
+  for (int s = 0; s < BROKER_SLOTS; s++) {
+    slots[s].http.stop();
+    slots[s].endpoint = -1;
+  }
+  for (int h = 0; h < host_count; h++) {
+    hosts[h].in_flight = 0;
+  }
+  memset(queue, 0, sizeof(queue));
+  memset(stats.depth, 0, sizeof(stats.depth));
+  stats.inFlight = 0;
+}
+
+const broker_stats &brokerStats() {
+  return stats;
+}
@@ -0,0 +1,155 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fx.h"
+
+#ifdef ARDUINO
+#include <Preferences.h>
+
+#include "log.h"
+#endif
+
+// ------------------------------------------------------------------------------------
+typedef struct {
+  const char *code;                         // Minor unit as Yahoo reports it
+  const char *major;
+  double factor;
+} minor_unit;
+
+static const minor_unit MINOR_UNITS[] = {
+  { "GBp", "GBP", 0.01 },
+  { "GBX", "GBP", 0.01 },
+  { "ZAc", "ZAR", 0.01 },
+  { "ILA", "ILS", 0.01 },
+};
+
+static char codes[FX_MAX][4] = { "USD" };   // codes[0] is the base currency
+static int code_count = 1;
+static double to_base[FX_MAX] = { 1.0 };    // 0 while unknown
+static double rates[FX_MAX][FX_MAX] = { { 1.0 } };
+static char pair_symbols[FX_MAX][12];
+// ------------------------------------------------------------------------------------
+
+const char *fxBase() {
+  return codes[0];
+}
+
+int fxCurrency(const char *code) {
+  if (code == nullptr || code[0] == '\0') {
+    return -1;
+  }
+  for (int i = 0; i < code_count; i++) {
+    if (strncmp(codes[i], code, 3) == 0) {
+      return i;
+    }
+  }
+  if (code_count == FX_MAX) {
+    return -1;
+  }
+  int c = code_count++;
+  memset(codes[c], 0, sizeof(codes[c]));
+  strncpy(codes[c], code, 3);
+  snprintf(pair_symbols[c], sizeof(pair_symbols[c]), "%s%s=X", codes[c], codes[0]);
+  to_base[c] = 0.0;
+  for (int j = 0; j < FX_MAX; j++) {
+    rates[c][j] = rates[j][c] = 0.0;
+  }
+  rates[c][c] = 1.0;
+  return c;
+}
+
+int fxPairs(const char **symbols, int *currencies) {
+  for (int i = 1; i < code_count; i++) {
+    symbols[i - 1] = pair_symbols[i];
+    currencies[i - 1] = i;
+  }
+  return code_count - 1;
+}
+
+void fxUpdate(int currency, double rate) {
+  if (currency <= 0 || currency >= code_count || !(rate > 0.0) || rate == to_base[currency]) {
+    return;
+  }
+  to_base[currency] = rate;
+  for (int j = 0; j < code_count; j++) {
+    if (j != currency && to_base[j] > 0.0) {
+      rates[currency][j] = rate / to_base[j];
+      rates[j][currency] = to_base[j] / rate;
+    }
+  }
+}
+
+double fxRate(int from, int to) {
+  if (from < 0 || from >= code_count || to < 0 || to >= code_count) {
+    return 0.0;
+  }
+  return rates[from][to];
+}
+
+bool fxToBase(double amount, const char *from, double &out) {
+  int c = fxCurrency(from);
+  double rate = fxRate(c, 0);
+  if (rate == 0.0) {
+    return false;
+  }
+  out = amount * rate;
+  return true;
+}
+
+void fxNormalise(quote &q) {
+  for (const minor_unit &m : MINOR_UNITS) {
+    if (strncmp(q.currency, m.code, 3) == 0) {
+      q.current *= m.factor;
+      q.previousClose *= m.factor;
+      strncpy(q.currency, m.major, sizeof(q.currency) - 1);
+      return;
+    }
+  }
+}
+
+void fxNormaliseReference(reference &r) {
+  for (const minor_unit &m : MINOR_UNITS) {
+    if (strncmp(r.currency, m.code, 3) == 0) {
+      r.previousClose *= m.factor;
+      r.yearHigh *= m.factor;
+      r.yearLow *= m.factor;
+      strncpy(r.currency, m.major, sizeof(r.currency) - 1);
+      return;
+    }
+  }
+}
+
+#ifdef ARDUINO
+// ------------------------------------------------------------------------------------
+// Storage, on the device only
+
+static Preferences prefs;
+
+// Start over with base as the base currency
+static void reset(const char *base) {
+  memset(codes, 0, sizeof(codes));
+  for (int i = 0; i < 3 && base[i]; i++) {
+    codes[0][i] = toupper(base[i]);
+  }
+  code_count = 1;
+  to_base[0] = 1.0;
+  rates[0][0] = 1.0;
+}
+
+void fxBegin() {
+  prefs.begin("fx", true);
+  String base = prefs.getString("base", "USD");
+  prefs.end();
+  reset(base.c_str());
+  LOG_INFO("Base currency %s.", codes[0]);
+}
+
+void fxSetBase(const char *code) {
+  reset(code);
+  prefs.begin("fx", false);
+  prefs.putString("base", codes[0]);
+  prefs.end();
+  LOG_INFO("Base currency set to %s.", codes[0]);
+}
+#endif
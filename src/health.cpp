@@ -0,0 +1,90 @@
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_task_wdt.h>
+
+#include "health.h"
+#include "log.h"
+
+// ------------------------------------------------------------------------------------
+// Consecutive failures at which each step of the ladder is taken
+const int LADDER[RECOVER_STEPS] = { 1, 3, 5, 8 };
+const char *STEP_NAMES[RECOVER_STEPS] = { "abort request", "reset socket", "restart wifi", "reboot" };
+
+static health_counters counters;
+static int consecutive_failures = 0;
+static Preferences prefs;
+// ------------------------------------------------------------------------------------
+
+static void saveCounters() {
+  prefs.begin("health", false);
+  prefs.putBytes("counters", &counters, sizeof(counters));
+  prefs.end();
+}
+
+void healthBegin() {
+  prefs.begin("health", true);
+  prefs.getBytes("counters", &counters, sizeof(counters));
+  prefs.end();
+
+  counters.boots++;
+  esp_reset_reason_t reason = esp_reset_reason();
+  if (reason == ESP_RST_TASK_WDT || reason == ESP_RST_INT_WDT || reason == ESP_RST_WDT) {
+    counters.watchdogResets++;
+    LOG_WARN("Restarted by the watchdog.");
+  }
+  saveCounters();
+
+  LOG_INFO("Health: %u boots, %u watchdog resets, %u aborts, %u socket resets, %u wifi restarts, %u reboots",
+           counters.boots, counters.watchdogResets, counters.steps[RECOVER_ABORT], counters.steps[RECOVER_SOCKET],
+           counters.steps[RECOVER_WIFI], counters.steps[RECOVER_REBOOT]);
+
+  // Reconfigures the watchdog the core already started, and makes a timeout fatal
+  esp_task_wdt_init(HEALTH_WDT_TIMEOUT, true);
+}
+
+// The core starts the watchdog before setup(), so a task may subscribe before healthBegin()
+// has set the final timeout
+void healthWatchTask(const char *name) {
+  if (esp_task_wdt_add(nullptr) != ESP_OK) {
+    LOG_WARN("The %s task could not be put under the watchdog.", name);
+  }
+}
+
+void healthHeartbeat() {
+  esp_task_wdt_reset();
+}
+
+recovery_step healthFetchFailed() {
+  consecutive_failures++;
+  recovery_step step = RECOVER_ABORT;
+  for (int i = RECOVER_STEPS - 1; i > 0; i--) {
+    if (consecutive_failures == LADDER[i]) {
+      step = (recovery_step)i;
+      break;
+    }
+  }
+
+  counters.steps[step]++;
+  LOG_WARN("Fetch failed %d times in a row: %s.", consecutive_failures, STEP_NAMES[step]);
+  // Aborts are frequent enough on a flaky link to wear the flash, so they are written together
+  // with the next rarer step or the next success
+  if (step != RECOVER_ABORT) {
+    saveCounters();
+  }
+  if (step == RECOVER_REBOOT) {
+    delay(100);                             // Let the log task print the reason
+  }
+  return step;
+}
+
+void healthFetchSucceeded() {
+  if (consecutive_failures > 0) {
+    saveCounters();
+  }
+  consecutive_failures = 0;
+}
+
+const health_counters &healthCounters() {
+  return counters;
+}
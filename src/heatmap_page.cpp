@@ -0,0 +1,127 @@
+
+#include <Arduino.h>
+
+#include "display.h"
+#include "heatmap_page.h"
+#include "watchlist.h"
+
+// ------------------------------------------------------------------------------------
+const int HEAT_LEVELS = 4;
+const float HEAT_STEPS[HEAT_LEVELS - 1] = { 0.5f, 1.0f, 2.0f };   // Percent change thresholds
+
+// Colour buckets, same scheme as the percent change page: grey when the market is closed,
+// white when flat, then shades of green and red by the size of the move
+typedef enum {
+  HEAT_CLOSED,
+  HEAT_FLAT,
+  HEAT_UP,                                  // HEAT_UP + level, level 0..HEAT_LEVELS-1
+  HEAT_DOWN = HEAT_UP + HEAT_LEVELS,        // HEAT_DOWN + level
+  HEAT_BUCKETS = HEAT_DOWN + HEAT_LEVELS
+} heat_bucket;
+
+constexpr uint16_t rgb(uint8_t r, uint8_t g, uint8_t b) {
+  return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+const uint16_t HEAT_COLOURS[HEAT_BUCKETS] = {
+  TFT_DARKGREY, TFT_WHITE,
+  rgb(0, 80, 0), rgb(0, 140, 0), rgb(0, 200, 0), rgb(0, 255, 0),
+  rgb(90, 0, 0), rgb(150, 0, 0), rgb(210, 0, 0), rgb(255, 0, 0),
+};
+
+typedef struct {
+  int16_t x, y, w, h;
+  char label[8];                            // Cut to fit the cell
+  int8_t drawn;                             // Bucket on screen, -1 for none
+} heat_cell;
+
+static heat_cell cells[WATCHLIST_MAX];
+static uint8_t cell_font = 2;
+static bool laid_out = false;
+static uint32_t layout_version;
+// ------------------------------------------------------------------------------------
+
+static int bucketFor(const quote &q) {
+  if (!q.marketOpen) {
+    return HEAT_CLOSED;
+  }
+  float change = fabs(q.percentageChange);
+  if (change < 0.001f) {
+    return HEAT_FLAT;
+  }
+  int level = 0;
+  while (level < HEAT_LEVELS - 1 && change >= HEAT_STEPS[level]) {
+    level++;
+  }
+  return (q.percentageChange > 0.0 ? HEAT_UP : HEAT_DOWN) + level;
+}
+
+// Grid about as square as the screen allows, the last row stretched over the full width
+static void layout() {
+  int n = watchlist_count;
+  int cols = max(1, (int)ceilf(sqrtf((float)n * TFT_HEIGHT / TFT_WIDTH)));
+  int rows = (n + cols - 1) / cols;
+
+  for (int i = 0; i < n; i++) {
+    int row = i / cols, col = i % cols;
+    int in_row = row < rows - 1 ? cols : n - row * cols;
+    heat_cell &c = cells[i];
+    c.x = col * TFT_HEIGHT / in_row;
+    c.w = (col + 1) * TFT_HEIGHT / in_row - c.x;
+    c.y = row * TFT_WIDTH / rows;
+    c.h = (row + 1) * TFT_WIDTH / rows - c.y;
+  }
+
+  // The larger font if every label fits its cell, and labels cut to the width otherwise
+  cell_font = 2;
+  for (int i = 0; i < n; i++) {
+    if (cells[i].h < tft.fontHeight(2) + 2 || tft.textWidth(watchlist[i].label, 2) > cells[i].w - 2) {
+      cell_font = 1;
+      break;
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    heat_cell &c = cells[i];
+    strncpy(c.label, watchlist[i].label, sizeof(c.label) - 1);
+    c.label[sizeof(c.label) - 1] = '\0';
+    for (int len = strlen(c.label); len > 0 && tft.textWidth(c.label, cell_font) > c.w - 2; len--) {
+      c.label[len - 1] = '\0';
+    }
+  }
+
+  laid_out = true;
+  layout_version = watchlist_version;
+}
+
+static void drawCell(const heat_cell &c, int bucket) {
+  uint16_t colour = HEAT_COLOURS[bucket];
+  bool light = bucket == HEAT_FLAT || bucket == HEAT_UP + HEAT_LEVELS - 1;
+  tft.fillRect(c.x, c.y, c.w - 1, c.h - 1, colour);
+  tft.setTextColor(light ? TFT_BLACK : TFT_WHITE, colour);
+  tft.drawString(c.label, c.x + c.w / 2, c.y + c.h / 2, cell_font);
+}
+
+int drawHeatmapPage(bool full) {
+  if (!laid_out || layout_version != watchlist_version) {
+    layout();
+    full = true;
+  }
+  if (full) {
+    tft.fillScreen(TFT_BLACK);
+    for (int i = 0; i < watchlist_count; i++) {
+      cells[i].drawn = -1;
+    }
+  }
+
+  int painted = 0;
+  tft.setTextDatum(MC_DATUM);
+  for (int i = 0; i < watchlist_count; i++) {
+    int bucket = bucketFor(quotes[i]);
+    if (bucket != cells[i].drawn) {
+      drawCell(cells[i], bucket);
+      cells[i].drawn = bucket;
+      painted++;
+    }
+  }
+  return painted;
+}
@@ -0,0 +1,217 @@
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+
+#include "health.h"
+#include "log.h"
+#include "vclock.h"
+
+// ------------------------------------------------------------------------------------
+const int LOG_RING_SIZE = 64;         // Must be a power of two
+const int LOG_LINE_SIZE = 160;        // Longest formatted line, longer lines are truncated
+const int LOG_TASK_PRIORITY = 1;      // Same as the Arduino loop task, on purpose: the loop never waits on the ring
+const int LOG_IDLE_MS = 20;           // How long the drain task sleeps when the ring is empty
+const int LOG_COST_CALLS = 4096;      // Calls timed at startup
+const int LOG_COST_BATCH = LOG_RING_SIZE / 2;  // Leaves room for the other tasks' messages meanwhile
+
+// One queued message. seq implements a bounded multi-producer queue (Vyukov): a slot is
+// free for the producer at position p when its sequence is p, and readable by the consumer
+// when it is p + 1. The slot index is subtracted before storing so that the zero-initialised
+// ring is already valid and logging works before logBegin() or any constructor has run.
+typedef struct {
+  std::atomic<uint32_t> seq;
+  uint8_t level;
+  uint8_t nargs;
+  uint32_t ms;
+  const char *fmt;
+  log_arg args[LOG_MAX_ARGS];
+  char text[LOG_TEXT_SIZE];           // Copies of the string arguments
+} log_entry;
+
+static log_entry ring[LOG_RING_SIZE];
+static std::atomic<uint32_t> ring_tail(0);   // Next position to write (producers)
+static uint32_t ring_head = 0;               // Next position to read (drain task only)
+static std::atomic<uint32_t> dropped(0);
+// ------------------------------------------------------------------------------------
+
+static uint32_t slotSeq(const log_entry *e) {
+  return e->seq.load(std::memory_order_acquire) + (uint32_t)(e - ring);
+}
+
+static void setSlotSeq(log_entry *e, uint32_t seq) {
+  e->seq.store(seq - (uint32_t)(e - ring), std::memory_order_release);
+}
+
+void logCommit(uint8_t level, const char *fmt, const log_arg *args, int nargs) {
+  // Claim a slot
+  log_entry *e;
+  uint32_t pos = ring_tail.load(std::memory_order_relaxed);
+  for (;;) {
+    e = &ring[pos & (LOG_RING_SIZE - 1)];
+    int32_t diff = (int32_t)(slotSeq(e) - pos);
+    if (diff == 0) {
+      if (ring_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = ring_tail.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Fill it, copying strings since the caller's buffers go away when we return
+  e->level = level;
+  e->ms = clockMillis();
+  e->fmt = fmt;
+  e->nargs = nargs;
+  size_t used = 0;
+  for (int i = 0; i < nargs; i++) {
+    e->args[i] = args[i];
+    if (args[i].type == log_arg::STR) {
+      const char *src = args[i].s ? args[i].s : "(null)";
+      char *dst = e->text + used;
+      size_t room = LOG_TEXT_SIZE - used;
+      size_t n = room > 0 ? strnlen(src, room - 1) : 0;
+      if (room > 0) {
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+        used += n + 1;
+      }
+      e->args[i].s = room > 0 ? dst : "";
+    }
+  }
+
+  setSlotSeq(e, pos + 1);
+}
+
+// Format one message. Each conversion in fmt is re-issued to snprintf on its own, with the
+// length modifier rewritten to match how the argument was captured.
+static size_t logFormat(const log_entry *e, char *out, size_t size) {
+  static const char LEVELS[] = "-EWID";
+  size_t n = snprintf(out, size, "[%8u] %c ", (unsigned)e->ms, LEVELS[e->level]);
+  const char *f = e->fmt;
+  int arg = 0;
+
+  while (*f && n < size - 1) {
+    if (*f != '%') {
+      out[n++] = *f++;
+      continue;
+    }
+    if (f[1] == '%') {
+      out[n++] = '%';
+      f += 2;
+      continue;
+    }
+
+    // Copy flags, width and precision, skip length modifiers, find the conversion
+    char spec[16] = "%";
+    size_t s = 1;
+    f++;
+    while (*f && strchr("-+ #0123456789.", *f) && s < sizeof(spec) - 4) spec[s++] = *f++;
+    while (*f && strchr("hlLqjzt", *f)) f++;
+    char conv = *f ? *f++ : 's';
+
+    if (arg >= e->nargs) {
+      n += snprintf(out + n, size - n, "<?>");
+      continue;
+    }
+    const log_arg &a = e->args[arg++];
+    bool integer = strchr("diouxXc", conv) != nullptr;
+    bool real = strchr("fFeEgGaA", conv) != nullptr;
+
+    if (a.type == log_arg::STR) {
+      spec[s++] = 's';
+      spec[s] = '\0';
+      n += snprintf(out + n, size - n, spec, a.s);
+    } else if (a.type == log_arg::PTR || conv == 'p') {
+      spec[s++] = 'p';
+      spec[s] = '\0';
+      n += snprintf(out + n, size - n, spec, a.p);
+    } else if (real || a.type == log_arg::DOUBLE) {
+      spec[s++] = real ? conv : 'g';
+      spec[s] = '\0';
+      double v = a.type == log_arg::DOUBLE ? a.d : a.type == log_arg::INT ? (double)a.i : (double)a.u;
+      n += snprintf(out + n, size - n, spec, v);
+    } else if (conv == 'c') {
+      spec[s++] = 'c';
+      spec[s] = '\0';
+      n += snprintf(out + n, size - n, spec, (int)a.i);
+    } else {
+      spec[s++] = 'l';
+      spec[s++] = 'l';
+      spec[s++] = integer ? conv : 'd';
+      spec[s] = '\0';
+      n += snprintf(out + n, size - n, spec, a.i);
+    }
+  }
+
+  if (n > size - 2) n = size - 2;
+  out[n++] = '\n';
+  out[n] = '\0';
+  return n;
+}
+
+// Format and print the oldest queued message. Returns false when the ring is empty.
+static bool drainOne(char *line, size_t size) {
+  log_entry *e = &ring[ring_head & (LOG_RING_SIZE - 1)];
+  if (slotSeq(e) != ring_head + 1) {
+    return false;
+  }
+  size_t n = e->level != LOG_LEVEL_NONE ? logFormat(e, line, size) : 0;
+  setSlotSeq(e, ring_head + LOG_RING_SIZE);
+  ring_head++;
+  if (n > 0) {
+    Serial.write((const uint8_t *)line, n);
+  }
+  return true;
+}
+
+// Time LOG_COST_CALLS calls of a LOG_xxx() with two arguments, queued at LOG_LEVEL_NONE so they
+// are never printed. Runs on the drain task, which empties the ring itself between batches.
+static void measureCallCost(char *line, size_t size) {
+  int64_t spent = 0;
+  while (drainOne(line, size)) {            // What was logged before, so the batches fit
+  }
+  for (int done = 0; done < LOG_COST_CALLS; done += LOG_COST_BATCH) {
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < LOG_COST_BATCH; i++) {
+      logWrite(LOG_LEVEL_NONE, "%d %s", i, "timing");
+    }
+    spent += esp_timer_get_time() - t0;
+    while (drainOne(line, size)) {
+    }
+  }
+  LOG_INFO("Log call cost: %u ns, mean of %d calls", (unsigned)(spent * 1000 / LOG_COST_CALLS), LOG_COST_CALLS);
+}
+
+// Drain task: format and print everything queued, then sleep a little
+static void logTask(void *) {
+  char line[LOG_LINE_SIZE];
+  uint32_t reported = 0;
+
+  measureCallCost(line, sizeof(line));
+  healthWatchTask("log");
+  for (;;) {
+    if (drainOne(line, sizeof(line))) {
+      continue;
+    }
+    uint32_t lost = dropped.load(std::memory_order_relaxed);
+    if (lost != reported) {
+      size_t n = snprintf(line, sizeof(line), "[%8u] W %u log messages dropped\n",
+                          (unsigned)clockMillis(), (unsigned)(lost - reported));
+      Serial.write((const uint8_t *)line, n);
+      reported = lost;
+    }
+    healthHeartbeat();                      // Only here: a Serial write that never returns must time out
+    vTaskDelay(pdMS_TO_TICKS(LOG_IDLE_MS));
+  }
+}
+
+void logBegin() {
+  xTaskCreate(logTask, "log", 3072, nullptr, LOG_TASK_PRIORITY, nullptr);
+}
+
+uint32_t logDropped() {
+  return dropped.load(std::memory_order_relaxed);
+}
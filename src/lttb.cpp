@@ -0,0 +1,179 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lttb.h"
+#include "tsdb.h"
+
+// ------------------------------------------------------------------------------------
+
+ChartCache::ChartCache(int series, uint32_t window, int columns)
+  : _series(series), _window(window), _columns(columns), _origin(0), _valid(false), _scanned(0) {
+  _width = window / columns > 0 ? window / columns : 1;
+  _points = (chart_point *)calloc(columns, sizeof(chart_point));
+  _sums = (double *)calloc(columns, sizeof(double));
+  _counts = (uint32_t *)calloc(columns, sizeof(uint32_t));
+}
+
+ChartCache::~ChartCache() {
+  free(_points);
+  free(_sums);
+  free(_counts);
+}
+
+void ChartCache::update(uint32_t now) {
+  if (_points == nullptr || _sums == nullptr || _counts == nullptr) {
+    return;
+  }
+  uint32_t origin = (now / _width + 1) * _width - _columns * _width;
+  int from;
+
+  if (!_valid || origin < _origin || (origin - _origin) / _width >= (uint32_t)_columns) {
+    from = 0;
+  } else {
+    // Slide the window, then redo the buckets that may have gained points since last time.
+    // The bucket before them is re-selected too, since its pick depends on their average.
+    int shift = (origin - _origin) / _width;
+    if (shift > 0) {
+      memmove(_points, _points + shift, (_columns - shift) * sizeof(chart_point));
+      memmove(_sums, _sums + shift, (_columns - shift) * sizeof(double));
+      memmove(_counts, _counts + shift, (_columns - shift) * sizeof(uint32_t));
+    }
+    from = _columns - 1 - shift;
+    if (from < 0) {
+      from = 0;
+    }
+  }
+
+  _origin = origin;
+  _valid = true;
+  _scanned = 0;
+  accumulate(from);
+  select(from > 0 ? from - 1 : 0);
+}
+
+// Pass one: per bucket sums and counts, for the averages
+void ChartCache::accumulate(int from) {
+  for (int i = from; i < _columns; i++) {
+    _sums[i] = 0.0;
+    _counts[i] = 0;
+  }
+  TsdbReader reader(_series, _origin + from * _width);
+  uint32_t t;
+  double v;
+  while (reader.next(t, v)) {
+    _scanned++;
+    uint32_t b = (t - _origin) / _width;
+    if (b >= (uint32_t)_columns) {
+      break;
+    }
+    _sums[b] += v;
+    _counts[b]++;
+  }
+}
+
+// Pass two: pick the point of each bucket that spans the largest triangle
+void ChartCache::select(int from) {
+  // The previous pick, or the first bucket's average when starting from scratch
+  int prev = from - 1;
+  while (prev >= 0 && _counts[prev] == 0) {
+    prev--;
+  }
+  bool have_prev = prev >= 0;
+  chart_point a = have_prev ? _points[prev] : chart_point{ 0, 0.0f };
+
+  int bucket = -1;
+  int next = -1;
+  float best_area = -1.0f;
+  chart_point best = { 0, 0.0f };
+  float next_t = 0.0f, next_v = 0.0f;
+
+  TsdbReader reader(_series, _origin + from * _width);
+  uint32_t t;
+  double v;
+  bool more = reader.next(t, v);
+
+  for (;;) {
+    int b = more ? (int)((t - _origin) / _width) : _columns;
+    if (more && b >= _columns) {
+      more = false;
+      b = _columns;
+    }
+
+    if (b != bucket) {
+      // Close the bucket we were in
+      if (bucket >= 0) {
+        _points[bucket] = best;
+        a = best;
+        have_prev = true;
+      }
+      if (!more) {
+        break;
+      }
+      bucket = b;
+      best_area = -1.0f;
+
+      // Average of the next non-empty bucket, the third corner of the triangles
+      next = bucket + 1;
+      while (next < _columns && _counts[next] == 0) {
+        next++;
+      }
+      if (next < _columns) {
+        next_t = (next + 0.5f) * _width;
+        next_v = _sums[next] / _counts[next];
+      }
+      if (!have_prev) {
+        a.t = _origin + bucket * _width;
+        a.v = _sums[bucket] / _counts[bucket];
+      }
+    }
+
+    chart_point p = { t, (float)v };
+    if (next >= _columns) {
+      best = p;                 // Newest bucket: keep its latest point
+    } else {
+      // Times relative to the window start, which keeps them exact in a float
+      float at = (float)(a.t - _origin), pt = (float)(t - _origin);
+      float area = fabsf((at - next_t) * (p.v - a.v) - (at - pt) * (next_v - a.v));
+      if (area > best_area) {
+        best_area = area;
+        best = p;
+      }
+    }
+    more = reader.next(t, v);
+  }
+}
+
+// ------------------------------------------------------------------------------------
+static ChartCache *chart_cache[CHART_CACHE_SERIES][CHART_CACHE_ZOOMS];
+static ChartCache *chart_spare;             // Shared by the series past CHART_CACHE_SERIES
+static chart_cache_stats cache_stats;
+
+ChartCache *chartCacheFor(int series, int zoom, uint32_t window, int columns) {
+  bool cached = series >= 0 && series < CHART_CACHE_SERIES && zoom >= 0 && zoom < CHART_CACHE_ZOOMS;
+  ChartCache *&slot = cached ? chart_cache[series][zoom] : chart_spare;
+  if (slot != nullptr && slot->series() == series && slot->window() == window && slot->columns() == columns) {
+    cache_stats.hits++;
+    return slot;
+  }
+  cache_stats.misses++;
+  delete slot;
+  slot = new ChartCache(series, window, columns);
+  return slot;
+}
+
+void chartCacheClear() {
+  for (int s = 0; s < CHART_CACHE_SERIES; s++) {
+    for (int z = 0; z < CHART_CACHE_ZOOMS; z++) {
+      delete chart_cache[s][z];
+      chart_cache[s][z] = nullptr;
+    }
+  }
+  delete chart_spare;
+  chart_spare = nullptr;
+}
+
+chart_cache_stats chartCacheStats() {
+  return cache_stats;
+}
@@ -1,198 +1,686 @@
 
 #include <Arduino.h>
+#include <esp_timer.h>
 #include <TFT_eSPI.h>
 #include <WiFi.h>
-#include <HTTPClient.h>
-#include <ArduinoJson.h>
-#include <ESP_WiFiManager.h>
 
 #include "pin_config.h"
+#include "async_http.h"
+#include "backlight.h"
+#include "candle_page.h"
+#include "candles.h"
+#include "chart_page.h"
+#include "cpu_power.h"
+#include "crash_report.h"
+#include "fx.h"
+#include "display.h"
+#include "fetch_broker.h"
+#include "health.h"
+#include "heatmap_page.h"
+#include "log.h"
+#include "metrics.h"
+#include "mqtt_publish.h"
+#include "mqtt_source.h"
+#include "portfolio.h"
+#include "portfolio_page.h"
+#include "profile.h"
+#include "provisioning.h"
+#include "quote.h"
+#include "quote_filter.h"
+#include "quote_parser.h"
+#include "ref_data.h"
+#include "render_stats.h"
+#include "text_page.h"
+#include "tsdb.h"
+#include "usb_feed.h"
+#include "vclock.h"
+#include "watchlist.h"
+#include "wifi_power.h"
 
 // ------------------------------------------------------------------------------------
-const int TFT_FONT = 4;           // Font to use on the TFT
-const int BUF_SIZE = 80;
 const int DELAY = 2000;           // Display things on the TFT for 2 seconds
+const int FRAME = 50;             // Longest time loop() sleeps, so the portal and display stay responsive
+const char *MARKET_TZ = "EST5EDT,M3.2.0,M11.1.0";   // Local time is exchange time, for the backlight schedule
+const size_t HISTORY_RAM = 64 * 1024;             // Tick history budget without PSRAM (a few days of 3 symbols)
+const size_t HISTORY_PSRAM = 2 * 1024 * 1024;     // Several days of a large watchlist
+const time_t CLOCK_VALID = 1600000000;            // Earlier times mean NTP has not set the clock yet
+const int CANDLE_SERIES_RAM = 16;                 // Symbols with candles without PSRAM
+const int CANDLE_FRAMES = 3;                      // Candle page updates per visit, one fetch each
+const int HEATMAP_FRAMES = 3;                     // Same for the heatmap
+const broker_limits YAHOO_LIMITS = { 1.0f, 4, 2 };  // Requests per second, burst and connections
+const char *YAHOO_QUOTE = "https://query1.finance.yahoo.com/v7/finance/quote?symbols=";
+const char *FAST_FIELDS = "&fields=regularMarketPrice,regularMarketChangePercent,marketState";
+const char *REFERENCE_FIELDS = "&fields=regularMarketPrice,regularMarketChangePercent,marketState,"
+                               "regularMarketPreviousClose,currency,fiftyTwoWeekHigh,fiftyTwoWeekLow,"
+                               "exchangeTimezoneShortName,gmtOffSetMilliseconds";
 
-TFT_eSPI tft;                     // The TFT object
-int black_width;                  // Width of the rectagle that needs to be cleared when stocks update
-// ------------------------------------------------------------------------------------
+CountingTFT tft;                  // The TFT object, counting what is drawn
+int quote_endpoint = -1;          // Broker endpoint of the Yahoo quote requests, fast fields only
+int reference_endpoint = -1;      // Same with the reference data, for symbols without it or due for it
+unsigned long fetch_started;      // clockMillis() when the symbols were queued
+bool fetching = false;            // A fetch cycle was started and has not been handled yet
 
-// Given a number convert it to a thousands separated string using a specific separating character
-void comma_separator(int num, char *str, char sep) {
-    char temp[BUF_SIZE];
-    int i = 0, j = 0;
-    sprintf(temp, "%d", num);
-    int len = strlen(temp);
-    int k = len % 3;
-    if (k == 0) {
-        k = 3;
-    }
-    while (temp[i] != '\0') {
-        if (i == k) {
-            str[j++] = sep;
-            k += 3;
-        }
-        str[j++] = temp[i++];
-    }
-    str[j] = '\0';
-}
+// The pages the display cycles through
+typedef enum {
+  PAGE_VALUES,                    // Current value of each quote
+  PAGE_CHANGE,                    // Percentage change from the previous close
+  PAGE_HEATMAP,                   // Whole watchlist by percent change, when it does not fit in TEXT_ROWS
+  PAGE_PORTFOLIO,                 // P&L totals, when there are positions
+  PAGE_CHART,                     // History of one symbol, a different one each cycle
+  PAGE_CANDLES,                   // Live candles of one symbol, updated in place for a few fetches
+  PAGE_STATUS,                    // Wi-Fi connection / setup portal banner
+} page;
 
+// Outcome of one quote request
+typedef enum {
+  FETCH_FAILED,
+  FETCH_UPDATED,
+  FETCH_UNCHANGED,                // Same response as last time, nothing parsed or updated
+  FETCH_PENDING,                  // Requests still queued or in flight
+} fetch_result;
+
+page current_page = PAGE_STATUS;
+int page_frames = 0;              // Frames shown so far in the current visit of current_page
+unsigned long page_shown;         // clockMillis() when the current page was drawn
+int screen_page = -1;             // Page whose layout is on screen, -1 before the first one
+int chart_symbol = 0;             // Watchlist entry the next chart page shows
+chart_zoom chart_level = ZOOM_HOURS;
+int candle_symbol = 0;            // Watchlist entry the next candle page shows
+candle_interval candle_level = CANDLE_1M;
+bool have_quotes = false;         // At least one successful fetch since boot
+bool quotes_changed = false;      // Quotes changed since the last frame was drawn
+fetch_result cycle_result;        // Best outcome so far of the requests of this fetch cycle
+int64_t tick_us = 0;              // When the oldest MQTT quote not yet on screen arrived, 0 if none
 // ------------------------------------------------------------------------------------
 
 // Initialize the ESP32
 void setup() {
   // Serial port and TFT init
   Serial.begin(115200);
+  logBegin();
+  crashReportBegin();
+  watchlistBegin();
+  fxBegin();
+  portfolioBegin();
+  mqttBegin();
+  mqttSourceBegin();
+  refBegin();
+  // Every network phase has a hard timeout, well within the watchdog period
+  brokerHost("query1.finance.yahoo.com", YAHOO_LIMITS);
+  brokerSetTimeouts(NET_CONNECT_TIMEOUT, NET_TLS_TIMEOUT * 1000, NET_READ_TIMEOUT);
+  quote_endpoint = brokerEndpoint(YAHOO_QUOTE, FAST_FIELDS);
+  reference_endpoint = brokerEndpoint(YAHOO_QUOTE, REFERENCE_FIELDS);
+  if (!tsdbBegin(WATCHLIST_MAX, psramFound() ? HISTORY_PSRAM : HISTORY_RAM)) {
+    LOG_ERROR("No memory for the quote history.");
+  }
+  if (!candlesBegin(psramFound() ? WATCHLIST_MAX : CANDLE_SERIES_RAM)) {
+    LOG_ERROR("No memory for the candles.");
+  }
   tft.init();
   tft.setTextFont(7);
   tft.fillRect(0, 0, TFT_WIDTH, TFT_HEIGHT, TFT_BLACK);
   tft.setRotation(1);
-  // Turn off LCD backlight
-  pinMode(TFT_LEDA_PIN, OUTPUT);  
-  digitalWrite(TFT_LEDA_PIN, 0);    
-  
-  // Write initial diagnose to serial port
-  Serial.println("");
-  Serial.println("Hello, this is T-Dongle-S3 providing stock market information.");
-  Serial.println("I'm alive and well.");
-  Serial.println("");
-
-  // Connect to Wi-Fi network
-  WiFi.mode(WIFI_STA);
-  ESP_WiFiManager wifiManager;  
-  //wifiManager.resetSettings();
+  // LCD backlight on, dimmed later according to the time of day
+  backlightBegin();
   
-  bool ok = true;
-  do {
-    Serial.println("Connecting to wifi...");
-    ok = wifiManager.autoConnect("T-Dongle-S3");
-    if (!ok) {
-      Serial.println("Failled to connect to wifi. Retrying.");
-      delay(DELAY);
-    } else {
-      Serial.printf("Connected to wifi <%s>.\n", WiFi.SSID());
-    }
-  } while (!ok);
+  // Write initial diagnose to serial port; the log task adds what a log call costs
+  LOG_INFO("Hello, this is T-Dongle-S3 providing stock market information.");
+  LOG_INFO("I'm alive and well.");
+  feedBegin();
+  cpuPowerBegin();
+  healthBegin();
+  healthWatchTask("loop");
 
-  // Inital text screen setup
-  tft.setTextColor(TFT_WHITE, TFT_BLACK);
-  tft.setTextDatum(TL_DATUM);
-  tft.drawString("SPX", 0, 0, TFT_FONT);
-  tft.drawString("NDX", 0, tft.fontHeight(TFT_FONT), TFT_FONT);
-  tft.drawString("T10", 0, tft.fontHeight(TFT_FONT)*2, TFT_FONT);
-  tft.setTextDatum(TR_DATUM);
-  black_width = tft.textWidth("XXXXXXX");
+  // Connect to Wi-Fi network in the background, opening the setup portal if needed.
+  // Quotes are fetched about once per two pages to begin with; the radio's sleep depth then follows the fetches.
+  wifiPowerSetPollInterval(2 * DELAY);
+  provisioningBegin();
+  configTzTime(MARKET_TZ, "pool.ntp.org", "time.nist.gov");
+
+  page_shown = clockMillis() - DELAY;
 }
 
 // ------------------------------------------------------------------------------------
 
-// A structure that represents a stock quote with its value, previous close, change and if the market is open
-typedef struct {
-  double current;
-  double previousClose;
-  double percentageChange;
-  bool marketOpen;
-} quote;
-
-// We are going to have three stock quotes (S&P500, NASDAQ100 and T-Bill 10 years)
-quote spx, ndx, bnd;
-
-// Use Yahoo Finance to get the relevant quotes from the internet
-void getQuotes() {
-  // Use Yahoo Finance API to get the current value of S&P500 and NASDAQ
-  HTTPClient http;
-  http.begin("https://query1.finance.yahoo.com/v7/finance/quote?symbols=%5ESPX,%5ENDX,%5ETNX");
-  int httpCode = http.GET();
-  if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
-
-    // Parse JSON data
-    DynamicJsonDocument doc(8192);
-    DeserializationError error = deserializeJson(doc, payload);
-    if (!error) {
-      Serial.println("--------------------------------------------");
-      spx.current = doc["quoteResponse"]["result"][0]["regularMarketPrice"];
-      spx.previousClose = doc["quoteResponse"]["result"][0]["regularMarketPreviousClose"];
-      spx.percentageChange = doc["quoteResponse"]["result"][0]["regularMarketChangePercent"];
-      spx.marketOpen = strcmp(doc["quoteResponse"]["result"][0]["marketState"], "REGULAR") == 0 ? true : false;
-
-      ndx.current = doc["quoteResponse"]["result"][1]["regularMarketPrice"];
-      ndx.previousClose = doc["quoteResponse"]["result"][1]["regularMarketPreviousClose"];
-      ndx.percentageChange = doc["quoteResponse"]["result"][1]["regularMarketChangePercent"];
-      ndx.marketOpen = strcmp(doc["quoteResponse"]["result"][1]["marketState"], "REGULAR") == 0 ? true : false;
-      
-      bnd.current = (double)(doc["quoteResponse"]["result"][2]["regularMarketPrice"]) * 1000.0;
-      bnd.previousClose = (double)(doc["quoteResponse"]["result"][2]["regularMarketPreviousClose"]) * 1000.0;
-      bnd.percentageChange = doc["quoteResponse"]["result"][2]["regularMarketChangePercent"];
-      bnd.marketOpen = strcmp(doc["quoteResponse"]["result"][2]["marketState"], "REGULAR") == 0 ? true : false;
-      
-      Serial.printf("SPX \t %8.1f from %8.1f \t (%+.1f%%) MarketOpen=%d\n", spx.current, spx.previousClose, spx.percentageChange, spx.marketOpen);
-      Serial.printf("NDX \t %8.1f from %8.1f \t (%+.1f%%) MarketOpen=%d\n", ndx.current, ndx.previousClose, ndx.percentageChange, ndx.marketOpen);
-      Serial.printf("T10 \t %8.1f from %8.1f \t (%+.1f%%) MarketOpen=%d\n", bnd.current, bnd.previousClose, bnd.percentageChange, bnd.marketOpen);
+// Move the new quotes (watchlist, then FX pairs) into the quote table: prices in major units and
+// checked for bad prints, new currencies registered for their rates, rates updated.
+// Rejected quotes are cleared from updated.
+void applyQuotes(quote *parsed, bool *updated, int pairs, const int *pair_currency) {
+  for (int i = 0; i < watchlist_count; i++) {
+    if (!updated[i]) {
+      continue;
+    }
+    fxNormalise(parsed[i]);
+    filter_result check = quoteFilter(i, parsed[i]);
+    if (check != FILTER_OK) {
+      LOG_WARN("%s \t %.4f rejected: %s", watchlist[i].label, parsed[i].current, filterResultName(check));
+      updated[i] = false;
+      continue;
+    }
+    fxCurrency(parsed[i].currency);
+    quotes[i] = parsed[i];
+  }
+  for (int i = 0; i < pairs; i++) {
+    if (updated[watchlist_count + i]) {
+      fxUpdate(pair_currency[i], parsed[watchlist_count + i].current);
+    }
+  }
+}
+
+// Queue every symbol in the watchlist and the FX pairs of the currencies in use for Yahoo
+// Finance. The broker batches them into as few requests as the URL length allows and the loop
+// advances those with pollQuotes() between frames. Symbols with cached reference data only ask
+// for the fast fields; the reference data is fetched again in the background when it is due,
+// and right away, in place of the fast fields, for symbols that have none yet.
+void startQuotes() {
+  const char *pairs[FX_MAX];
+  int pair_currency[FX_MAX];
+  int pair_count = fxPairs(pairs, pair_currency);
+  cpuBoostAcquire();              // TLS handshake and JSON parsing at full speed
+  if (metrics.fetches > 0) {
+    wifiPowerSetPollInterval(clockMillis() - fetch_started);  // Live pages fetch every frame, others less often
+  }
+  fetching = true;
+  fetch_started = clockMillis();
+  cycle_result = FETCH_FAILED;
+  crashTrace(TRACE_FETCH_START);
+
+  StageTimer timer(STAGE_FETCH);
+  time_t now = clockTime();
+  for (int i = 0; i < watchlist_count; i++) {
+    if (refGet(i) == nullptr) {
+      brokerSubmit(reference_endpoint, watchlist[i].symbol, PRIORITY_LIVE, fetch_started);
+      continue;
+    }
+    brokerSubmit(quote_endpoint, watchlist[i].symbol, PRIORITY_LIVE, fetch_started);
+    if (now >= CLOCK_VALID && refDue(i, now)) {
+      brokerSubmit(reference_endpoint, watchlist[i].symbol, PRIORITY_BACKFILL, fetch_started);
+    }
+  }
+  for (int i = 0; i < pair_count; i++) {
+    brokerSubmit(quote_endpoint, pairs[i], PRIORITY_LIVE, fetch_started);   // Only the rate is used
+  }
+  brokerStart(fetch_started);
+}
+
+// Position of symbol in the quote table layout applyQuotes() takes (watchlist, then FX pairs),
+// or -1 if it is in neither any more
+int quoteSlot(const char *symbol, const char *const *pairs, int pair_count) {
+  for (int i = 0; i < watchlist_count; i++) {
+    if (strcmp(watchlist[i].symbol, symbol) == 0) {
+      return i;
+    }
+  }
+  for (int i = 0; i < pair_count; i++) {
+    if (strcmp(pairs[i], symbol) == 0) {
+      return watchlist_count + i;
+    }
+  }
+  return -1;
+}
+
+// One answered request: parsed and applied, unless it is identical to the previous answer to
+// the same URL. Answers with reference data refresh the cache as well.
+fetch_result finishQuotes(const broker_response &r) {
+  int httpCode = r.status;
+  bool with_reference = r.endpoint == reference_endpoint;
+  const char *pairs[FX_MAX];
+  int pair_currency[FX_MAX];
+  int pair_count = fxPairs(pairs, pair_currency);
+  crashTrace(TRACE_FETCH_DONE, httpCode);
+  if (httpCode == 200 && r.unchanged) {
+    for (int k = 0; k < r.count && with_reference; k++) {
+      int i = quoteSlot(r.items[k], pairs, pair_count);
+      if (i >= 0 && i < watchlist_count) {
+        refTouch(i, clockTime());
+      }
+    }
+    refSave();
+    LOG_DEBUG("Response unchanged (%u bytes), not parsed.", r.length);
+    metricsRecordUnchanged();
+    crashTrace(TRACE_PARSE_DONE, true);
+    return FETCH_UNCHANGED;
+  }
+  if (httpCode != 200) {
+    if (httpCode < 0) {
+      LOG_ERROR("Error getting data from Yahoo (%s).", asyncHttpErrorName(httpCode));
     } else {
-      Serial.println("Error deserializing data: ");
-      Serial.println(error.f_str());
-    }    
-  } else {
-    Serial.println("Error getting data from Yahoo.");
+      LOG_ERROR("Error getting data from Yahoo (HTTP %d).", httpCode);
+    }
+    crashTrace(TRACE_PARSE_DONE, false);
+    return FETCH_FAILED;
+  }
+
+  // Parse JSON data
+  static quote parsed[BROKER_QUEUE];
+  static reference refs[BROKER_QUEUE];
+  bool updated[BROKER_QUEUE];
+  parse_status status;
+  int64_t t0 = esp_timer_get_time();
+  {
+    StageTimer timer(STAGE_PARSE);
+    status = parseQuotes(r.body, r.length, r.items, r.count, parsed, updated, with_reference ? refs : nullptr);
+  }
+  metricsRecordParse(r.length, esp_timer_get_time() - t0, status == PARSE_OK);
+  if (status != PARSE_OK && status != PARSE_PARTIAL) {
+    LOG_ERROR("Error parsing data from Yahoo: %s.", parseStatusName(status));
+    brokerForget(r);
+    crashTrace(TRACE_PARSE_DONE, false);
+    return FETCH_FAILED;
   }
 
-  http.end();
+  // Symbols as they are now; the lists may have changed in flight, so results are matched by name.
+  // Fast quotes of the watchlist get their previous close and currency from the reference data.
+  StageTimer timer(STAGE_UPDATE);
+  static quote table[WATCHLIST_MAX + FX_MAX];
+  bool table_updated[WATCHLIST_MAX + FX_MAX] = {};
+  bool asked[WATCHLIST_MAX + FX_MAX] = {};
+  for (int k = 0; k < r.count; k++) {
+    int i = quoteSlot(r.items[k], pairs, pair_count);
+    if (i < 0) {
+      continue;
+    }
+    if (i < watchlist_count && updated[k]) {
+      if (with_reference && !isnan(refs[k].previousClose)) {
+        refStore(i, refs[k], clockTime());
+      }
+      updated[k] = refFill(i, parsed[k]);
+    }
+    table[i] = parsed[k];
+    table_updated[i] = updated[k];
+    asked[i] = true;
+  }
+  refSave();
+  applyQuotes(table, table_updated, pair_count, pair_currency);
+
+  LOG_INFO("--------------------------------------------");
+  for (int i = 0; i < watchlist_count; i++) {
+    const quote &q = quotes[i];
+    if (!asked[i]) {
+      continue;
+    }
+    if (!table_updated[i]) {
+      LOG_WARN("%s \t not updated", watchlist[i].label);
+      continue;
+    }
+    LOG_INFO("%s \t %8.1f from %8.1f \t (%+.1f%%) MarketOpen=%d", watchlist[i].label,
+             q.current * watchlist[i].scale, q.previousClose * watchlist[i].scale, q.percentageChange, q.marketOpen);
+
+    // Push the same update to host tools listening on the binary feed
+    feedPublish(watchlist[i].label, q);
+  }
+  crashTrace(TRACE_PARSE_DONE, true);
+  return FETCH_UPDATED;
 }
 
-// Write a stock quote to the TFT screen at a certain vertical position.
-// The separator char is use to provide scaling in case of showing thousands or millis
-void drawQuote(const quote& symbol, int pos, char sep) {
-  // Set drawing colour according to market state and if the stock is up or down
-  if (symbol.marketOpen == false) {
-    tft.setTextColor(TFT_DARKGREY, TFT_BLACK);
-  } else if (symbol.current > symbol.previousClose) {
-    tft.setTextColor(TFT_GREEN, TFT_BLACK);
-  } else if (symbol.current == symbol.previousClose) {
-    tft.setTextColor(TFT_WHITE, TFT_BLACK);
-  } else {
-    tft.setTextColor(TFT_RED, TFT_BLACK);
+// Advance the quote requests without waiting. FETCH_PENDING until all of them are answered;
+// the cycle has updated the quotes if any of them did, and failed only if none got through.
+fetch_result pollQuotes() {
+  broker_response r;
+  for (;;) {
+    bool answered;
+    {
+      StageTimer timer(STAGE_FETCH);
+      answered = brokerPoll(clockMillis(), r);
+    }
+    if (!answered) {
+      break;
+    }
+    fetch_result result = finishQuotes(r);
+    if (result == FETCH_UPDATED || cycle_result == FETCH_FAILED) {
+      cycle_result = result;
+    }
+  }
+  if (brokerPending() > 0) {
+    return FETCH_PENDING;
+  }
+  fetching = false;
+  metricsRecordFetch(clockMillis() - fetch_started, WiFi.RSSI(), cycle_result != FETCH_FAILED);
+  cpuBoostRelease();
+  return cycle_result;
+}
+
+// Take the quotes pushed over MQTT since the last call. Nothing waits on the network here: the
+// messages were decoded in the MQTT task as they arrived.
+fetch_result receiveQuotes() {
+  static quote received[WATCHLIST_MAX + FX_MAX];
+  bool updated[WATCHLIST_MAX + FX_MAX] = {};
+  const char *symbols[WATCHLIST_MAX + FX_MAX];
+  int pair_currency[FX_MAX];
+  int pairs = fxPairs(symbols + watchlist_count, pair_currency);
+  for (int i = 0; i < watchlist_count; i++) {
+    symbols[i] = watchlist[i].symbol;
   }
+  mqttSourceSubscribe(symbols, watchlist_count + pairs);
 
-  // Actually write the stock value to the TFT
-  char buf[BUF_SIZE];
-  comma_separator(symbol.current, buf, sep);
-  tft.drawString(buf, TFT_HEIGHT, tft.fontHeight(TFT_FONT)*pos, TFT_FONT);
+  int64_t first_us;
+  if (mqttSourceTake(received, updated, first_us) == 0) {
+    return FETCH_UNCHANGED;
+  }
+  StageTimer timer(STAGE_UPDATE);
+  applyQuotes(received, updated, pairs, pair_currency);
+  for (int i = 0; i < watchlist_count; i++) {
+    if (updated[i]) {
+      feedPublish(watchlist[i].label, quotes[i]);
+    }
+  }
+  if (tick_us == 0) {
+    tick_us = first_us;
+  }
+  return FETCH_UPDATED;
 }
 
-void drawPercentChange(const quote& symbol, int pos) {
-  // Set drawing colour according to market state and if the stock is up or down
-  if (symbol.marketOpen == false) { 
-    tft.setTextColor(TFT_DARKGREY, TFT_BLACK);
-  } else if (symbol.percentageChange > 0.0) {
-    tft.setTextColor(TFT_GREEN, TFT_BLACK);
-  } else if (abs(symbol.percentageChange) < 0.001) {
-    tft.setTextColor(TFT_WHITE, TFT_BLACK);
-  } else {
-    tft.setTextColor(TFT_RED, TFT_BLACK);
+// Connection banner, shown until the first quotes arrive and between quote pages while the portal is up
+void drawStatus() {
+  static prov_state shown_state;
+  if (screen_page == PAGE_STATUS && shown_state == provisioningState()) {
+    return;
   }
+  shown_state = provisioningState();
+  drawStatusPage(provisioningPortalActive(), WiFi.softAPIP().toString().c_str());
+}
 
-  // Actually write the stock percentage change from the previous day to the TFT
-  char buf[BUF_SIZE];
-  sprintf(buf, "%+.1f%%", symbol.percentageChange);
-  tft.drawString(buf, TFT_HEIGHT, tft.fontHeight(TFT_FONT)*pos, TFT_FONT);
+// Frames a visit of page p lasts. The live pages stay up for several fetches.
+int pageFrames(page p) {
+  switch (p) {
+    case PAGE_HEATMAP:
+      return HEATMAP_FRAMES;
+    case PAGE_CANDLES:
+      return CANDLE_FRAMES;
+    default:
+      return 1;
+  }
 }
 
-// Main looop showing the quotes on the TFT screen
+// Pick the page that follows page p
+page pageAfter(page p) {
+  if (!have_quotes) {
+    return PAGE_STATUS;
+  }
+  if (p == current_page && page_frames < pageFrames(p)) {
+    return p;
+  }
+  switch (p) {
+    case PAGE_VALUES:
+      return PAGE_CHANGE;
+    case PAGE_CHANGE:
+      return watchlist_count > TEXT_ROWS ? PAGE_HEATMAP : PAGE_PORTFOLIO;
+    case PAGE_HEATMAP:
+      return PAGE_PORTFOLIO;
+    case PAGE_PORTFOLIO:
+      return PAGE_CHART;
+    case PAGE_CHART:
+      return PAGE_CANDLES;
+    case PAGE_CANDLES:
+      return provisioningPortalActive() ? PAGE_STATUS : PAGE_VALUES;
+    default:
+      return PAGE_VALUES;
+  }
+}
+
+// Chart the next symbol, stepping to the next zoom level after each pass over the watchlist.
+// Returns false when that symbol has too little history to chart.
+bool drawChart() {
+  int symbol = chart_symbol;
+  chart_zoom zoom = chart_level;
+  if (++chart_symbol >= watchlist_count) {
+    chart_symbol = 0;
+    chart_level = (chart_zoom)((chart_level + 1) % ZOOM_LEVELS);
+  }
+  return drawChartPage(symbol, zoom);
+}
+
+// Candles of the next symbol, stepping through the widths like the chart. Later frames of the
+// same visit, and redraws for quotes pushed over MQTT, only repaint the current candle.
+bool drawCandles() {
+  static int symbol;
+  static candle_interval interval;
+  bool first = page_frames == 1 && screen_page != PAGE_CANDLES;
+  if (first) {
+    symbol = candle_symbol;
+    interval = candle_level;
+    if (++candle_symbol >= watchlist_count) {
+      candle_symbol = 0;
+      candle_level = (candle_interval)((candle_level + 1) % CANDLE_INTERVALS);
+    }
+  }
+  return drawCandlePage(symbol, interval, first);
+}
+
+// Quotes are fetched once per cycle right before the values page, and before every further
+// frame of a live page so it shows the market moving (or every status page until there are quotes)
+bool fetchBefore(page from, page to) {
+  return to == PAGE_VALUES || from == to;
+}
+
+// A new watchlist makes the history, candles and charts of the old one meaningless
+void checkWatchlist() {
+  static uint32_t seen_version = 0;
+  if (watchlist_version == seen_version) {
+    return;
+  }
+  seen_version = watchlist_version;
+  tsdbClear();
+  candlesClear();
+  chartReset();
+  quoteFilterReset();
+  portfolioBind();
+  refBind();
+  refSave();
+  chart_symbol = 0;
+  candle_symbol = 0;
+  screen_page = -1;               // Labels and heatmap layout are stale
+  LOG_INFO("Watchlist changed, history cleared.");
+}
+
+// Add one sample per minute for every symbol to the compressed history
+void recordHistory() {
+  static time_t last_minute = 0;
+  time_t now = clockTime();
+  if (now < CLOCK_VALID || now / 60 == last_minute) {
+    return;
+  }
+  last_minute = now / 60;
+  for (int i = 0; i < watchlist_count; i++) {
+    if (quotes[i].current > 0.0) {          // Not fetched yet
+      tsdbAppend(i, last_minute * 60, quotes[i].current);
+    }
+  }
+}
+
+// Reprice the positions, in the currency their quote reports; only symbols whose quote changed touch them
+void updatePortfolio() {
+  for (int i = 0; i < watchlist_count; i++) {
+    if (quotes[i].current > 0.0) {          // Not fetched yet
+      if (portfolioSetCurrency(i, quotes[i].currency) > 0) {
+        LOG_WARN("Portfolio: %s is quoted in %s, not the currency it was entered with; totals follow the quote.",
+                 watchlist[i].symbol, quotes[i].currency);
+      }
+      portfolioUpdate(i, quotes[i].current, quotes[i].previousClose);
+    }
+  }
+  for (int c = 0; c < portfolioCurrencies(); c++) {
+    if (portfolioTotal(c).positions > 0) {
+      fxCurrency(portfolioTotal(c).currency);   // So its FX pair is fetched
+    }
+  }
+}
+
+// Fold the fresh quotes into the candles, while their market trades
+void recordCandles() {
+  time_t now = clockTime();
+  if (now < CLOCK_VALID) {
+    return;
+  }
+  for (int i = 0; i < watchlist_count; i++) {
+    if (quotes[i].marketOpen) {
+      candlesAdd(i, now, quotes[i].current);
+    }
+  }
+}
+
+// New quotes, from Yahoo or MQTT, go into the history, candles, portfolio and MQTT feed; failed
+// fetches climb the recovery ladder
+void fetchDone(fetch_result result) {
+  quotes_changed |= result == FETCH_UPDATED;
+  if (result == FETCH_UPDATED) {
+    StageTimer timer(STAGE_UPDATE);
+    have_quotes = true;
+    recordHistory();
+    recordCandles();
+    updatePortfolio();
+    mqttPublishQuotes();
+  }
+  if (result != FETCH_FAILED) {
+    healthFetchSucceeded();
+    return;
+  }
+
+  recovery_step step = healthFetchFailed();
+  crashTrace(TRACE_RECOVERY, step);
+  switch (step) {
+    case RECOVER_ABORT:
+      break;
+    case RECOVER_SOCKET:
+      brokerStop();
+      break;
+    case RECOVER_WIFI:
+      brokerStop();
+      provisioningRestart();
+      break;
+    default:
+      ESP.restart();
+  }
+}
+
+// Pages that show the latest quotes and are redrawn as soon as new ones come over MQTT
+bool livePage(page p) {
+  return p == PAGE_VALUES || p == PAGE_CHANGE || p == PAGE_HEATMAP || p == PAGE_PORTFOLIO || p == PAGE_CANDLES;
+}
+
+// Draw current_page
+void renderPage() {
+  CpuBoost boost;               // Render at full speed
+  StageTimer timer(STAGE_RENDER);
+  crashTrace(TRACE_RENDER, current_page);
+  renderFrameBegin();
+
+  switch (current_page) {
+    case PAGE_VALUES:
+      drawValuesPage(screen_page != PAGE_VALUES && screen_page != PAGE_CHANGE);
+      screen_page = PAGE_VALUES;
+      break;
+    case PAGE_CHANGE:
+      drawChangePage(screen_page != PAGE_VALUES && screen_page != PAGE_CHANGE);
+      screen_page = PAGE_CHANGE;
+      break;
+    case PAGE_HEATMAP:
+      drawHeatmapPage(screen_page != PAGE_HEATMAP);
+      screen_page = PAGE_HEATMAP;
+      break;
+    case PAGE_PORTFOLIO:
+      if (!drawPortfolioPage()) {
+        page_shown -= DELAY;
+        break;
+      }
+      screen_page = PAGE_PORTFOLIO;
+      break;
+    case PAGE_CHART:
+      if (!drawChart()) {
+        page_shown -= DELAY;    // Nothing to chart yet, move on next frame
+        break;
+      }
+      screen_page = PAGE_CHART;
+      break;
+    case PAGE_CANDLES:
+      if (!drawCandles()) {
+        page_frames = CANDLE_FRAMES;
+        page_shown -= DELAY;
+        break;
+      }
+      screen_page = PAGE_CANDLES;
+      break;
+    case PAGE_STATUS:
+      drawStatus();
+      screen_page = PAGE_STATUS;
+      break;
+  }
+  renderFrameEnd();
+  quotes_changed = false;
+  if (tick_us != 0) {
+    metricsRecordTickToPixel(esp_timer_get_time() - tick_us);
+    tick_us = 0;
+  }
+}
+
+// Sleep until the next frame, waking early when a quote request can make progress
+void frameWait() {
+  if (brokerInFlight()) {
+    brokerWait(FRAME);
+  } else {
+    clockDelay(FRAME);
+  }
+}
+
+// Main looop showing the quotes on the TFT screen. Every page stays up for DELAY ms, and
+// the loop wakes up every FRAME ms to serve Wi-Fi provisioning in the meantime.
 void loop() {
-  getQuotes();
+  healthHeartbeat();
+  metricsPoll();
+  backlightPoll();
+  crashReportPoll(provisioningConnected());
+  mqttPoll(provisioningConnected());
+  mqttSourcePoll(provisioningConnected());
 
-  tft.fillRect(TFT_HEIGHT-black_width, 0, black_width, TFT_HEIGHT, TFT_BLACK);
-  drawQuote(spx, 0, ',');
-  drawQuote(ndx, 1, ',');
-  drawQuote(bnd, 2, '.');
+  {
+    StageTimer timer(STAGE_NETWORK);
+    provisioningPoll();
 
-  delay(DELAY);
+    // When the next fetch happens
+    int pages = 1;
+    for (page p = current_page, n = pageAfter(p); !fetchBefore(p, n); p = n, n = pageAfter(n)) {
+      pages++;
+    }
+    // Quotes pushed over MQTT can arrive at any time, so the radio stays awake for them
+    unsigned long next_fetch = mqttSourceActive() ? clockMillis() : page_shown + pages * DELAY;
+    wifiPowerPoll(provisioningConnected(), next_fetch);
+  }
+  checkWatchlist();
 
-  tft.fillRect(TFT_HEIGHT-black_width, 0, black_width, TFT_HEIGHT, TFT_BLACK);
-  drawPercentChange(spx, 0);
-  drawPercentChange(ndx, 1);
-  drawPercentChange(bnd, 2);
+  // New quotes go on the screen as soon as they are in if the page shows them, whether they
+  // came over MQTT or the request to Yahoo just completed
+  if (mqttSourceActive()) {
+    fetchDone(receiveQuotes());
+  } else if (fetching) {
+    fetch_result result = pollQuotes();
+    if (result != FETCH_PENDING) {
+      fetchDone(result);
+      wifiPowerSleep();
+    }
+  }
+  if (quotes_changed && have_quotes && screen_page == current_page && livePage(current_page) &&
+      clockMillis() - page_shown < DELAY) {
+    renderPage();
+  }
+
+  if (clockMillis() - page_shown >= DELAY) {
+    page next = pageAfter(current_page);
+    if (!mqttSourceActive() && !fetching && fetchBefore(current_page, next) && provisioningConnected()) {
+      startQuotes();
+    }
+
+    page_frames = next == current_page ? page_frames + 1 : 1;
+    current_page = next;
+    page_shown = clockMillis();
+
+    // Live pages repeat to show new quotes; if the response did not change the screen is still right
+    if (page_frames > 1 && pageFrames(current_page) > 1 && screen_page == current_page && !quotes_changed) {
+      metricsRecordFrameSkipped();
+      frameWait();
+      return;
+    }
+    renderPage();
+  }
 
-  delay(DELAY);
+  frameWait();
 }
@@ -0,0 +1,168 @@
+
+#include <Arduino.h>
+
+#include "backlight.h"
+#include "cpu_power.h"
+#include "fetch_broker.h"
+#include "health.h"
+#include "log.h"
+#include "lttb.h"
+#include "metrics.h"
+#include "mqtt_publish.h"
+#include "mqtt_source.h"
+#include "profile.h"
+#include "quote_filter.h"
+#include "render_stats.h"
+#include "tsdb.h"
+#include "vclock.h"
+#include "wifi_power.h"
+
+// ------------------------------------------------------------------------------------
+metrics_t metrics;
+static unsigned long last_report = 0;
+// ------------------------------------------------------------------------------------
+
+void metricsRecordFetch(uint32_t ms, int rssi, bool ok) {
+  metrics.fetches++;
+  if (!ok) {
+    metrics.fetchErrors++;
+  }
+
+  int band = 0;
+  while (band < RSSI_BANDS - 1 && rssi < RSSI_BAND_FLOOR[band]) {
+    band++;
+  }
+  metrics.bandFetches[band]++;
+  metrics.bandLatencyMs[band] += ms;
+  if (ms > metrics.bandLatencyMaxMs[band]) {
+    metrics.bandLatencyMaxMs[band] = ms;
+  }
+}
+
+void metricsRecordParse(uint32_t len, uint32_t us, bool ok) {
+  metrics.parses++;
+  if (!ok) {
+    metrics.parseErrors++;
+  }
+  metrics.parseBytes += len;
+  metrics.parseUs += us;
+}
+
+void metricsRecordUnchanged() {
+  metrics.unchanged++;
+}
+
+void metricsRecordFrameSkipped() {
+  metrics.framesSkipped++;
+}
+
+void metricsRecordTickToPixel(uint32_t us) {
+  metrics.ticksDrawn++;
+  metrics.tickToPixelUs += us;
+  if (us > metrics.tickToPixelMaxUs) {
+    metrics.tickToPixelMaxUs = us;
+  }
+}
+
+void metricsPoll() {
+  if (clockMillis() - last_report < METRICS_INTERVAL) {
+    return;
+  }
+  last_report = clockMillis();
+
+  LOG_INFO("Metrics: %u fetches, %u errors, %u roams, log dropped %u",
+           metrics.fetches, metrics.fetchErrors, metrics.roams, logDropped());
+  const health_counters &h = healthCounters();
+  LOG_INFO("Metrics: recovery %u aborts, %u socket resets, %u wifi restarts, %u reboots, %u watchdog resets",
+           h.steps[RECOVER_ABORT], h.steps[RECOVER_SOCKET], h.steps[RECOVER_WIFI], h.steps[RECOVER_REBOOT],
+           h.watchdogResets);
+  if (metrics.parseUs > 0) {
+    LOG_INFO("Metrics: parsed %u responses (%u malformed), %u KB at %u KB/s",
+             metrics.parses, metrics.parseErrors, (uint32_t)(metrics.parseBytes / 1024),
+             (uint32_t)(metrics.parseBytes * 1000000 / 1024 / metrics.parseUs));
+  }
+  if (metrics.unchanged > 0 && metrics.parses > 0) {
+    // What the skipped cycles would have cost, at the average of the processed ones
+    uint64_t cycle_us = (stage_totals[STAGE_PARSE].us + stage_totals[STAGE_UPDATE].us) / metrics.parses;
+    uint64_t frame_us = render_total.frames > 0 ? render_total.us / render_total.frames : 0;
+    LOG_INFO("Metrics: %u unchanged responses and %u frames skipped, ~%u ms CPU saved",
+             metrics.unchanged, metrics.framesSkipped,
+             (uint32_t)((metrics.unchanged * cycle_us + metrics.framesSkipped * frame_us) / 1000));
+  }
+  filter_stats quality = quoteFilterStats();
+  LOG_INFO("Metrics: quotes %u accepted, rejected %u invalid, %u out of bounds, %u spikes, %u level shifts",
+           quality.accepted, quality.rejected[FILTER_INVALID], quality.rejected[FILTER_BOUNDS],
+           quality.rejected[FILTER_SPIKE], quality.levelShifts);
+  if (render_total.frames > 0) {
+    LOG_INFO("Metrics: %u frames, %u calls and %u pixels per frame (max %u), %u us per frame",
+             render_total.frames, (uint32_t)(render_total.calls / render_total.frames),
+             (uint32_t)(render_total.pixels / render_total.frames), render_total.maxPixels,
+             (uint32_t)(render_total.us / render_total.frames));
+  }
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    const stage_stats &st = stage_totals[i];
+    if (st.calls > 0) {
+      LOG_INFO("Metrics: stage %-8s %6u calls, %6u us avg, %u ms total, %u allocs",
+               STAGE_NAMES[i], st.calls, (uint32_t)(st.us / st.calls), (uint32_t)(st.us / 1000), st.allocs);
+    }
+  }
+  LOG_INFO("Metrics: %u heap allocations, %u bytes free", profileAllocations(), ESP.getFreeHeap());
+  tsdb_stats hist = tsdbStats();
+  if (hist.bytes > 0) {
+    LOG_INFO("Metrics: history %u samples in %u bytes, %.1f bits/sample, %.1fx smaller than raw, %u blocks recycled",
+             hist.samples, hist.bytes, hist.bytes * 8.0 / (hist.samples ? hist.samples : 1),
+             (double)hist.samples * TSDB_NAIVE_SAMPLE_BYTES / hist.bytes, hist.evictions);
+  }
+  chart_cache_stats charts = chartCacheStats();
+  if (charts.hits + charts.misses > 0) {
+    LOG_INFO("Metrics: chart pages %u updated incrementally, %u built from scratch", charts.hits, charts.misses);
+  }
+  const broker_stats &br = brokerStats();
+  if (br.requests > 0) {
+    LOG_INFO("Metrics: broker %u symbols asked, %u coalesced, %u dropped; %u requests of %.1f symbols, %u throttled, %u failed",
+             br.submitted, br.coalesced, br.dropped, br.requests, (double)br.batched / br.requests, br.throttled,
+             br.failed);
+    for (int p = 0; p < PRIORITIES; p++) {
+      if (br.started[p] > 0) {
+        LOG_INFO("Metrics: broker %-8s queue %d now, %d max; %u requests waited %u ms avg, %u ms max",
+                 PRIORITY_NAMES[p], br.depth[p], br.depthMax[p], br.started[p], br.waitMs[p] / br.started[p],
+                 br.waitMaxMs[p]);
+      }
+    }
+  }
+  const mqtt_stats &mq = mqttStats();
+  if (mq.batches > 0 || mq.dropped > 0) {
+    LOG_INFO("Metrics: MQTT %u messages in %u batches (%u acked), %u unchanged, %u dropped, %u connects, last batch queued in %u us",
+             mq.published, mq.batches, mq.acked, mq.unchanged, mq.dropped, mq.connects, mq.enqueueUs);
+  }
+  const mqtt_source_stats &src = mqttSourceStats();
+  if (src.received > 0 || src.malformed > 0) {
+    LOG_INFO("Metrics: MQTT source %u quotes, %u malformed, %u overwritten before use, %u connects",
+             src.received, src.malformed, src.overwritten, src.connects);
+  }
+  if (metrics.ticksDrawn > 0) {
+    LOG_INFO("Metrics: tick to pixel %u us avg, %u us max over %u frames",
+             (uint32_t)(metrics.tickToPixelUs / metrics.ticksDrawn), metrics.tickToPixelMaxUs, metrics.ticksDrawn);
+  }
+  LOG_INFO("Metrics: radio on ~%u s per hour", wifiPowerRadioOnPerHour() / 1000);
+
+  // Fetch latency against CPU time spent boosted, to judge the frequency scaling trade-off
+  uint32_t fetches = 0, latency = 0;
+  for (int i = 0; i < RSSI_BANDS; i++) {
+    fetches += metrics.bandFetches[i];
+    latency += metrics.bandLatencyMs[i];
+  }
+  LOG_INFO("Metrics: CPU %u s at %d MHz, %u s at %d MHz, ~%u mA, avg fetch %u ms",
+           cpuPowerIdleMs() / 1000, CPU_IDLE_MHZ, cpuPowerBoostMs() / 1000, CPU_BOOST_MHZ,
+           cpuPowerAverageMa(), fetches ? latency / fetches : 0);
+
+  uint32_t duty = backlightAverageDuty();
+  LOG_INFO("Metrics: backlight at %u%% on average, ~%u mA saved", duty, BACKLIGHT_FULL_MA * (100 - duty) / 100);
+  for (int i = 0; i < RSSI_BANDS; i++) {
+    uint32_t n = metrics.bandFetches[i];
+    if (n > 0) {
+      LOG_INFO("Metrics: RSSI >= %4d dBm: %u fetches, avg %u ms, max %u ms",
+               RSSI_BAND_FLOOR[i], n, metrics.bandLatencyMs[i] / n, metrics.bandLatencyMaxMs[i]);
+    }
+  }
+}
@@ -0,0 +1,45 @@
+#include <Arduino.h>
+#include <mqtt_client.h>
+
+#include "log.h"
+#include "mqtt_common.h"
+
+void mqttTopicFor(const char *prefix, const char *symbol, char *topic) {
+  int n = snprintf(topic, MQTT_TOPIC_SIZE, "%s/", prefix);
+  for (const char *c = symbol; *c && n < MQTT_TOPIC_SIZE - 1; c++) {
+    topic[n++] = (*c == '/' || *c == '+' || *c == '#') ? '_' : *c;
+  }
+  topic[n] = '\0';
+}
+
+String mqttCleanPrefix(const char *prefix, const char *fallback) {
+  String clean = prefix;
+  clean.trim();
+  while (clean.endsWith("/")) {
+    clean.remove(clean.length() - 1);
+  }
+  return clean.length() > 0 ? clean : String(fallback);
+}
+
+// The client keeps its own copies of the strings in config
+esp_mqtt_client_handle_t mqttCreateClient(esp_mqtt_client_config_t &config, const char *uri, const char *id_base,
+                                          esp_event_handler_t onEvent, const char *tag) {
+  char client_id[24];
+  snprintf(client_id, sizeof(client_id), "%s-%06x", id_base, (uint32_t)(ESP.getEfuseMac() >> 24) & 0xFFFFFF);
+  config.uri = uri;
+  config.client_id = client_id;
+  esp_mqtt_client_handle_t client = esp_mqtt_client_init(&config);
+  if (client == nullptr) {
+    LOG_ERROR("%s: bad broker %s", tag, uri);
+    return nullptr;
+  }
+  esp_mqtt_client_register_event(client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID, onEvent, nullptr);
+  return client;
+}
+
+void mqttDestroyClient(esp_mqtt_client_handle_t &client) {
+  if (client != nullptr) {
+    esp_mqtt_client_destroy(client);
+    client = nullptr;
+  }
+}
@@ -0,0 +1,167 @@
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <mqtt_client.h>
+
+#include "log.h"
+#include "mqtt_common.h"
+#include "mqtt_publish.h"
+#include "vclock.h"
+#include "watchlist.h"
+
+// ------------------------------------------------------------------------------------
+const int PAYLOAD_SIZE = 96;
+const int KEEPALIVE = 60;                   // Seconds; fetches are much more frequent than this
+
+static Preferences prefs;
+static String broker_uri;
+static String topic_prefix;
+static int publish_qos = 0;
+static esp_mqtt_client_handle_t client = nullptr;
+static bool started = false;
+static volatile bool broker_up = false;     // Set from the MQTT task
+static volatile bool resend = false;        // Broker (re)connected: publish every symbol again
+static quote published[WATCHLIST_MAX];      // What the broker holds for each symbol
+static bool published_valid[WATCHLIST_MAX];
+static uint32_t published_version = 0;
+static mqtt_stats stats;
+// ------------------------------------------------------------------------------------
+
+// Runs in the MQTT client task: only flags and counters are touched here
+static void onEvent(void *arg, esp_event_base_t base, int32_t id, void *data) {
+  switch ((esp_mqtt_event_id_t)id) {
+    case MQTT_EVENT_CONNECTED:
+      broker_up = true;
+      resend = true;
+      stats.connects++;
+      break;
+    case MQTT_EVENT_DISCONNECTED:
+      broker_up = false;
+      break;
+    case MQTT_EVENT_PUBLISHED:
+      stats.acked++;
+      break;
+    default:
+      break;
+  }
+}
+
+static void createClient() {
+  mqttDestroyClient(client);
+  started = false;
+  broker_up = false;
+  if (broker_uri.length() == 0) {
+    return;
+  }
+
+  char status_topic[MQTT_TOPIC_SIZE];
+  snprintf(status_topic, sizeof(status_topic), "%s/status", topic_prefix.c_str());
+  esp_mqtt_client_config_t config = {};
+  config.keepalive = KEEPALIVE;
+  config.lwt_topic = status_topic;
+  config.lwt_msg = "offline";
+  config.lwt_retain = 1;
+  config.lwt_qos = 1;
+  client = mqttCreateClient(config, broker_uri.c_str(), "t-dongle", onEvent, "MQTT");
+}
+
+void mqttBegin() {
+  prefs.begin("mqtt", true);
+  broker_uri = prefs.getString("uri", "");
+  topic_prefix = prefs.getString("prefix", "tdongle/quotes");
+  publish_qos = prefs.getInt("qos", 0);
+  prefs.end();
+  createClient();
+  if (client != nullptr) {
+    LOG_INFO("MQTT: publishing to %s under %s, QoS %d", broker_uri.c_str(), topic_prefix.c_str(), publish_qos);
+  }
+}
+
+void mqttPoll(bool connected) {
+  if (client != nullptr && connected && !started) {
+    started = esp_mqtt_client_start(client) == ESP_OK;
+  }
+}
+
+int mqttPublishQuotes() {
+  if (client == nullptr) {
+    return 0;
+  }
+  if (published_version != watchlist_version) {
+    published_version = watchlist_version;
+    memset(published_valid, 0, sizeof(published_valid));
+  }
+  if (!broker_up) {
+    stats.dropped += watchlist_count;
+    return 0;
+  }
+  if (resend) {
+    resend = false;
+    memset(published_valid, 0, sizeof(published_valid));
+    char status_topic[MQTT_TOPIC_SIZE];
+    snprintf(status_topic, sizeof(status_topic), "%s/status", topic_prefix.c_str());
+    esp_mqtt_client_enqueue(client, status_topic, "online", 0, 1, 1, true);
+  }
+
+  // The whole cycle goes into the client's outbox at once; its task writes it out back to back
+  int64_t t0 = esp_timer_get_time();
+  time_t now = clockTime();
+  int queued = 0;
+  for (int i = 0; i < watchlist_count; i++) {
+    const quote &q = quotes[i];
+    if (published_valid[i] && published[i].current == q.current &&
+        published[i].previousClose == q.previousClose && published[i].marketOpen == q.marketOpen) {
+      stats.unchanged++;
+      continue;
+    }
+    char topic[MQTT_TOPIC_SIZE];
+    char payload[PAYLOAD_SIZE];
+    mqttTopicFor(topic_prefix.c_str(), watchlist[i].symbol, topic);
+    int len = snprintf(payload, sizeof(payload), "{\"p\":%.10g,\"pc\":%.10g,\"chg\":%.4f,\"open\":%d,\"cur\":\"%s\",\"t\":%ld}",
+                       q.current, q.previousClose, q.percentageChange, q.marketOpen ? 1 : 0, q.currency, (long)now);
+    if (esp_mqtt_client_enqueue(client, topic, payload, len, publish_qos, 1, true) < 0) {
+      stats.dropped++;
+      continue;
+    }
+    published[i] = q;
+    published_valid[i] = true;
+    queued++;
+  }
+  if (queued > 0) {
+    stats.batches++;
+    stats.published += queued;
+    stats.enqueueUs = esp_timer_get_time() - t0;
+  }
+  return queued;
+}
+
+void mqttSetBroker(const char *uri, const char *prefix, int qos) {
+  broker_uri = uri;
+  broker_uri.trim();
+  topic_prefix = mqttCleanPrefix(prefix, "tdongle/quotes");
+  publish_qos = constrain(qos, 0, MQTT_QOS_MAX);
+  prefs.begin("mqtt", false);
+  prefs.putString("uri", broker_uri);
+  prefs.putString("prefix", topic_prefix);
+  prefs.putInt("qos", publish_qos);
+  prefs.end();
+  createClient();
+  LOG_INFO("MQTT: broker set to <%s>, prefix %s, QoS %d", broker_uri.c_str(), topic_prefix.c_str(), publish_qos);
+}
+
+String mqttBroker() {
+  return broker_uri;
+}
+
+String mqttPrefix() {
+  return topic_prefix;
+}
+
+int mqttQos() {
+  return publish_qos;
+}
+
+const mqtt_stats &mqttStats() {
+  return stats;
+}
@@ -0,0 +1,238 @@
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <mqtt_client.h>
+
+#include "log.h"
+#include "mqtt_common.h"
+#include "mqtt_source.h"
+
+// ------------------------------------------------------------------------------------
+static Preferences prefs;
+static String broker_uri;
+static String topic_prefix;
+static volatile payload_format format = PAYLOAD_JSON;
+static esp_mqtt_client_handle_t client = nullptr;
+static bool started = false;
+static volatile bool broker_up = false;     // Set from the MQTT task
+
+// Shared with the MQTT task, under lock
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static char topics[MQTT_SOURCE_MAX][MQTT_TOPIC_SIZE];
+static int topic_count = 0;
+static quote pending[MQTT_SOURCE_MAX];      // Latest quote of each symbol not yet taken
+static int64_t arrived_us[MQTT_SOURCE_MAX];
+static bool pending_set[MQTT_SOURCE_MAX];
+static mqtt_source_stats stats;
+// ------------------------------------------------------------------------------------
+
+// Index of the subscribed topic of len bytes, or -1. Call under lock.
+static int findTopic(const char *topic, int len) {
+  for (int i = 0; i < topic_count; i++) {
+    if (strncmp(topics[i], topic, len) == 0 && topics[i][len] == '\0') {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// A new message: decoded here, in the MQTT task, and left for the loop to take
+static void onData(esp_mqtt_event_handle_t event) {
+  if (event->current_data_offset != 0 || event->data_len != event->total_data_len) {
+    return;                                 // Fragmented; quotes are far smaller than the buffer
+  }
+  int64_t now = esp_timer_get_time();
+  quote q;
+  bool ok = decodeQuote(format, (const uint8_t *)event->data, event->data_len, q);
+
+  portENTER_CRITICAL(&lock);
+  int i = findTopic(event->topic, event->topic_len);
+  if (i >= 0 && ok) {
+    if (pending_set[i]) {
+      stats.overwritten++;
+    } else {
+      arrived_us[i] = now;
+    }
+    pending[i] = q;
+    pending_set[i] = true;
+    stats.received++;
+  } else if (i >= 0) {
+    stats.malformed++;
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+// Runs in the MQTT client task
+static void onEvent(void *arg, esp_event_base_t base, int32_t id, void *data) {
+  switch ((esp_mqtt_event_id_t)id) {
+    case MQTT_EVENT_CONNECTED: {
+      broker_up = true;
+      stats.connects++;
+      // A fresh session: subscribe to everything; retained messages bring the current quotes
+      char topic[MQTT_TOPIC_SIZE];
+      for (int i = 0; ; i++) {
+        portENTER_CRITICAL(&lock);
+        bool more = i < topic_count;
+        if (more) {
+          memcpy(topic, topics[i], MQTT_TOPIC_SIZE);
+        }
+        portEXIT_CRITICAL(&lock);
+        if (!more) {
+          break;
+        }
+        esp_mqtt_client_subscribe(client, topic, 0);
+      }
+      break;
+    }
+    case MQTT_EVENT_DISCONNECTED:
+      broker_up = false;
+      break;
+    case MQTT_EVENT_DATA:
+      onData((esp_mqtt_event_handle_t)data);
+      break;
+    default:
+      break;
+  }
+}
+
+static void createClient() {
+  mqttDestroyClient(client);
+  started = false;
+  broker_up = false;
+  portENTER_CRITICAL(&lock);
+  topic_count = 0;
+  memset(pending_set, 0, sizeof(pending_set));
+  portEXIT_CRITICAL(&lock);
+  if (broker_uri.length() == 0) {
+    return;
+  }
+
+  // Not the publisher's id, so both can share one broker
+  esp_mqtt_client_config_t config = {};
+  client = mqttCreateClient(config, broker_uri.c_str(), "t-dongle-src", onEvent, "MQTT source");
+}
+
+void mqttSourceBegin() {
+  prefs.begin("mqtt_src", true);
+  broker_uri = prefs.getString("uri", "");
+  topic_prefix = prefs.getString("prefix", "market/quotes");
+  format = (payload_format)constrain(prefs.getInt("format", PAYLOAD_JSON), 0, PAYLOAD_FORMATS - 1);
+  prefs.end();
+  createClient();
+  if (client != nullptr) {
+    LOG_INFO("MQTT source: quotes from %s under %s, %s payloads", broker_uri.c_str(), topic_prefix.c_str(),
+             PAYLOAD_FORMAT_NAMES[format]);
+  }
+}
+
+void mqttSourcePoll(bool connected) {
+  if (client != nullptr && connected && !started) {
+    started = esp_mqtt_client_start(client) == ESP_OK;
+  }
+}
+
+bool mqttSourceActive() {
+  return client != nullptr;
+}
+
+void mqttSourceSubscribe(const char *const *symbols, int count) {
+  if (client == nullptr) {
+    return;
+  }
+  count = min(count, MQTT_SOURCE_MAX);
+  char topic[MQTT_TOPIC_SIZE];
+  bool same = count == topic_count;
+  for (int i = 0; i < count && same; i++) {
+    mqttTopicFor(topic_prefix.c_str(), symbols[i], topic);
+    same = strcmp(topic, topics[i]) == 0;
+  }
+  if (same) {
+    return;
+  }
+
+  // Only the loop changes the list, so it can be read here without the lock
+  for (int i = 0; i < topic_count; i++) {
+    bool kept = false;
+    for (int j = 0; j < count && !kept; j++) {
+      mqttTopicFor(topic_prefix.c_str(), symbols[j], topic);
+      kept = strcmp(topic, topics[i]) == 0;
+    }
+    if (!kept && broker_up) {
+      esp_mqtt_client_unsubscribe(client, topics[i]);
+    }
+  }
+  int old_count = topic_count;
+  for (int i = 0; i < count; i++) {
+    mqttTopicFor(topic_prefix.c_str(), symbols[i], topic);
+    bool known = false;
+    for (int j = 0; j < old_count && !known; j++) {
+      known = strcmp(topic, topics[j]) == 0;
+    }
+    portENTER_CRITICAL(&lock);
+    if (strcmp(topic, topics[i]) != 0) {
+      memcpy(topics[i], topic, MQTT_TOPIC_SIZE);
+      pending_set[i] = false;
+    }
+    topic_count = max(topic_count, i + 1);
+    portEXIT_CRITICAL(&lock);
+    if (!known && broker_up) {
+      esp_mqtt_client_subscribe(client, topic, 0);
+    }
+  }
+  portENTER_CRITICAL(&lock);
+  topic_count = count;
+  portEXIT_CRITICAL(&lock);
+  LOG_INFO("MQTT source: %d topics", count);
+}
+
+int mqttSourceTake(quote *out, bool *updated, int64_t &first_us) {
+  int taken = 0;
+  first_us = 0;
+  portENTER_CRITICAL(&lock);
+  for (int i = 0; i < topic_count; i++) {
+    updated[i] = pending_set[i];
+    if (!pending_set[i]) {
+      continue;
+    }
+    out[i] = pending[i];
+    pending_set[i] = false;
+    if (taken == 0 || arrived_us[i] < first_us) {
+      first_us = arrived_us[i];
+    }
+    taken++;
+  }
+  portEXIT_CRITICAL(&lock);
+  return taken;
+}
+
+void mqttSourceSet(const char *uri, const char *prefix, payload_format fmt) {
+  broker_uri = uri;
+  broker_uri.trim();
+  topic_prefix = mqttCleanPrefix(prefix, "market/quotes");
+  format = fmt;
+  prefs.begin("mqtt_src", false);
+  prefs.putString("uri", broker_uri);
+  prefs.putString("prefix", topic_prefix);
+  prefs.putInt("format", format);
+  prefs.end();
+  createClient();
+  LOG_INFO("MQTT source set to <%s>, prefix %s, %s payloads", broker_uri.c_str(), topic_prefix.c_str(),
+           PAYLOAD_FORMAT_NAMES[format]);
+}
+
+String mqttSourceBroker() {
+  return broker_uri;
+}
+
+String mqttSourcePrefix() {
+  return topic_prefix;
+}
+
+payload_format mqttSourceFormat() {
+  return format;
+}
+
+const mqtt_source_stats &mqttSourceStats() {
+  return stats;
+}
@@ -0,0 +1,317 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "portfolio.h"
+
+#ifdef ARDUINO
+#include <Preferences.h>
+
+#include "log.h"
+#include "watchlist.h"
+#endif
+
+// ------------------------------------------------------------------------------------
+typedef struct {
+  int16_t series;
+  int16_t next;                             // Next position of the same series, -1 at the end
+  uint8_t currency;                         // Index into totals
+  bool priced;
+  int64_t value;                            // Contributions currently in the totals
+  int64_t dayPnl;
+} position_state;
+
+static position positions[PORTFOLIO_MAX];
+static position_state state[PORTFOLIO_MAX];
+static int position_count = 0;
+
+static int16_t heads[PORTFOLIO_SERIES];     // First position of each series
+static int64_t last_price[PORTFOLIO_SERIES];
+static int64_t last_close[PORTFOLIO_SERIES];
+static int8_t series_currency[PORTFOLIO_SERIES];  // Index into totals the quote reports, -1 until known
+
+static portfolio_total totals[PORTFOLIO_CURRENCIES];
+static int currency_count = 0;
+static uint32_t touched = 0;
+// ------------------------------------------------------------------------------------
+
+// a * b / PORTFOLIO_SCALE, rounded half away from zero
+static int64_t scaledProduct(int64_t a, int64_t b) {
+  int64_t p = a * b;
+  return (p >= 0 ? p + PORTFOLIO_SCALE / 2 : p - PORTFOLIO_SCALE / 2) / PORTFOLIO_SCALE;
+}
+
+static int64_t toFixed(double v) {
+  return (int64_t)llround(v * PORTFOLIO_SCALE);
+}
+
+static int currencyIndex(const char *code) {
+  for (int i = 0; i < currency_count; i++) {
+    if (strncmp(totals[i].currency, code, sizeof(totals[i].currency)) == 0) {
+      return i;
+    }
+  }
+  if (currency_count == PORTFOLIO_CURRENCIES) {
+    return -1;
+  }
+  portfolio_total &t = totals[currency_count];
+  memset(&t, 0, sizeof(t));
+  memcpy(t.currency, code, strnlen(code, sizeof(t.currency) - 1));
+  return currency_count++;
+}
+
+void portfolioClear() {
+  position_count = 0;
+  currency_count = 0;
+  touched = 0;
+  for (int i = 0; i < PORTFOLIO_SERIES; i++) {
+    heads[i] = -1;
+    last_price[i] = INT64_MIN;
+    last_close[i] = INT64_MIN;
+    series_currency[i] = -1;
+  }
+}
+
+int portfolioAdd(const position &p, int series) {
+  if (position_count == PORTFOLIO_MAX || series < 0 || series >= PORTFOLIO_SERIES) {
+    return -1;
+  }
+  int currency = series_currency[series] >= 0 ? series_currency[series] : currencyIndex(p.currency);
+  if (currency < 0) {
+    return -1;
+  }
+  int i = position_count++;
+  positions[i] = p;
+  positions[i].currency[sizeof(p.currency) - 1] = '\0';
+  state[i] = { (int16_t)series, heads[series], (uint8_t)currency, false, 0, 0 };
+  heads[series] = i;
+  totals[currency].positions++;
+
+  // Price it right away if the series already has a quote
+  if (last_price[series] != INT64_MIN) {
+    int64_t price = last_price[series], close = last_close[series];
+    last_price[series] = INT64_MIN;
+    portfolioUpdate(series, (double)price / PORTFOLIO_SCALE, (double)close / PORTFOLIO_SCALE);
+  }
+  return i;
+}
+
+void portfolioUpdate(int series, double current, double previous_close) {
+  if (series < 0 || series >= PORTFOLIO_SERIES) {
+    return;
+  }
+  int64_t price = toFixed(current), close = toFixed(previous_close);
+  if (price == last_price[series] && close == last_close[series]) {
+    return;
+  }
+  last_price[series] = price;
+  last_close[series] = close;
+
+  for (int i = heads[series]; i >= 0; i = state[i].next) {
+    position_state &s = state[i];
+    portfolio_total &t = totals[s.currency];
+    int64_t value = scaledProduct(positions[i].quantity, price);
+    int64_t day = scaledProduct(positions[i].quantity, price - close);
+    if (!s.priced) {
+      s.priced = true;
+      t.priced++;
+      t.cost += scaledProduct(positions[i].quantity, positions[i].cost);
+    }
+    t.value += value - s.value;
+    t.dayPnl += day - s.dayPnl;
+    s.value = value;
+    s.dayPnl = day;
+    touched++;
+  }
+}
+
+int portfolioSetCurrency(int series, const char *code) {
+  if (series < 0 || series >= PORTFOLIO_SERIES || code[0] == '\0') {
+    return 0;
+  }
+  int known = series_currency[series];
+  if (known >= 0 && strncmp(totals[known].currency, code, sizeof(totals[known].currency)) == 0) {
+    return 0;
+  }
+  int currency = currencyIndex(code);
+  if (currency < 0) {
+    return 0;                               // No room for another currency, keep the declared ones
+  }
+  series_currency[series] = currency;
+
+  // Move each position's contributions over to the totals of the quoted currency
+  int moved = 0;
+  for (int i = heads[series]; i >= 0; i = state[i].next) {
+    position_state &s = state[i];
+    if (s.currency == currency) {
+      continue;
+    }
+    portfolio_total &from = totals[s.currency], &to = totals[currency];
+    from.positions--;
+    to.positions++;
+    if (s.priced) {
+      int64_t cost = scaledProduct(positions[i].quantity, positions[i].cost);
+      from.priced--;
+      to.priced++;
+      from.cost -= cost;
+      to.cost += cost;
+      from.value -= s.value;
+      to.value += s.value;
+      from.dayPnl -= s.dayPnl;
+      to.dayPnl += s.dayPnl;
+    }
+    s.currency = currency;
+    moved++;
+  }
+  return moved;
+}
+
+int portfolioCount() {
+  return position_count;
+}
+
+const position &portfolioPosition(int index) {
+  return positions[index];
+}
+
+int portfolioCurrencies() {
+  return currency_count;
+}
+
+const portfolio_total &portfolioTotal(int index) {
+  return totals[index];
+}
+
+uint32_t portfolioTouched() {
+  return touched;
+}
+
+#ifdef ARDUINO
+// ------------------------------------------------------------------------------------
+// Storage, on the device only
+
+const double AMOUNT_MAX = 1e9;               // Quantities and costs beyond this would not fit the fixed point
+
+static Preferences prefs;
+static position saved[PORTFOLIO_MAX];       // As loaded or set, before binding
+static int saved_count = 0;
+
+// Cut a watchlist label ("AAPL:Apple") off symbol, which positions do not carry
+static void stripLabel(char *symbol) {
+  char *colon = strchr(symbol, ':');
+  if (colon != nullptr) {
+    *colon = '\0';
+  }
+}
+
+void portfolioBind() {
+  portfolioClear();
+  for (int i = 0; i < saved_count; i++) {
+    int series = watchlistFind(saved[i].symbol);
+    if (series < 0) {
+      series = watchlistAdd(saved[i].symbol);
+    }
+    if (series < 0 || portfolioAdd(saved[i], series) < 0) {
+      LOG_WARN("Portfolio: no room for %s.", saved[i].symbol);
+    }
+  }
+}
+
+void portfolioBegin() {
+  portfolioClear();
+  prefs.begin("portfolio", true);
+  size_t len = prefs.getBytesLength("positions");
+  if (len > 0 && len <= sizeof(saved) && len % sizeof(position) == 0) {
+    prefs.getBytes("positions", saved, len);
+    saved_count = len / sizeof(position);
+  }
+  prefs.end();
+  for (int i = 0; i < saved_count; i++) {
+    stripLabel(saved[i].symbol);            // Saved before labels were refused
+  }
+  portfolioBind();
+  LOG_INFO("Portfolio: %d positions.", saved_count);
+}
+
+bool portfolioSet(const char *text) {
+  static position parsed[PORTFOLIO_MAX];
+  int count = 0;
+  const char *p = text;
+  while (*p) {
+    const char *end = strchr(p, ',');
+    size_t len = end != nullptr ? end - p : strlen(p);
+    char entry[64];
+    if (len >= sizeof(entry)) {
+      return false;
+    }
+    memcpy(entry, p, len);
+    entry[len] = '\0';
+    p += len + (end != nullptr ? 1 : 0);
+
+    char symbol[16], currency[4] = "USD";
+    double quantity, cost;
+    int fields = sscanf(entry, " %15s %lf %lf %3s", symbol, &quantity, &cost, currency);
+    if (fields <= 0) {
+      continue;                             // Empty entry
+    }
+    if (fields < 3 || count == PORTFOLIO_MAX || !isfinite(quantity) || !isfinite(cost) ||
+        fabs(quantity) >= AMOUNT_MAX || cost < 0.0 || cost >= AMOUNT_MAX) {
+      return false;
+    }
+    stripLabel(symbol);
+    if (symbol[0] == '\0') {
+      return false;
+    }
+    position &pos = parsed[count++];
+    memset(&pos, 0, sizeof(pos));
+    for (int i = 0; symbol[i]; i++) {
+      pos.symbol[i] = toupper(symbol[i]);
+    }
+    for (int i = 0; currency[i]; i++) {
+      pos.currency[i] = toupper(currency[i]);
+    }
+    pos.quantity = toFixed(quantity);
+    pos.cost = toFixed(cost);
+  }
+
+  memcpy(saved, parsed, count * sizeof(position));
+  saved_count = count;
+  prefs.begin("portfolio", false);
+  if (count > 0) {
+    prefs.putBytes("positions", saved, count * sizeof(position));
+  } else {
+    prefs.remove("positions");
+  }
+  prefs.end();
+  portfolioBind();
+  LOG_INFO("Portfolio: %d positions saved.", count);
+  return true;
+}
+
+// Exact decimal form of a fixed point number, without trailing zeros
+static String fixedText(int64_t v) {
+  char buf[32];
+  uint64_t a = v < 0 ? -(uint64_t)v : v;
+  int len = snprintf(buf, sizeof(buf), "%s%llu.%04llu", v < 0 ? "-" : "", (unsigned long long)(a / PORTFOLIO_SCALE),
+                     (unsigned long long)(a % PORTFOLIO_SCALE));
+  while (buf[len - 1] == '0') {
+    buf[--len] = '\0';
+  }
+  if (buf[len - 1] == '.') {
+    buf[--len] = '\0';
+  }
+  return String(buf);
+}
+
+String portfolioText() {
+  String text;
+  for (int i = 0; i < saved_count; i++) {
+    if (i > 0) {
+      text += ',';
+    }
+    text += String(saved[i].symbol) + " " + fixedText(saved[i].quantity) + " " + fixedText(saved[i].cost) + " " +
+            saved[i].currency;
+  }
+  return text;
+}
+#endif
@@ -0,0 +1,119 @@
+
+#include <Arduino.h>
+
+#include "display.h"
+#include "fx.h"
+#include "portfolio.h"
+#include "portfolio_page.h"
+
+// ------------------------------------------------------------------------------------
+const int ROW_FONT = 4;
+const int DETAIL_FONT = 2;
+// ------------------------------------------------------------------------------------
+
+// Fixed point amount with thousands separators and two decimals, e.g. "+12,345.67"
+static void formatMoney(int64_t v, bool sign, char *buf, size_t size) {
+  int64_t cents = (v >= 0 ? v + PORTFOLIO_SCALE / 200 : v - PORTFOLIO_SCALE / 200) / (PORTFOLIO_SCALE / 100);
+  uint64_t a = cents < 0 ? -(uint64_t)cents : cents;
+  char digits[24];
+  int n = snprintf(digits, sizeof(digits), "%llu", (unsigned long long)(a / 100));
+
+  size_t o = 0;
+  if (cents < 0) {
+    buf[o++] = '-';
+  } else if (sign) {
+    buf[o++] = '+';
+  }
+  for (int i = 0; i < n && o < size - 4; i++) {
+    if (i > 0 && (n - i) % 3 == 0) {
+      buf[o++] = ',';
+    }
+    buf[o++] = digits[i];
+  }
+  snprintf(buf + o, size - o, ".%02u", (unsigned)(a % 100));
+}
+
+static uint16_t pnlColour(int64_t v) {
+  return v > 0 ? TFT_GREEN : v < 0 ? TFT_RED : TFT_WHITE;
+}
+
+static void drawRow(const char *label, int64_t amount, bool sign, uint16_t colour, int y, int font) {
+  char buf[32];
+  formatMoney(amount, sign, buf, sizeof(buf));
+  int bottom = y + tft.fontHeight(font);
+  if (tft.textWidth(label, DETAIL_FONT) + tft.textWidth(buf, font) + 4 > TFT_HEIGHT) {
+    font = DETAIL_FONT;                     // Large amounts do not fit in the big font
+  }
+  tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  tft.setTextDatum(BL_DATUM);
+  tft.drawString(label, 0, bottom, DETAIL_FONT);
+  tft.setTextColor(colour, TFT_BLACK);
+  tft.setTextDatum(BR_DATUM);
+  tft.drawString(buf, TFT_HEIGHT, bottom, font);
+}
+
+// Amount converted to the base currency, in fixed point
+static int64_t toBase(int64_t amount, double rate) {
+  return (int64_t)llround(amount * rate);
+}
+
+bool drawPortfolioPage() {
+  if (portfolioCount() == 0 || portfolioCurrencies() == 0) {
+    return false;
+  }
+
+  // Totals of every currency with a known rate, in the base currency. Costs are converted at
+  // today's rate too, so the total P&L is the one of the holdings, without the FX move since purchase.
+  // Currencies still waiting for their rate are listed under the totals, in their own currency.
+  int64_t value = 0, cost = 0, day = 0;
+  int priced = 0, unpriced = 0;
+  for (int i = 0; i < portfolioCurrencies(); i++) {
+    const portfolio_total &t = portfolioTotal(i);
+    double rate = fxRate(fxCurrency(t.currency), 0);
+    if (rate > 0.0) {
+      value += toBase(t.value, rate);
+      cost += toBase(t.cost, rate);
+      day += toBase(t.dayPnl, rate);
+      priced += t.priced;
+    } else if (t.positions > 0) {
+      unpriced++;
+    }
+  }
+
+  // Title and three rows, the total P&L large: 16 + 16 + 26 + 16 pixels. With currencies to
+  // list the total goes small too, which leaves a line for them.
+  tft.fillScreen(TFT_BLACK);
+  char title[40];
+  snprintf(title, sizeof(title), "Portfolio %s %d/%d", fxBase(), priced, portfolioCount());
+  tft.setTextColor(TFT_DARKGREY, TFT_BLACK);
+  tft.setTextDatum(TL_DATUM);
+  tft.drawString(title, 0, 0, DETAIL_FONT);
+  int y = tft.fontHeight(DETAIL_FONT);
+  int total_font = unpriced > 0 ? DETAIL_FONT : ROW_FONT;
+  drawRow("Day", day, true, pnlColour(day), y, DETAIL_FONT);
+  y += tft.fontHeight(DETAIL_FONT);
+  drawRow("Total", value - cost, true, pnlColour(value - cost), y, total_font);
+  y += tft.fontHeight(total_font);
+  drawRow("Value", value, false, TFT_WHITE, y, DETAIL_FONT);
+  y += tft.fontHeight(DETAIL_FONT);
+
+  // One line for each currency still waiting for its rate, as many as fit: day and total P&L
+  for (int i = 0; i < portfolioCurrencies() && y + tft.fontHeight(DETAIL_FONT) <= TFT_WIDTH; i++) {
+    const portfolio_total &o = portfolioTotal(i);
+    if (o.positions == 0 || fxRate(fxCurrency(o.currency), 0) > 0.0) {
+      continue;
+    }
+    char day_text[24], total_text[24], line[40];
+    formatMoney(o.dayPnl, true, day_text, sizeof(day_text));
+    formatMoney(o.value - o.cost, true, total_text, sizeof(total_text));
+    snprintf(line, sizeof(line), "%s %s", o.currency, day_text);
+    tft.setTextColor(pnlColour(o.dayPnl), TFT_BLACK);
+    tft.setTextDatum(TL_DATUM);
+    tft.drawString(line, 0, y, DETAIL_FONT);
+    tft.setTextColor(pnlColour(o.value - o.cost), TFT_BLACK);
+    tft.setTextDatum(TR_DATUM);
+    tft.drawString(total_text, TFT_HEIGHT, y, DETAIL_FONT);
+    y += tft.fontHeight(DETAIL_FONT);
+  }
+  return true;
+}
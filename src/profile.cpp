@@ -0,0 +1,47 @@
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include "profile.h"
+
+// ------------------------------------------------------------------------------------
+stage_stats stage_totals[STAGE_COUNT];
+const char *STAGE_NAMES[STAGE_COUNT] = { "network", "fetch", "parse", "update", "render" };
+static volatile uint32_t allocations = 0;
+// ------------------------------------------------------------------------------------
+
+// Link-time wrappers, enabled by -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+  return __real_realloc(ptr, size);
+}
+}
+
+uint32_t profileAllocations() {
+  return allocations;
+}
+
+StageTimer::StageTimer(stage s) : _stage(s), _started(esp_timer_get_time()), _allocs(allocations) {
+}
+
+StageTimer::~StageTimer() {
+  stage_stats &st = stage_totals[_stage];
+  st.calls++;
+  st.us += esp_timer_get_time() - _started;
+  st.allocs += allocations - _allocs;
+}
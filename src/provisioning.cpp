@@ -0,0 +1,438 @@
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WebServer.h>
+#include <DNSServer.h>
+#include <esp_wifi.h>
+
+#include "crash_report.h"
+#include "fx.h"
+#include "log.h"
+#include "metrics.h"
+#include "mqtt_publish.h"
+#include "mqtt_source.h"
+#include "portfolio.h"
+#include "provisioning.h"
+#include "vclock.h"
+#include "watchlist.h"
+#include "wifi_power.h"
+#include "wifi_store.h"
+
+// ------------------------------------------------------------------------------------
+const char *PORTAL_AP_NAME = "T-Dongle-S3";
+const unsigned long ATTEMPT_TIMEOUT = 10000;    // Time allowed to associate with one candidate AP
+const unsigned long PORTAL_TIMEOUT = 180000;    // Close an unused portal and retry the saved networks
+const unsigned long LINK_LOST_TIMEOUT = 30000;  // Let the driver auto-reconnect for this long first
+const byte DNS_PORT = 53;
+
+// Roaming: when the averaged RSSI stays below ROAM_RSSI, look for a saved AP that is at least
+// ROAM_HYSTERESIS dB better and move to it. Scans are rate limited to one per ROAM_SCAN_INTERVAL.
+const unsigned long ROAM_SAMPLE_INTERVAL = 2000;
+const unsigned long ROAM_SCAN_INTERVAL = 60000;
+const int ROAM_RSSI = -72;
+const int ROAM_HYSTERESIS = 8;
+
+const int MAX_CANDIDATES = 8;
+
+// An access point we can try, from the last scan
+typedef struct {
+  int net;                                      // Index into nets[]
+  int32_t rssi;
+  int32_t channel;
+  uint8_t bssid[6];
+} candidate;
+
+static prov_state state = PROV_CONNECTING;
+static unsigned long state_since;               // clockMillis() when we entered the current state
+static unsigned long link_lost_since;           // clockMillis() when the link dropped while CONNECTED, 0 if up
+static WebServer server(80);
+static DNSServer dns;
+
+static wifi_network nets[WIFI_MAX_NETWORKS];
+static int net_count;
+static candidate candidates[MAX_CANDIDATES];    // Strongest first
+static int candidate_count;
+static int next_candidate;
+static bool scanning;                           // An async scan is in progress
+static wifi_network pending;                    // Entered in the portal, saved once it has associated
+static unsigned long attempt_since;             // clockMillis() when the current association attempt started
+
+static float rssi_avg;                          // Exponentially averaged RSSI of the current link
+static unsigned long rssi_sampled;
+static unsigned long roam_scanned;
+// ------------------------------------------------------------------------------------
+
+static void enterState(prov_state s) {
+  state = s;
+  state_since = clockMillis();
+  crashTrace(TRACE_WIFI, s);
+}
+
+// Collect the saved networks seen by the last scan, strongest first. Frees the scan results and
+// lets the radio go back to modem sleep.
+static void collectCandidates() {
+  candidate_count = 0;
+  next_candidate = 0;
+  int found = WiFi.scanComplete();
+
+  for (int i = 0; i < found; i++) {
+    String ssid = WiFi.SSID(i);
+    const wifi_network *net = wifiStoreFind(nets, net_count, ssid.c_str());
+    if (net == nullptr) {
+      continue;
+    }
+    candidate c;
+    c.net = net - nets;
+    c.rssi = WiFi.RSSI(i);
+    c.channel = WiFi.channel(i);
+    memcpy(c.bssid, WiFi.BSSID(i), sizeof(c.bssid));
+
+    // Insertion sort, dropping the weakest when full
+    int pos;
+    if (candidate_count < MAX_CANDIDATES) {
+      pos = candidate_count++;
+    } else if (c.rssi > candidates[MAX_CANDIDATES - 1].rssi) {
+      pos = MAX_CANDIDATES - 1;
+    } else {
+      continue;
+    }
+    while (pos > 0 && candidates[pos - 1].rssi < c.rssi) {
+      candidates[pos] = candidates[pos - 1];
+      pos--;
+    }
+    candidates[pos] = c;
+  }
+  WiFi.scanDelete();
+  wifiPowerHold(false);
+}
+
+// The link came up: save the credentials entered in the portal if they are what it came up with,
+// and start tracking its quality
+static void linkUp() {
+  if (pending.ssid[0] != '\0' && WiFi.SSID() == pending.ssid) {
+    wifiStoreAdd(pending.ssid, pending.pass);
+    net_count = wifiStoreLoad(nets);
+    LOG_INFO("Credentials for <%s> saved.", pending.ssid);
+  }
+  memset(&pending, 0, sizeof(pending));
+  rssi_avg = WiFi.RSSI();
+  rssi_sampled = clockMillis();
+  enterState(PROV_CONNECTED);
+}
+
+// Configure the station without connecting, so the power settings are in place before associating
+static void associate(const char *ssid, const char *pass, int32_t channel = 0, const uint8_t *bssid = nullptr) {
+  WiFi.begin(ssid, pass, channel, bssid, false);
+  wifiPowerConfigure();
+  esp_wifi_connect();
+}
+
+// Start an association with a specific AP. Returns immediately.
+static void connectCandidate(const candidate &c) {
+  LOG_INFO("Connecting to wifi <%s> on channel %d (%d dBm)...", nets[c.net].ssid, (int)c.channel, (int)c.rssi);
+  associate(nets[c.net].ssid, nets[c.net].pass, c.channel, c.bssid);
+  attempt_since = clockMillis();
+}
+
+// Start over: reload the saved networks and scan for them in the background
+static void connectSaved() {
+  net_count = wifiStoreLoad(nets);
+  candidate_count = 0;
+  next_candidate = 0;
+  attempt_since = 0;
+  enterState(PROV_CONNECTING);
+
+  if (net_count == 0) {
+    // Credentials left in the Wi-Fi driver's own storage by earlier firmware versions
+    LOG_INFO("Connecting to wifi...");
+    WiFi.begin();
+    attempt_since = clockMillis();
+    return;
+  }
+  LOG_INFO("Scanning for %d saved wifi networks...", net_count);
+  WiFi.scanNetworks(true);
+  scanning = true;
+}
+
+// ------------------------------------------------------------------------------------
+// Captive portal
+
+// text with &<>'" escaped, safe in element content and in quoted attribute values
+static String htmlEscape(const String &text) {
+  String out;
+  out.reserve(text.length());
+  for (size_t i = 0; i < text.length(); i++) {
+    char c = text[i];
+    switch (c) {
+      case '&':
+        out += "&amp;";
+        break;
+      case '<':
+        out += "&lt;";
+        break;
+      case '>':
+        out += "&gt;";
+        break;
+      case '\'':
+        out += "&#39;";
+        break;
+      case '"':
+        out += "&quot;";
+        break;
+      default:
+        out += c;
+        break;
+    }
+  }
+  return out;
+}
+
+static void handleRoot() {
+  String page =
+    "<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width'>"
+    "<title>T-Dongle-S3</title></head><body><h2>T-Dongle-S3 Wi-Fi setup</h2>";
+  if (net_count > 0) {
+    page += "<p>Saved networks:";
+    for (int i = 0; i < net_count; i++) {
+      page += String(i == 0 ? " " : ", ") + htmlEscape(nets[i].ssid);
+    }
+    page += "</p>";
+  }
+  page +=
+    "<form method='POST' action='/save'>"
+    "SSID<br><input name='ssid' maxlength='32'><br>"
+    "Password<br><input name='pass' type='password' maxlength='64'><br>"
+    "Crash report collector URL (optional)<br><input name='collector' maxlength='128'><br>"
+    "Watchlist, comma separated SYMBOL or SYMBOL:LABEL<br><input name='watchlist' size='40' value='";
+  page += htmlEscape(watchlistText());
+  page +=
+    "'><br>"
+    "Positions, comma separated SYMBOL QUANTITY COST [CURRENCY]<br><input name='positions' size='40' value='";
+  page += htmlEscape(portfolioText());
+  page +=
+    "'><br>"
+    "Base currency<br><input name='base' maxlength='3' size='4' value='";
+  page += htmlEscape(fxBase());
+  page +=
+    "'><br>"
+    "MQTT broker (optional), e.g. mqtt://192.168.1.10:1883<br><input name='mqtt' maxlength='128' value='";
+  page += htmlEscape(mqttBroker());
+  page +=
+    "'><br>"
+    "MQTT topic prefix<br><input name='prefix' maxlength='40' value='";
+  page += htmlEscape(mqttPrefix());
+  page +=
+    "'> QoS <input name='qos' type='number' min='0' max='1' size='2' value='";
+  page += mqttQos();
+  page +=
+    "'><br>"
+    "MQTT quote source (optional, replaces Yahoo)<br><input name='src' maxlength='128' value='";
+  page += htmlEscape(mqttSourceBroker());
+  page +=
+    "'><br>"
+    "Source topic prefix<br><input name='srcprefix' maxlength='40' value='";
+  page += htmlEscape(mqttSourcePrefix());
+  page += "'> <select name='srcformat'>";
+  for (int i = 0; i < PAYLOAD_FORMATS; i++) {
+    page += String("<option") + (i == mqttSourceFormat() ? " selected>" : ">") + PAYLOAD_FORMAT_NAMES[i] + "</option>";
+  }
+  page +=
+    "</select><br><br>"
+    "<input type='submit' value='Save'></form></body></html>";
+  server.send(200, "text/html", page);
+}
+
+static void handleSave() {
+  String ssid = server.arg("ssid");
+  String pass = server.arg("pass");
+  if (ssid.length() == 0) {
+    server.send(400, "text/plain", "SSID is required");
+    return;
+  }
+
+  // Only kept here until the association succeeds, so a typo never reaches the saved networks
+  snprintf(pending.ssid, sizeof(pending.ssid), "%s", ssid.c_str());
+  snprintf(pending.pass, sizeof(pending.pass), "%s", pass.c_str());
+  if (server.arg("collector").length() > 0) {
+    crashReportSetCollector(server.arg("collector").c_str());
+  }
+  if (server.arg("watchlist").length() > 0 && server.arg("watchlist") != watchlistText()) {
+    watchlistSet(server.arg("watchlist").c_str());
+  }
+  if (server.arg("base").length() == 3 && !server.arg("base").equalsIgnoreCase(fxBase())) {
+    fxSetBase(server.arg("base").c_str());
+  }
+  if (server.arg("positions") != portfolioText() && !portfolioSet(server.arg("positions").c_str())) {
+    LOG_WARN("Portal: positions not understood, kept the old ones.");
+  }
+  if (server.hasArg("mqtt") && (server.arg("mqtt") != mqttBroker() || server.arg("prefix") != mqttPrefix() ||
+                                server.arg("qos").toInt() != mqttQos())) {
+    mqttSetBroker(server.arg("mqtt").c_str(), server.arg("prefix").c_str(), server.arg("qos").toInt());
+  }
+  if (server.hasArg("src")) {
+    payload_format format = server.arg("srcformat") == PAYLOAD_FORMAT_NAMES[PAYLOAD_BINARY] ? PAYLOAD_BINARY : PAYLOAD_JSON;
+    if (server.arg("src") != mqttSourceBroker() || server.arg("srcprefix") != mqttSourcePrefix() ||
+        format != mqttSourceFormat()) {
+      mqttSourceSet(server.arg("src").c_str(), server.arg("srcprefix").c_str(), format);
+    }
+  }
+
+  server.send(200, "text/html", "<html><body>Connecting... The network is saved once it works.</body></html>");
+  LOG_INFO("Portal: trying the credentials for <%s>.", ssid);
+
+  // Keep the portal up while we try, so the user can correct a typo
+  associate(ssid.c_str(), pass.c_str());
+  state_since = clockMillis();
+}
+
+// Send every unknown URL to the form, which is what makes phones pop up the portal
+static void handleNotFound() {
+  server.sendHeader("Location", "http://" + WiFi.softAPIP().toString() + "/", true);
+  server.send(302, "text/plain", "");
+}
+
+static void startPortal() {
+  LOG_WARN("Failed to connect to wifi. Starting portal <%s>.", PORTAL_AP_NAME);
+  WiFi.mode(WIFI_AP_STA);
+  WiFi.softAP(PORTAL_AP_NAME);
+  dns.start(DNS_PORT, "*", WiFi.softAPIP());
+  server.begin();
+  enterState(PROV_PORTAL);
+}
+
+static void stopPortal() {
+  server.stop();
+  dns.stop();
+  WiFi.softAPdisconnect(true);
+  WiFi.mode(WIFI_STA);
+}
+
+// ------------------------------------------------------------------------------------
+
+// While connecting: wait for the scan, then walk the candidates strongest first
+static void pollConnecting(bool up) {
+  if (up) {
+    LOG_INFO("Connected to wifi <%s> (%d dBm).", WiFi.SSID(), (int)WiFi.RSSI());
+    linkUp();
+    return;
+  }
+
+  if (scanning) {
+    int found = WiFi.scanComplete();
+    if (found == WIFI_SCAN_RUNNING) {
+      return;
+    }
+    scanning = false;
+    collectCandidates();
+    LOG_INFO("Found %d access points of saved networks.", candidate_count);
+  }
+
+  if (attempt_since != 0 && clockMillis() - attempt_since < ATTEMPT_TIMEOUT) {
+    return;
+  }
+  if (next_candidate < candidate_count) {
+    connectCandidate(candidates[next_candidate++]);
+  } else {
+    startPortal();
+  }
+}
+
+// While connected: track link quality and roam to a clearly better AP when it degrades
+static void pollRoaming() {
+  unsigned long now = clockMillis();
+
+  if (scanning) {
+    int found = WiFi.scanComplete();
+    if (found == WIFI_SCAN_RUNNING) {
+      return;
+    }
+    scanning = false;
+    collectCandidates();
+
+    if (candidate_count > 0 && memcmp(candidates[0].bssid, WiFi.BSSID(), 6) != 0 &&
+        candidates[0].rssi >= rssi_avg + ROAM_HYSTERESIS) {
+      LOG_INFO("Roaming: link at %d dBm, moving to a better access point.", (int)rssi_avg);
+      metrics.roams++;
+      next_candidate = 1;
+      connectCandidate(candidates[0]);
+      enterState(PROV_CONNECTING);
+    }
+    return;
+  }
+
+  if (now - rssi_sampled < ROAM_SAMPLE_INTERVAL) {
+    return;
+  }
+  rssi_sampled = now;
+  rssi_avg = 0.8f * rssi_avg + 0.2f * WiFi.RSSI();
+
+  if (rssi_avg < ROAM_RSSI && now - roam_scanned > ROAM_SCAN_INTERVAL) {
+    LOG_INFO("Roaming: link at %d dBm, scanning for better access points.", (int)rssi_avg);
+    roam_scanned = now;
+    net_count = wifiStoreLoad(nets);
+    wifiPowerHold(true);                    // A scan in modem sleep misses most beacons
+    WiFi.scanNetworks(true);
+    scanning = true;
+  }
+}
+
+void provisioningBegin() {
+  server.on("/", HTTP_GET, handleRoot);
+  server.on("/save", HTTP_POST, handleSave);
+  server.onNotFound(handleNotFound);
+
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
+  connectSaved();
+}
+
+void provisioningPoll() {
+  unsigned long now = clockMillis();
+  bool up = WiFi.status() == WL_CONNECTED;
+
+  switch (state) {
+    case PROV_CONNECTING:
+      pollConnecting(up);
+      break;
+
+    case PROV_CONNECTED:
+      if (up) {
+        link_lost_since = 0;
+        pollRoaming();
+      } else if (link_lost_since == 0) {
+        LOG_WARN("Wifi link lost.");
+        link_lost_since = now;
+      } else if (now - link_lost_since > LINK_LOST_TIMEOUT) {
+        link_lost_since = 0;
+        connectSaved();
+      }
+      break;
+
+    case PROV_PORTAL:
+      dns.processNextRequest();
+      server.handleClient();
+      if (up) {
+        LOG_INFO("Connected to wifi <%s>. Closing portal.", WiFi.SSID());
+        stopPortal();
+        linkUp();
+      } else if (now - state_since > PORTAL_TIMEOUT) {
+        LOG_INFO("Portal timed out. Retrying saved networks.");
+        stopPortal();
+        connectSaved();
+      }
+      break;
+  }
+}
+
+void provisioningRestart() {
+  LOG_WARN("Restarting wifi.");
+  if (state == PROV_PORTAL) {
+    stopPortal();
+  }
+  WiFi.disconnect();
+  connectSaved();
+}
+
+prov_state provisioningState() {
+  return state;
+}
@@ -0,0 +1,69 @@
+
+#include <math.h>
+#include <string.h>
+#include <ArduinoJson.h>
+
+#include "quote_decode.h"
+#include "quote_feed.h"
+
+// ------------------------------------------------------------------------------------
+const size_t JSON_DOC_SIZE = 256;
+const size_t JSON_MAX_PAYLOAD = 256;
+
+const char *const PAYLOAD_FORMAT_NAMES[PAYLOAD_FORMATS] = { "json", "binary" };
+// ------------------------------------------------------------------------------------
+
+static bool decodeJson(const uint8_t *data, size_t len, quote &q) {
+  if (len > JSON_MAX_PAYLOAD) {
+    return false;
+  }
+  StaticJsonDocument<JSON_DOC_SIZE> doc;
+  if (deserializeJson(doc, (const char *)data, len) != DeserializationError::Ok) {
+    return false;
+  }
+  JsonVariantConst p = doc["p"], pc = doc["pc"], chg = doc["chg"];
+  if (!p.is<double>() || !pc.is<double>()) {
+    return false;
+  }
+  double current = p.as<double>(), previousClose = pc.as<double>();
+  double change = chg.is<double>() ? chg.as<double>()
+                : previousClose != 0.0 ? (current / previousClose - 1.0) * 100.0 : 0.0;
+  if (!isfinite(current) || !isfinite(previousClose) || !isfinite(change)) {
+    return false;
+  }
+  const char *currency = doc["cur"];
+
+  q.current = current;
+  q.previousClose = previousClose;
+  q.percentageChange = change;
+  q.marketOpen = doc["open"].as<int>() != 0;
+  memset(q.currency, 0, sizeof(q.currency));
+  if (currency != nullptr && strlen(currency) < sizeof(q.currency)) {
+    strcpy(q.currency, currency);
+  }
+  return true;
+}
+
+static bool decodeBinary(const uint8_t *data, size_t len, quote &q) {
+  if (len != sizeof(feed_quote) && len != sizeof(feed_quote) + 3) {
+    return false;
+  }
+  feed_quote fq;
+  memcpy(&fq, data, sizeof(fq));
+  q.current = (double)fq.price / FEED_PRICE_SCALE;
+  q.previousClose = (double)fq.previousClose / FEED_PRICE_SCALE;
+  q.percentageChange = fq.changeBp / 100.0;
+  q.marketOpen = fq.marketOpen != 0;
+  memset(q.currency, 0, sizeof(q.currency));
+  if (len > sizeof(fq)) {
+    memcpy(q.currency, data + sizeof(fq), 3);
+  }
+  return true;
+}
+
+bool decodeQuote(payload_format format, const uint8_t *data, size_t len, quote &out) {
+  if (data == nullptr) {
+    return false;
+  }
+  return format == PAYLOAD_BINARY ? decodeBinary(data, len, out) : decodeJson(data, len, out);
+}
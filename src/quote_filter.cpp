@@ -0,0 +1,123 @@
+#include <string.h>
+#include <math.h>
+
+#include "quote_filter.h"
+
+// ------------------------------------------------------------------------------------
+typedef struct {
+  double window[FILTER_WINDOW];             // Last accepted prices, oldest overwritten first
+  int count;
+  int next;
+  double pending[FILTER_CONFIRM];           // Current run of outliers
+  int pendingCount;
+} filter_series;
+
+static filter_series series_list[FILTER_SERIES];
+static filter_stats stats;
+// ------------------------------------------------------------------------------------
+
+static void sortSmall(double *v, int n) {
+  for (int i = 1; i < n; i++) {
+    double x = v[i];
+    int j = i - 1;
+    for (; j >= 0 && v[j] > x; j--) {
+      v[j + 1] = v[j];
+    }
+    v[j + 1] = x;
+  }
+}
+
+static double median(double *v, int n) {
+  sortSmall(v, n);
+  return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static void remember(filter_series &s, double price) {
+  s.window[s.next] = price;
+  s.next = (s.next + 1) % FILTER_WINDOW;
+  if (s.count < FILTER_WINDOW) {
+    s.count++;
+  }
+}
+
+// Is price an outlier against the recent window? Needs a few samples to say.
+static bool isSpike(const filter_series &s, double price) {
+  if (s.count < FILTER_CONFIRM) {
+    return false;
+  }
+  double v[FILTER_WINDOW];
+  memcpy(v, s.window, s.count * sizeof(double));
+  double med = median(v, s.count);
+  for (int i = 0; i < s.count; i++) {
+    v[i] = fabs(v[i] - med);
+  }
+  double mad = fmax(median(v, s.count), med * FILTER_MAD_FLOOR);
+  return fabs(price - med) > FILTER_MAD_K * mad;
+}
+
+// A run of outliers close to each other is a level shift, not a bad print
+static bool confirmsShift(filter_series &s, double price) {
+  if (s.pendingCount > 0 && fabs(price - s.pending[s.pendingCount - 1]) > price * FILTER_MAD_K * FILTER_MAD_FLOOR) {
+    s.pendingCount = 0;
+  }
+  s.pending[s.pendingCount++] = price;
+  if (s.pendingCount < FILTER_CONFIRM) {
+    return false;
+  }
+  // Start the window over at the new level
+  s.count = 0;
+  s.next = 0;
+  for (int i = 0; i < s.pendingCount; i++) {
+    remember(s, s.pending[i]);
+  }
+  s.pendingCount = 0;
+  return true;
+}
+
+filter_result quoteFilter(int series, quote &q) {
+  filter_result result = FILTER_OK;
+  if (!isfinite(q.current) || q.current <= 0.0 || !isfinite(q.previousClose) || q.previousClose <= 0.0) {
+    result = FILTER_INVALID;
+  } else if (fabs(q.current / q.previousClose - 1.0) > FILTER_MAX_DAY_MOVE) {
+    result = FILTER_BOUNDS;
+  } else if (series >= 0 && series < FILTER_SERIES) {
+    filter_series &s = series_list[series];
+    if (isSpike(s, q.current)) {
+      if (confirmsShift(s, q.current)) {
+        stats.levelShifts++;
+      } else {
+        result = FILTER_SPIKE;
+      }
+    } else {
+      s.pendingCount = 0;
+      remember(s, q.current);
+    }
+  }
+
+  if (result != FILTER_OK) {
+    stats.rejected[result]++;
+    return result;
+  }
+  if (!isfinite(q.percentageChange)) {
+    q.percentageChange = (q.current / q.previousClose - 1.0) * 100.0;
+  }
+  stats.accepted++;
+  return FILTER_OK;
+}
+
+void quoteFilterReset() {
+  memset(series_list, 0, sizeof(series_list));
+}
+
+filter_stats quoteFilterStats() {
+  return stats;
+}
+
+const char *filterResultName(filter_result result) {
+  switch (result) {
+    case FILTER_OK: return "ok";
+    case FILTER_INVALID: return "invalid";
+    case FILTER_BOUNDS: return "out of bounds";
+    default: return "spike";
+  }
+}
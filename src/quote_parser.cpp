@@ -0,0 +1,140 @@
+
+#include <string.h>
+#include <math.h>
+#include <ArduinoJson.h>
+
+#include "quote_parser.h"
+
+// ------------------------------------------------------------------------------------
+
+// Only these fields of each result are kept in the document
+static void buildFilter(StaticJsonDocument<512> &filter) {
+  JsonObject item = filter["quoteResponse"]["result"].createNestedObject();
+  item["symbol"] = true;
+  item["regularMarketPrice"] = true;
+  item["regularMarketPreviousClose"] = true;
+  item["regularMarketChangePercent"] = true;
+  item["marketState"] = true;
+  item["currency"] = true;
+  item["fiftyTwoWeekHigh"] = true;
+  item["fiftyTwoWeekLow"] = true;
+  item["exchangeTimezoneShortName"] = true;
+  item["gmtOffSetMilliseconds"] = true;
+}
+
+// Read a finite number, refusing nulls, strings and the like
+static bool readNumber(JsonVariantConst v, double &out) {
+  if (!v.is<double>()) {
+    return false;
+  }
+  out = v.as<double>();
+  return isfinite(out);
+}
+
+// Copy a string field into a fixed buffer, empty when missing or too long
+static void readText(JsonVariantConst v, char *out, size_t size) {
+  const char *text = v;
+  memset(out, 0, size);
+  if (text != nullptr && strlen(text) < size) {
+    strcpy(out, text);
+  }
+}
+
+// Fill q from one result. Nothing is written unless the whole result is valid.
+static bool readQuote(JsonObjectConst item, quote &q) {
+  double current, previousClose, change;
+  if (!readNumber(item["regularMarketPrice"], current)) {
+    return false;
+  }
+  if (!readNumber(item["regularMarketPreviousClose"], previousClose)) {
+    previousClose = NAN;
+  }
+  if (!readNumber(item["regularMarketChangePercent"], change)) {
+    change = previousClose != 0.0 ? (current / previousClose - 1.0) * 100.0 : 0.0;   // NAN without a close
+    if (isinf(change)) {
+      change = 0.0;                         // A close too close to zero to divide by
+    }
+  }
+  const char *state = item["marketState"];
+
+  q.current = current;
+  q.previousClose = previousClose;
+  q.percentageChange = change;
+  q.marketOpen = state != nullptr && strcmp(state, "REGULAR") == 0;
+  readText(item["currency"], q.currency, sizeof(q.currency));
+  return true;
+}
+
+// Reference data of a result readQuote() accepted
+static void readReference(JsonObjectConst item, reference &r) {
+  double offset;
+  if (!readNumber(item["regularMarketPreviousClose"], r.previousClose)) {
+    r.previousClose = NAN;
+  }
+  if (!readNumber(item["fiftyTwoWeekHigh"], r.yearHigh) || !readNumber(item["fiftyTwoWeekLow"], r.yearLow) ||
+      r.yearLow > r.yearHigh) {
+    r.yearHigh = r.yearLow = NAN;
+  }
+  readText(item["currency"], r.currency, sizeof(r.currency));
+  readText(item["exchangeTimezoneShortName"], r.timezone, sizeof(r.timezone));
+  r.gmtOffset = readNumber(item["gmtOffSetMilliseconds"], offset) ? (int32_t)(offset / 1000) : 0;
+}
+
+parse_status parseQuotes(const char *payload, size_t len, const char *const *symbols, int count,
+                         quote *out, bool *updated, reference *refs) {
+  for (int i = 0; i < count; i++) {
+    updated[i] = false;
+  }
+  if (payload == nullptr || len == 0 || len > PARSE_MAX_PAYLOAD) {
+    return PARSE_BAD_JSON;
+  }
+
+  StaticJsonDocument<512> filter;
+  buildFilter(filter);
+  DynamicJsonDocument doc(PARSE_DOC_BASE + PARSE_DOC_PER_QUOTE * count);
+  DeserializationError error = deserializeJson(doc, payload, len,
+                                               DeserializationOption::Filter(filter),
+                                               DeserializationOption::NestingLimit(8));
+  if (error) {
+    return PARSE_BAD_JSON;
+  }
+
+  JsonArrayConst results = doc["quoteResponse"]["result"];
+  if (results.isNull()) {
+    return PARSE_NO_RESULT;
+  }
+
+  int found = 0;
+  for (JsonObjectConst item : results) {
+    const char *symbol = item["symbol"];
+    if (symbol == nullptr) {
+      continue;
+    }
+    for (int i = 0; i < count; i++) {
+      if (!updated[i] && strcmp(symbol, symbols[i]) == 0) {
+        if (readQuote(item, out[i])) {
+          if (refs != nullptr) {
+            readReference(item, refs[i]);
+          }
+          updated[i] = true;
+          found++;
+        }
+        break;
+      }
+    }
+  }
+
+  if (found == 0) {
+    return PARSE_NO_RESULT;
+  }
+  return found == count ? PARSE_OK : PARSE_PARTIAL;
+}
+
+const char *parseStatusName(parse_status status) {
+  switch (status) {
+    case PARSE_OK: return "ok";
+    case PARSE_PARTIAL: return "partial";
+    case PARSE_NO_RESULT: return "no result";
+    default: return "bad json";
+  }
+}
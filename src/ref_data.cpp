@@ -0,0 +1,148 @@
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "log.h"
+#include "ref_data.h"
+#include "watchlist.h"
+
+// ------------------------------------------------------------------------------------
+typedef struct {
+  char symbol[16];
+  reference ref;
+  int64_t fetched;                          // Epoch s, as saved
+  bool valid;
+  bool suspect;                             // Close disagreed with the live change
+} ref_entry;
+
+static_assert(sizeof(ref_entry::symbol) == sizeof(watch_entry::symbol), "symbols are copied whole");
+
+static Preferences prefs;
+static ref_entry entries[WATCHLIST_MAX];    // In watchlist order
+static ref_entry scratch[WATCHLIST_MAX];
+static int entry_count = 0;
+static bool dirty = false;
+// ------------------------------------------------------------------------------------
+
+// Exchange day of t for entry e; days start at REF_DAY_START exchange time
+static int64_t exchangeDay(const ref_entry &e, int64_t t) {
+  return (t + e.ref.gmtOffset - REF_DAY_START) / 86400;
+}
+
+void refBegin() {
+  prefs.begin("refdata", true);
+  size_t len = prefs.getBytesLength("entries");
+  if (len > 0 && len % sizeof(ref_entry) == 0 && len <= sizeof(entries)) {
+    prefs.getBytes("entries", entries, len);
+    entry_count = len / sizeof(ref_entry);
+  }
+  prefs.end();
+  int loaded = entry_count;
+  refBind();
+  LOG_INFO("Reference data: %d symbols loaded.", loaded);
+}
+
+void refBind() {
+  memcpy(scratch, entries, entry_count * sizeof(ref_entry));
+  int old_count = entry_count;
+  for (int i = 0; i < watchlist_count; i++) {
+    int found = -1;
+    for (int j = 0; j < old_count && found < 0; j++) {
+      if (strcmp(scratch[j].symbol, watchlist[i].symbol) == 0) {
+        found = j;
+      }
+    }
+    if (found >= 0) {
+      entries[i] = scratch[found];
+    } else {
+      memset(&entries[i], 0, sizeof(ref_entry));
+      memcpy(entries[i].symbol, watchlist[i].symbol, sizeof(entries[i].symbol));
+    }
+    dirty |= found != i;
+  }
+  dirty |= old_count != watchlist_count;
+  entry_count = watchlist_count;
+}
+
+const reference *refGet(int i) {
+  if (i < 0 || i >= entry_count || !entries[i].valid || strcmp(entries[i].symbol, watchlist[i].symbol) != 0) {
+    return nullptr;                         // Not fetched, or the watchlist changed and refBind() is still to come
+  }
+  return &entries[i].ref;
+}
+
+bool refDue(int i, time_t now) {
+  if (i < 0 || i >= entry_count) {
+    return false;
+  }
+  const ref_entry &e = entries[i];
+  return !e.valid || exchangeDay(e, now) != exchangeDay(e, e.fetched) || (e.suspect && now - e.fetched >= REF_RECHECK);
+}
+
+void refStore(int i, const reference &r, time_t now) {
+  if (i < 0 || i >= watchlist_count) {
+    return;
+  }
+  ref_entry &e = entries[i];
+  memcpy(e.symbol, watchlist[i].symbol, sizeof(e.symbol));
+  e.ref = r;
+  e.fetched = now;
+  e.valid = true;
+  e.suspect = false;
+  entry_count = max(entry_count, i + 1);
+  dirty = true;
+  LOG_DEBUG("%s \t close %.2f, 52w %.2f - %.2f %s, %s", watchlist[i].label, r.previousClose, r.yearLow, r.yearHigh,
+            r.currency, r.timezone);
+}
+
+void refTouch(int i, time_t now) {
+  if (i >= 0 && i < entry_count && entries[i].valid) {
+    entries[i].fetched = now;
+    entries[i].suspect = false;
+    dirty = true;
+  }
+}
+
+bool refFill(int i, quote &q) {
+  if (!isnan(q.previousClose)) {
+    return true;                            // A full quote
+  }
+  const reference *r = refGet(i);
+  if (r == nullptr) {
+    return false;
+  }
+  q.previousClose = r->previousClose;
+  if (q.currency[0] == '\0') {
+    memcpy(q.currency, r->currency, sizeof(q.currency));
+  }
+  if (isnan(q.percentageChange)) {
+    q.percentageChange = q.previousClose != 0.0 ? (q.current / q.previousClose - 1.0) * 100.0 : 0.0;
+    return true;
+  }
+
+  // The change is Yahoo's own, against the close of the current session's day
+  if (q.percentageChange > -100.0) {
+    double implied = q.current / (1.0 + q.percentageChange / 100.0);
+    if (fabs(implied / q.previousClose - 1.0) > REF_TOLERANCE) {
+      if (!entries[i].suspect) {
+        LOG_INFO("%s \t cached close %.2f, change implies %.2f", watchlist[i].label, q.previousClose, implied);
+      }
+      entries[i].suspect = true;
+      q.previousClose = implied;
+    }
+  }
+  return true;
+}
+
+void refSave() {
+  if (!dirty) {
+    return;
+  }
+  dirty = false;
+  prefs.begin("refdata", false);
+  if (entry_count > 0) {
+    prefs.putBytes("entries", entries, entry_count * sizeof(ref_entry));
+  } else {
+    prefs.remove("entries");
+  }
+  prefs.end();
+}
@@ -0,0 +1,30 @@
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include "log.h"
+#include "render_stats.h"
+
+// ------------------------------------------------------------------------------------
+render_counts render_frame;
+render_totals render_total;
+static int64_t frame_started;
+// ------------------------------------------------------------------------------------
+
+void renderFrameBegin() {
+  render_frame.calls = 0;
+  render_frame.pixels = 0;
+  frame_started = esp_timer_get_time();
+}
+
+void renderFrameEnd() {
+  uint32_t us = esp_timer_get_time() - frame_started;
+  render_total.frames++;
+  render_total.calls += render_frame.calls;
+  render_total.pixels += render_frame.pixels;
+  render_total.us += us;
+  if (render_frame.pixels > render_total.maxPixels) {
+    render_total.maxPixels = render_frame.pixels;
+  }
+  LOG_DEBUG("Frame: %u calls, %u pixels, %u us", render_frame.calls, render_frame.pixels, us);
+}
@@ -0,0 +1,150 @@
+
+#include <Arduino.h>
+
+#include "display.h"
+#include "fx.h"
+#include "provisioning.h"
+#include "ref_data.h"
+#include "text_page.h"
+#include "watchlist.h"
+
+// ------------------------------------------------------------------------------------
+const int TFT_FONT = 4;           // Font to use on the TFT
+const int BUF_SIZE = 80;
+const int RANGE_BAR_HEIGHT = 2;   // 52-week range bar under each value
+const int RANGE_MARKER = 3;       // Width of the current price on it
+
+static int black_width = 0;       // Width of the rectagle that needs to be cleared when stocks update
+// ------------------------------------------------------------------------------------
+
+// Given a number convert it to a thousands separated string using a specific separating character
+static void comma_separator(int num, char *str, char sep) {
+    char temp[BUF_SIZE];
+    int i = 0, j = 0;
+    sprintf(temp, "%d", num);
+    int len = strlen(temp);
+    int k = len % 3;
+    if (k == 0) {
+        k = 3;
+    }
+    while (temp[i] != '\0') {
+        if (i == k) {
+            str[j++] = sep;
+            k += 3;
+        }
+        str[j++] = temp[i++];
+    }
+    str[j] = '\0';
+}
+
+// Write a stock quote to the TFT screen at a certain vertical position.
+// The entry's scale and separator char are used in case of showing thousands or millis
+static void drawQuote(const quote& symbol, const watch_entry& entry, int pos) {
+  // Set drawing colour according to market state and if the stock is up or down
+  if (symbol.marketOpen == false) {
+    tft.setTextColor(TFT_DARKGREY, TFT_BLACK);
+  } else if (symbol.current > symbol.previousClose) {
+    tft.setTextColor(TFT_GREEN, TFT_BLACK);
+  } else if (symbol.current == symbol.previousClose) {
+    tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  } else {
+    tft.setTextColor(TFT_RED, TFT_BLACK);
+  }
+
+  // Prices are shown in the base currency once its rate is known; index levels are points, not money
+  double value = symbol.current;
+  if (entry.symbol[0] != '^') {
+    fxToBase(symbol.current, symbol.currency, value);
+  }
+
+  // Actually write the stock value to the TFT
+  char buf[BUF_SIZE];
+  comma_separator(value * entry.scale, buf, entry.sep);
+  tft.drawString(buf, TFT_HEIGHT, tft.fontHeight(TFT_FONT)*pos, TFT_FONT);
+}
+
+// Draw the 52-week range of watchlist entry i along the bottom of the value at a certain vertical
+// position, with a marker where the current price is. Nothing until its reference data is in.
+static void drawRangeBar(int i, int pos) {
+  const reference *cached = refGet(i);
+  if (cached == nullptr || isnan(cached->yearLow) || quotes[i].current <= 0.0) {
+    return;
+  }
+  reference range = *cached;
+  fxNormaliseReference(range);    // Same units as the quote
+  double low = min(range.yearLow, quotes[i].current);
+  double high = max(range.yearHigh, quotes[i].current);
+  if (high <= low) {
+    return;
+  }
+  int x = TFT_HEIGHT - black_width;
+  int y = tft.fontHeight(TFT_FONT) * (pos + 1) - RANGE_BAR_HEIGHT;
+  int at = x + (int)lround((quotes[i].current - low) / (high - low) * (black_width - RANGE_MARKER));
+  tft.fillRect(x, y, black_width, RANGE_BAR_HEIGHT, TFT_DARKGREY);
+  tft.fillRect(at, y, RANGE_MARKER, RANGE_BAR_HEIGHT, TFT_WHITE);
+}
+
+static void drawPercentChange(const quote& symbol, int pos) {
+  // Set drawing colour according to market state and if the stock is up or down
+  if (symbol.marketOpen == false) { 
+    tft.setTextColor(TFT_DARKGREY, TFT_BLACK);
+  } else if (symbol.percentageChange > 0.0) {
+    tft.setTextColor(TFT_GREEN, TFT_BLACK);
+  } else if (abs(symbol.percentageChange) < 0.001) {
+    tft.setTextColor(TFT_WHITE, TFT_BLACK);
+  } else {
+    tft.setTextColor(TFT_RED, TFT_BLACK);
+  }
+
+  // Actually write the stock percentage change from the previous day to the TFT
+  char buf[BUF_SIZE];
+  sprintf(buf, "%+.1f%%", symbol.percentageChange);
+  tft.drawString(buf, TFT_HEIGHT, tft.fontHeight(TFT_FONT)*pos, TFT_FONT);
+}
+
+// Draw the quote names on the left if asked to, and clear the column of the values
+static void drawLabels(bool labels) {
+  if (black_width == 0) {
+    black_width = tft.textWidth("XXXXXXX", TFT_FONT);
+  }
+  if (labels) {
+    tft.fillScreen(TFT_BLACK);
+    tft.setTextColor(TFT_WHITE, TFT_BLACK);
+    tft.setTextDatum(TL_DATUM);
+    for (int i = 0; i < watchlist_count && i < TEXT_ROWS; i++) {
+      tft.drawString(watchlist[i].label, 0, tft.fontHeight(TFT_FONT)*i, TFT_FONT);
+    }
+  }
+  tft.setTextDatum(TR_DATUM);
+  tft.fillRect(TFT_HEIGHT-black_width, 0, black_width, TFT_HEIGHT, TFT_BLACK);
+}
+
+void drawValuesPage(bool labels) {
+  drawLabels(labels);
+  for (int i = 0; i < watchlist_count && i < TEXT_ROWS; i++) {
+    drawQuote(quotes[i], watchlist[i], i);
+    drawRangeBar(i, i);           // After the value, whose background would cover it
+  }
+}
+
+void drawChangePage(bool labels) {
+  drawLabels(labels);
+  for (int i = 0; i < watchlist_count && i < TEXT_ROWS; i++) {
+    drawPercentChange(quotes[i], i);
+  }
+}
+
+void drawStatusPage(bool portal, const char *address) {
+  tft.fillScreen(TFT_BLACK);
+  tft.setTextDatum(TL_DATUM);
+  if (portal) {
+    tft.setTextColor(TFT_YELLOW, TFT_BLACK);
+    tft.drawString("Wi-Fi setup", 0, 0, TFT_FONT);
+    tft.setTextColor(TFT_WHITE, TFT_BLACK);
+    tft.drawString(String("Join ") + PORTAL_AP_NAME, 0, 32, 2);
+    tft.drawString(String("Open ") + address, 0, 52, 2);
+  } else {
+    tft.setTextColor(TFT_WHITE, TFT_BLACK);
+    tft.drawString("Connecting...", 0, 0, TFT_FONT);
+  }
+}
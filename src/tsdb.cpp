@@ -0,0 +1,280 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef ARDUINO
+#include <esp_heap_caps.h>
+#endif
+
+#include "tsdb.h"
+
+// ------------------------------------------------------------------------------------
+struct tsdb_block {
+  tsdb_block *next;                         // Newer block of the same series
+  uint32_t startTime;                       // First sample, stored raw
+  int64_t startValue;
+  uint32_t count;                           // Samples in the block, first one included
+  uint32_t bits;                            // Bits used in data
+  // Encoder state, so appends do not need to decode the block
+  uint32_t lastTime;
+  int32_t lastDelta;
+  int64_t lastValue;
+  uint8_t data[];
+};
+
+const size_t BLOCK_DATA_BYTES = TSDB_BLOCK_BYTES - sizeof(tsdb_block);
+const uint32_t BLOCK_DATA_BITS = BLOCK_DATA_BYTES * 8;
+const uint32_t MAX_SAMPLE_BITS = 4 + 32 + 4 + 64;   // Worst case encoding of one sample
+
+typedef struct {
+  tsdb_block *head;                         // Oldest
+  tsdb_block *tail;                         // Newest, the one being appended to
+  uint32_t count;
+} tsdb_series;
+
+static uint8_t *pool = nullptr;
+static tsdb_block *free_list = nullptr;
+static uint32_t pool_blocks = 0;
+static tsdb_series series_list[TSDB_MAX_SERIES];
+static int series_count = 0;
+static tsdb_stats stats;
+// ------------------------------------------------------------------------------------
+// Bit packing, most significant bit first
+
+static void putBits(tsdb_block *b, uint64_t value, int n) {
+  for (int i = n - 1; i >= 0; i--) {
+    uint32_t pos = b->bits++;
+    uint8_t mask = 0x80 >> (pos & 7);
+    if ((value >> i) & 1) {
+      b->data[pos >> 3] |= mask;
+    } else {
+      b->data[pos >> 3] &= ~mask;
+    }
+  }
+}
+
+static uint64_t getBits(const tsdb_block *b, uint32_t &pos, int n) {
+  uint64_t v = 0;
+  for (int i = 0; i < n; i++, pos++) {
+    v = (v << 1) | ((b->data[pos >> 3] >> (7 - (pos & 7))) & 1);
+  }
+  return v;
+}
+
+static uint64_t zigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Prefix codes: 0 | 10+a | 110+b | 1110+c | 1111+d bits of zigzagged payload
+typedef struct {
+  int widths[4];
+} code_table;
+
+static const code_table TIME_CODE = { { 7, 12, 20, 32 } };
+static const code_table VALUE_CODE = { { 8, 16, 32, 64 } };
+static const uint8_t PREFIX[4] = { 0x2, 0x6, 0xE, 0xF };
+static const int PREFIX_BITS[4] = { 2, 3, 4, 4 };
+
+static void putCode(tsdb_block *b, int64_t v, const code_table &code) {
+  if (v == 0) {
+    putBits(b, 0, 1);
+    return;
+  }
+  uint64_t z = zigzag(v);
+  for (int i = 0; i < 4; i++) {
+    if (i == 3 || z < (1ull << code.widths[i])) {
+      putBits(b, PREFIX[i], PREFIX_BITS[i]);
+      putBits(b, z, code.widths[i]);
+      return;
+    }
+  }
+}
+
+static int64_t getCode(const tsdb_block *b, uint32_t &pos, const code_table &code) {
+  int ones = 0;
+  while (ones < 4 && getBits(b, pos, 1) == 1) {
+    ones++;
+  }
+  if (ones == 0) {
+    return 0;
+  }
+  return unzigzag(getBits(b, pos, code.widths[ones - 1]));
+}
+
+// ------------------------------------------------------------------------------------
+
+static tsdb_block *allocBlock() {
+  if (free_list == nullptr) {
+    // Recycle the oldest head block among all series that have more than one block
+    tsdb_series *victim = nullptr;
+    for (int i = 0; i < series_count; i++) {
+      tsdb_series &s = series_list[i];
+      if (s.head != nullptr && s.head != s.tail &&
+          (victim == nullptr || s.head->startTime < victim->head->startTime)) {
+        victim = &s;
+      }
+    }
+    if (victim == nullptr) {
+      return nullptr;
+    }
+    tsdb_block *b = victim->head;
+    victim->head = b->next;
+    victim->count -= b->count;
+    stats.samples -= b->count;
+    stats.blocks--;
+    stats.evictions++;
+    b->next = free_list;
+    free_list = b;
+  }
+
+  tsdb_block *b = free_list;
+  free_list = b->next;
+  memset(b, 0, TSDB_BLOCK_BYTES);
+  stats.blocks++;
+  return b;
+}
+
+bool tsdbBegin(int series, size_t budget) {
+  if (series > TSDB_MAX_SERIES) {
+    series = TSDB_MAX_SERIES;
+  }
+  pool_blocks = budget / TSDB_BLOCK_BYTES;
+#ifdef ARDUINO
+  pool = (uint8_t *)heap_caps_malloc(pool_blocks * TSDB_BLOCK_BYTES, MALLOC_CAP_SPIRAM);
+  if (pool == nullptr) {
+    pool = (uint8_t *)heap_caps_malloc(pool_blocks * TSDB_BLOCK_BYTES, MALLOC_CAP_8BIT);
+  }
+#else
+  pool = (uint8_t *)malloc(pool_blocks * TSDB_BLOCK_BYTES);
+#endif
+  if (pool == nullptr) {
+    pool_blocks = 0;
+    return false;
+  }
+  series_count = series;
+  tsdbClear();
+  return true;
+}
+
+void tsdbClear() {
+  free_list = nullptr;
+  for (uint32_t i = 0; i < pool_blocks; i++) {
+    tsdb_block *b = (tsdb_block *)(pool + (size_t)i * TSDB_BLOCK_BYTES);
+    b->next = free_list;
+    free_list = b;
+  }
+  memset(series_list, 0, sizeof(series_list));
+  memset(&stats, 0, sizeof(stats));
+}
+
+void tsdbAppend(int series, uint32_t t, double value) {
+  if (series < 0 || series >= series_count || !isfinite(value)) {
+    return;
+  }
+  tsdb_series &s = series_list[series];
+  int64_t v = llround(value * TSDB_SCALE);
+  tsdb_block *b = s.tail;
+
+  if (b != nullptr && t < b->lastTime) {
+    return;
+  }
+
+  if (b == nullptr || b->bits + MAX_SAMPLE_BITS > BLOCK_DATA_BITS) {
+    tsdb_block *nb = allocBlock();
+    if (nb == nullptr) {
+      return;
+    }
+    // allocBlock() may have recycled this series' head, but never its tail
+    nb->startTime = t;
+    nb->startValue = v;
+    nb->lastTime = t;
+    nb->lastDelta = 0;
+    nb->lastValue = v;
+    nb->count = 1;
+    if (s.tail != nullptr) {
+      s.tail->next = nb;
+    } else {
+      s.head = nb;
+    }
+    s.tail = nb;
+  } else {
+    int32_t dt = (int32_t)(t - b->lastTime);
+    putCode(b, (int64_t)dt - b->lastDelta, TIME_CODE);
+    putCode(b, v - b->lastValue, VALUE_CODE);
+    b->lastTime = t;
+    b->lastDelta = dt;
+    b->lastValue = v;
+    b->count++;
+  }
+  s.count++;
+  stats.samples++;
+}
+
+uint32_t tsdbCount(int series) {
+  return series >= 0 && series < series_count ? series_list[series].count : 0;
+}
+
+uint32_t tsdbFirstTime(int series) {
+  if (series < 0 || series >= series_count || series_list[series].head == nullptr) {
+    return 0;
+  }
+  return series_list[series].head->startTime;
+}
+
+tsdb_stats tsdbStats() {
+  tsdb_stats s = stats;
+  s.bytes = s.blocks * TSDB_BLOCK_BYTES;
+  return s;
+}
+
+// ------------------------------------------------------------------------------------
+
+TsdbReader::TsdbReader(int series, uint32_t from)
+  : _block(series >= 0 && series < series_count ? series_list[series].head : nullptr),
+    _from(from), _index(0), _bit(0), _t(0), _dt(0), _v(0) {
+  // Skip whole blocks that end before from, rather than decoding them
+  while (_block != nullptr && _block->next != nullptr && _block->next->startTime <= from) {
+    _block = _block->next;
+  }
+}
+
+bool TsdbReader::nextRaw(uint32_t &t, int64_t &v) {
+  while (_block != nullptr && _index >= _block->count) {
+    _block = _block->next;
+    _index = 0;
+    _bit = 0;
+  }
+  if (_block == nullptr) {
+    return false;
+  }
+
+  if (_index == 0) {
+    _t = _block->startTime;
+    _dt = 0;
+    _v = _block->startValue;
+  } else {
+    _dt += (int32_t)getCode(_block, _bit, TIME_CODE);
+    _t += _dt;
+    _v += getCode(_block, _bit, VALUE_CODE);
+  }
+  _index++;
+  t = _t;
+  v = _v;
+  return true;
+}
+
+bool TsdbReader::next(uint32_t &t, double &value) {
+  int64_t v;
+  do {
+    if (!nextRaw(t, v)) {
+      return false;
+    }
+  } while (t < _from);
+  value = (double)v / TSDB_SCALE;
+  return true;
+}
@@ -0,0 +1,42 @@
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include "quote_feed.h"
+#include "usb_feed.h"
+
+// ------------------------------------------------------------------------------------
+static uint32_t feed_seq = 0;     // Sequence number of the next frame
+static uint32_t feed_dropped = 0; // Frames not sent because the host was not reading
+// ------------------------------------------------------------------------------------
+
+// Encode a frame and hand it to the CDC driver only if it fits in the TX buffer right now
+static void feedSend(uint8_t type, const void *payload, uint16_t length) {
+  uint8_t frame[FEED_MAX_FRAME];
+  size_t n = feedEncode(frame, type, feed_seq++, esp_timer_get_time(), payload, length);
+
+  if ((size_t)Serial.availableForWrite() < n) {
+    feed_dropped++;
+    return;
+  }
+  Serial.write(frame, n);
+}
+
+void feedBegin() {
+  feedSend(FEED_HELLO, nullptr, 0);
+}
+
+void feedPublish(const char *label, const quote &q) {
+  feed_quote fq;
+  memset(&fq, 0, sizeof(fq));
+  memcpy(fq.symbol, label, strnlen(label, sizeof(fq.symbol)));   // Zero padded, no terminator needed
+  fq.price = llround(q.current * FEED_PRICE_SCALE);
+  fq.previousClose = llround(q.previousClose * FEED_PRICE_SCALE);
+  fq.changeBp = lround(q.percentageChange * 100.0);
+  fq.marketOpen = q.marketOpen ? 1 : 0;
+  feedSend(FEED_QUOTE, &fq, sizeof(fq));
+}
+
+uint32_t feedDropped() {
+  return feed_dropped;
+}
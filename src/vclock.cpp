@@ -0,0 +1,7 @@
+
+#include "vclock.h"
+
+#ifdef VIRTUAL_CLOCK
+uint64_t virtual_now_us = 0;
+time_t virtual_epoch = 0;
+#endif
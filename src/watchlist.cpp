@@ -0,0 +1,152 @@
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "log.h"
+#include "watchlist.h"
+
+// ------------------------------------------------------------------------------------
+// S&P500, NASDAQ100 and T-Bill 10 years
+static const watch_entry DEFAULT_WATCHLIST[] = {
+  { "^SPX", "SPX", 1.0f, ',' },
+  { "^NDX", "NDX", 1.0f, ',' },
+  { "^TNX", "T10", 1000.0f, '.' },
+};
+static const int DEFAULT_COUNT = sizeof(DEFAULT_WATCHLIST) / sizeof(DEFAULT_WATCHLIST[0]);
+
+watch_entry watchlist[WATCHLIST_MAX];
+quote quotes[WATCHLIST_MAX];
+int watchlist_count = 0;
+uint32_t watchlist_version = 0;
+
+static Preferences prefs;
+// ------------------------------------------------------------------------------------
+
+// Parse list into at most max entries, returning how many were valid
+static int parseList(const char *list, watch_entry *out, int max) {
+  int count = 0;
+  const char *p = list;
+  while (*p && count < max) {
+    const char *end = strchr(p, ',');
+    if (end == nullptr) {
+      end = p + strlen(p);
+    }
+    const char *colon = (const char *)memchr(p, ':', end - p);
+    const char *sym_end = colon != nullptr ? colon : end;
+
+    watch_entry e;
+    memset(&e, 0, sizeof(e));
+    e.scale = 1.0f;
+    e.sep = ',';
+    int n = 0;
+    for (const char *c = p; c < sym_end && n < (int)sizeof(e.symbol) - 1; c++) {
+      if (!isspace(*c)) {
+        e.symbol[n++] = toupper(*c);
+      }
+    }
+    if (n > 0) {
+      // Known symbols keep their display settings
+      for (int i = 0; i < DEFAULT_COUNT; i++) {
+        if (strcmp(DEFAULT_WATCHLIST[i].symbol, e.symbol) == 0) {
+          e = DEFAULT_WATCHLIST[i];
+        }
+      }
+      if (colon != nullptr) {
+        n = 0;
+        for (const char *c = colon + 1; c < end && n < (int)sizeof(e.label) - 1; c++) {
+          if (!isspace(*c)) {
+            e.label[n++] = *c;
+          }
+        }
+        e.label[n] = '\0';
+      }
+      if (e.label[0] == '\0') {
+        const char *name = e.symbol[0] == '^' ? e.symbol + 1 : e.symbol;
+        snprintf(e.label, sizeof(e.label), "%.*s", (int)sizeof(e.label) - 1, name);   // Cut to fit on purpose
+      }
+      out[count++] = e;
+    }
+    p = *end ? end + 1 : end;
+  }
+  return count;
+}
+
+void watchlistBegin() {
+  watchlist_count = DEFAULT_COUNT;
+  memcpy(watchlist, DEFAULT_WATCHLIST, sizeof(DEFAULT_WATCHLIST));
+
+  prefs.begin("watchlist", true);
+  String saved = prefs.getString("symbols", "");
+  prefs.end();
+  if (saved.length() > 0) {
+    int count = parseList(saved.c_str(), watchlist, WATCHLIST_MAX);
+    if (count > 0) {
+      watchlist_count = count;
+    } else {
+      memcpy(watchlist, DEFAULT_WATCHLIST, sizeof(DEFAULT_WATCHLIST));
+    }
+  }
+  memset(quotes, 0, sizeof(quotes));
+  LOG_INFO("Watchlist: %d symbols.", watchlist_count);
+}
+
+bool watchlistSet(const char *list) {
+  static watch_entry parsed[WATCHLIST_MAX];
+  int count = parseList(list, parsed, WATCHLIST_MAX);
+  if (count == 0) {
+    return false;
+  }
+  memcpy(watchlist, parsed, count * sizeof(watch_entry));
+  watchlist_count = count;
+  memset(quotes, 0, sizeof(quotes));
+  watchlist_version++;
+
+  prefs.begin("watchlist", false);
+  prefs.putString("symbols", watchlistText());
+  prefs.end();
+  LOG_INFO("Watchlist: %d symbols saved.", count);
+  return true;
+}
+
+int watchlistFind(const char *symbol) {
+  for (int i = 0; i < watchlist_count; i++) {
+    if (strcasecmp(watchlist[i].symbol, symbol) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int watchlistAdd(const char *symbol) {
+  watch_entry e;
+  if (parseList(symbol, &e, 1) != 1) {
+    return -1;
+  }
+  int i = watchlistFind(e.symbol);          // "SYMBOL:LABEL" for a symbol already listed
+  if (i >= 0 || watchlist_count == WATCHLIST_MAX) {
+    return i;
+  }
+  i = watchlist_count++;
+  watchlist[i] = e;
+  memset(&quotes[i], 0, sizeof(quote));
+  watchlist_version++;
+
+  prefs.begin("watchlist", false);
+  prefs.putString("symbols", watchlistText());
+  prefs.end();
+  LOG_INFO("Watchlist: %s added.", e.symbol);
+  return i;
+}
+
+String watchlistText() {
+  String text;
+  for (int i = 0; i < watchlist_count; i++) {
+    if (i > 0) {
+      text += ',';
+    }
+    text += watchlist[i].symbol;
+    text += ':';
+    text += watchlist[i].label;
+  }
+  return text;
+}
@@ -0,0 +1,109 @@
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_wifi.h>
+
+#include "log.h"
+#include "vclock.h"
+#include "wifi_power.h"
+
+// ------------------------------------------------------------------------------------
+const float BEACON_MS = 102.4f;         // Usual AP beacon interval (100 TU)
+const int MAX_LISTEN_INTERVAL = 10;     // Many APs drop stations that sleep through more beacons than this
+const unsigned long WAKE_LEAD = 200;    // Switch the radio fully on this long before a fetch
+const float BEACON_RX_MS = 3.0f;        // Radio-on time for one beacon wake-up in modem sleep
+
+static unsigned long poll_ms = 0;       // Running average of the fetch interval
+static uint16_t listen_interval = 3;    // In beacon intervals, for the next association
+static uint16_t associated_interval = 3;  // The one in use
+static bool awake = false;              // Power save is off (the radio is always listening)
+static bool held = false;               // Kept awake by wifiPowerHold()
+static bool fetch_wake = false;         // Woken for a fetch that has not finished
+static bool accounting = false;
+static unsigned long last_account;
+static uint64_t awake_ms = 0;           // Time connected with power save off
+static uint64_t asleep_ms = 0;          // Time connected in modem sleep
+static uint64_t total_ms = 0;           // Time accounted, connected or not
+// ------------------------------------------------------------------------------------
+
+// Sleep through roughly half the poll interval's worth of beacons; we wake up ourselves before fetching
+void wifiPowerSetPollInterval(unsigned long ms) {
+  poll_ms = poll_ms == 0 ? ms : (3 * poll_ms + ms) / 4;
+  int beacons = (int)(poll_ms / BEACON_MS / 2);
+  uint16_t interval = constrain(beacons, 1, MAX_LISTEN_INTERVAL);
+  if (interval != listen_interval) {
+    LOG_DEBUG("Wifi: fetching every %lu ms, listen interval %u from the next association.", poll_ms,
+              (unsigned)interval);
+    listen_interval = interval;
+  }
+}
+
+uint16_t wifiPowerListenInterval() {
+  return listen_interval;
+}
+
+void wifiPowerConfigure() {
+  wifi_config_t conf;
+  if (esp_wifi_get_config(WIFI_IF_STA, &conf) == ESP_OK) {
+    conf.sta.listen_interval = listen_interval;
+    esp_wifi_set_config(WIFI_IF_STA, &conf);
+    associated_interval = listen_interval;
+  }
+}
+
+static void setAwake(bool on) {
+  if (!on && held) {
+    return;
+  }
+  if (on == awake) {
+    return;
+  }
+  awake = on;
+  esp_wifi_set_ps(on ? WIFI_PS_NONE : WIFI_PS_MAX_MODEM);
+}
+
+void wifiPowerPoll(bool connected, unsigned long next_fetch) {
+  unsigned long now = clockMillis();
+  if (accounting) {
+    unsigned long dt = now - last_account;
+    total_ms += dt;
+    if (connected) {
+      (awake ? awake_ms : asleep_ms) += dt;
+    }
+  }
+  accounting = true;
+  last_account = now;
+
+  if (!connected) {
+    // Power save gets in the way of scanning and of the portal's soft AP
+    setAwake(true);
+    return;
+  }
+  if ((long)(next_fetch - now) <= (long)WAKE_LEAD) {
+    fetch_wake = true;
+    setAwake(true);
+  }
+}
+
+void wifiPowerSleep() {
+  fetch_wake = false;
+  setAwake(false);
+}
+
+void wifiPowerHold(bool on) {
+  held = on;
+  if (on) {
+    setAwake(true);
+  } else if (!fetch_wake) {
+    setAwake(false);
+  }
+}
+
+uint32_t wifiPowerRadioOnPerHour() {
+  if (total_ms == 0) {
+    return 0;
+  }
+  float duty = BEACON_RX_MS / (associated_interval * BEACON_MS);
+  float on_ms = awake_ms + asleep_ms * duty;
+  return (uint32_t)(on_ms * 3600000.0f / total_ms);
+}
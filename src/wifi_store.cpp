@@ -0,0 +1,65 @@
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "log.h"
+#include "wifi_store.h"
+
+// ------------------------------------------------------------------------------------
+static Preferences prefs;
+// ------------------------------------------------------------------------------------
+
+int wifiStoreLoad(wifi_network *nets) {
+  prefs.begin("wifi", true);
+  size_t bytes = prefs.getBytes("nets", nets, sizeof(wifi_network) * WIFI_MAX_NETWORKS);
+  String legacy_ssid = prefs.getString("ssid", "");
+  String legacy_pass = prefs.getString("pass", "");
+  prefs.end();
+
+  int count = bytes / sizeof(wifi_network);
+  if (count == 0 && legacy_ssid.length() > 0) {
+    // Single network saved by an earlier firmware version
+    strlcpy(nets[0].ssid, legacy_ssid.c_str(), sizeof(nets[0].ssid));
+    strlcpy(nets[0].pass, legacy_pass.c_str(), sizeof(nets[0].pass));
+    count = 1;
+  }
+  return count;
+}
+
+void wifiStoreAdd(const char *ssid, const char *pass) {
+  wifi_network nets[WIFI_MAX_NETWORKS];
+  int count = wifiStoreLoad(nets);
+
+  // Drop an existing entry for the same SSID, then shift everything down to make room at the front
+  for (int i = 0; i < count; i++) {
+    if (strcmp(nets[i].ssid, ssid) == 0) {
+      memmove(&nets[i], &nets[i + 1], sizeof(wifi_network) * (count - i - 1));
+      count--;
+      break;
+    }
+  }
+  if (count == WIFI_MAX_NETWORKS) {
+    LOG_INFO("Forgetting wifi <%s>.", nets[count - 1].ssid);
+    count--;
+  }
+  memmove(&nets[1], &nets[0], sizeof(wifi_network) * count);
+  memset(&nets[0], 0, sizeof(wifi_network));
+  strlcpy(nets[0].ssid, ssid, sizeof(nets[0].ssid));
+  strlcpy(nets[0].pass, pass, sizeof(nets[0].pass));
+  count++;
+
+  prefs.begin("wifi", false);
+  prefs.putBytes("nets", nets, sizeof(wifi_network) * count);
+  prefs.remove("ssid");
+  prefs.remove("pass");
+  prefs.end();
+}
+
+const wifi_network *wifiStoreFind(const wifi_network *nets, int count, const char *ssid) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(nets[i].ssid, ssid) == 0) {
+      return &nets[i];
+    }
+  }
+  return nullptr;
+}
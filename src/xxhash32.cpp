@@ -0,0 +1,94 @@
+#include <string.h>
+
+#include "xxhash32.h"
+
+// ------------------------------------------------------------------------------------
+static const uint32_t PRIME1 = 2654435761U;
+static const uint32_t PRIME2 = 2246822519U;
+static const uint32_t PRIME3 = 3266489917U;
+static const uint32_t PRIME4 = 668265263U;
+static const uint32_t PRIME5 = 374761393U;
+// ------------------------------------------------------------------------------------
+
+static inline uint32_t rotl(uint32_t x, int r) {
+  return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t round32(uint32_t acc, uint32_t input) {
+  return rotl(acc + input * PRIME2, 13) * PRIME1;
+}
+
+void XXHash32::reset(uint32_t seed) {
+  _seed = seed;
+  _v[0] = seed + PRIME1 + PRIME2;
+  _v[1] = seed + PRIME2;
+  _v[2] = seed;
+  _v[3] = seed - PRIME1;
+  _total = 0;
+  _buffered = 0;
+}
+
+void XXHash32::update(const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  _total += len;
+
+  if (_buffered + len < sizeof(_buf)) {
+    memcpy(_buf + _buffered, p, len);
+    _buffered += len;
+    return;
+  }
+  if (_buffered > 0) {
+    size_t fill = sizeof(_buf) - _buffered;
+    memcpy(_buf + _buffered, p, fill);
+    for (int i = 0; i < 4; i++) {
+      _v[i] = round32(_v[i], read32(_buf + 4 * i));
+    }
+    p += fill;
+    len -= fill;
+    _buffered = 0;
+  }
+  for (; len >= 16; p += 16, len -= 16) {
+    _v[0] = round32(_v[0], read32(p));
+    _v[1] = round32(_v[1], read32(p + 4));
+    _v[2] = round32(_v[2], read32(p + 8));
+    _v[3] = round32(_v[3], read32(p + 12));
+  }
+  memcpy(_buf, p, len);
+  _buffered = len;
+}
+
+uint32_t XXHash32::digest() const {
+  uint32_t h;
+  if (_total >= 16) {
+    h = rotl(_v[0], 1) + rotl(_v[1], 7) + rotl(_v[2], 12) + rotl(_v[3], 18);
+  } else {
+    h = _seed + PRIME5;
+  }
+  h += (uint32_t)_total;
+
+  const uint8_t *p = _buf;
+  size_t len = _buffered;
+  for (; len >= 4; p += 4, len -= 4) {
+    h = rotl(h + read32(p) * PRIME3, 17) * PRIME4;
+  }
+  for (; len > 0; p++, len--) {
+    h = rotl(h + *p * PRIME5, 11) * PRIME1;
+  }
+
+  h ^= h >> 15;
+  h *= PRIME2;
+  h ^= h >> 13;
+  h *= PRIME3;
+  h ^= h >> 16;
+  return h;
+}
+
+uint32_t XXHash32::hash(const void *data, size_t len, uint32_t seed) {
+  XXHash32 h(seed);
+  h.update(data, len);
+  return h.digest();
+}
@@ -0,0 +1,214 @@
+// Checks and times the non-blocking HTTP client (src/async_http.cpp) on Linux sockets against a
+// local server with a fixed response delay standing in for Yahoo's latency.
+// Every body framing (length, chunked, until close), connection reuse, the retry on a kept-alive
+// connection the server dropped and a POST are checked; then N requests are run one after the
+// other (as the blocking HTTPClient does) and all at once on one thread.
+//   g++ -O2 -I include -o async_http_bench tools/async_http_bench.cpp src/async_http.cpp -lpthread
+//   ./async_http_bench [requests] [delay ms]
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+
+#include "../include/async_http.h"
+
+static int delay_ms = 20;
+
+static uint32_t nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Body of n bytes that depends on n, so a mix-up shows
+static std::string bodyOf(int n) {
+  std::string b(n, ' ');
+  for (int i = 0; i < n; i++) {
+    b[i] = 'a' + (i * 7 + n) % 26;
+  }
+  return b;
+}
+
+// One connection: "/len/N", "/chunked/N", "/close/N", "/drop/N" (answer, then close without saying
+// so) or "/echo/N" (answer with what was POSTed)
+static void serve(int fd) {
+  std::string in;
+  char buf[4096];
+  for (;;) {
+    size_t end;
+    while ((end = in.find("\r\n\r\n")) == std::string::npos) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0) {
+        close(fd);
+        return;
+      }
+      in.append(buf, n);
+    }
+    char mode[16] = "";
+    int size = 0;
+    sscanf(in.c_str(), "%*s /%15[a-z]/%d", mode, &size);
+    const char *length = strstr(in.c_str(), "Content-Length: ");
+    size_t posted = length != nullptr && length < in.c_str() + end ? atoi(length + 16) : 0;
+    in.erase(0, end + 4);
+    while (in.size() < posted) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0) {
+        close(fd);
+        return;
+      }
+      in.append(buf, n);
+    }
+    std::string payload = in.substr(0, posted);
+    in.erase(0, posted);
+    usleep(delay_ms * 1000);
+
+    std::string body = strcmp(mode, "echo") == 0 ? payload : bodyOf(size), out;
+    if (strcmp(mode, "chunked") == 0) {
+      out = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+      for (size_t o = 0; o < body.size(); o += 700) {
+        std::string part = body.substr(o, 700);
+        snprintf(buf, sizeof(buf), "%zx;ext=1\r\n", part.size());
+        out += buf + part + "\r\n";
+      }
+      out += "0\r\nX-Trailer: 1\r\n\r\n";
+    } else if (strcmp(mode, "close") == 0) {
+      out = "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n" + body;
+    } else {
+      out = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    }
+    // Dribble it out in pieces to exercise the parsers across reads
+    for (size_t o = 0; o < out.size(); o += 333) {
+      send(fd, out.data() + o, out.size() - o < 333 ? out.size() - o : 333, MSG_NOSIGNAL);
+    }
+    if (strcmp(mode, "close") == 0 || strcmp(mode, "drop") == 0) {
+      close(fd);
+      return;
+    }
+  }
+}
+
+static int startServer() {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(s, (struct sockaddr *)&addr, sizeof(addr));
+  listen(s, 64);
+  socklen_t len = sizeof(addr);
+  getsockname(s, (struct sockaddr *)&addr, &len);
+  std::thread([s]() {
+    for (;;) {
+      int c = accept(s, nullptr, nullptr);
+      if (c >= 0) {
+        std::thread(serve, c).detach();
+      }
+    }
+  }).detach();
+  return ntohs(addr.sin_port);
+}
+
+static bool collect(void *ctx, const uint8_t *data, size_t len) {
+  ((std::string *)ctx)->append((const char *)data, len);
+  return true;
+}
+
+// Run the requests to completion on this thread
+static void runAll(AsyncHttp **requests, int count) {
+  for (;;) {
+    int busy = 0;
+    for (int i = 0; i < count; i++) {
+      if (requests[i]->poll(nowMs()) != AHTTP_DONE && requests[i]->busy()) {
+        busy++;
+      }
+    }
+    if (busy == 0) {
+      return;
+    }
+    asyncHttpWait(requests, count, 50);
+  }
+}
+
+static int failures = 0;
+
+static void check(AsyncHttp &r, const std::string &body, int size, const char *what) {
+  bool ok = r.state() == AHTTP_DONE && r.status() == 200 && body == bodyOf(size);
+  printf("%-34s %s (status %d, %zu bytes%s)\n", what, ok ? "ok" : "FAILED", r.status(), body.size(),
+         r.reused() ? ", reused" : "");
+  failures += !ok;
+}
+
+int main(int argc, char **argv) {
+  int requests = argc > 1 ? atoi(argv[1]) : 8;
+  delay_ms = argc > 2 ? atoi(argv[2]) : 20;
+  int port = startServer();
+  char url[128];
+
+  // Framing and connection reuse
+  AsyncHttp http;
+  AsyncHttp *one[] = { &http };
+  const char *modes[] = { "len", "len", "chunked", "close", "len", "drop", "len" };
+  const int sizes[] = { 5000, 0, 9000, 3000, 1, 2000, 4000 };
+  const char *what[] = { "content-length", "empty body, reused", "chunked with trailer, reused",
+                         "until close, reused", "after close, new connection", "dropped after answer",
+                         "retried on the dropped connection" };
+  for (int i = 0; i < 7; i++) {
+    std::string body;
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/%s/%d", port, modes[i], sizes[i]);
+    http.get(url, collect, &body, nowMs());
+    runAll(one, 1);
+    check(http, body, sizes[i], what[i]);
+  }
+  std::string payload = bodyOf(3000), body;
+  snprintf(url, sizeof(url), "http://127.0.0.1:%d/echo/0", port);
+  http.post(url, "application/json", (const uint8_t *)payload.data(), payload.size(), collect, &body, nowMs());
+  runAll(one, 1);
+  check(http, body, 3000, "post, echoed");
+  body.clear();
+  http.get("https://127.0.0.1/", collect, &body, nowMs());
+  printf("%-34s %s\n", "https on the host", http.status() == AHTTP_ERROR_URL ? "refused, ok" : "FAILED");
+
+  // One after the other against all at once, each on a fresh connection
+  std::string *bodies = new std::string[requests];
+  AsyncHttp *many = new AsyncHttp[requests];
+  AsyncHttp **list = new AsyncHttp *[requests];
+  uint32_t t0 = nowMs();
+  for (int i = 0; i < requests; i++) {
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/close/%d", port, 4000 + i);
+    many[i].get(url, collect, &bodies[i], nowMs());
+    list[i] = &many[i];
+    runAll(&list[i], 1);
+  }
+  uint32_t sequential = nowMs() - t0;
+
+  t0 = nowMs();
+  for (int i = 0; i < requests; i++) {
+    bodies[i].clear();
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/close/%d", port, 4000 + i);
+    many[i].get(url, collect, &bodies[i], nowMs());
+  }
+  runAll(list, requests);
+  uint32_t concurrent = nowMs() - t0;
+  for (int i = 0; i < requests; i++) {
+    if (many[i].status() != 200 || bodies[i] != bodyOf(4000 + i)) {
+      printf("concurrent request %d FAILED (status %d)\n", i, many[i].status());
+      failures++;
+    }
+  }
+
+  printf("%d requests, %d ms server delay: one at a time %u ms, all at once on one thread %u ms\n", requests,
+         delay_ms, sequential, concurrent);
+  printf("%zu bytes of state per request, no stack of its own\n", sizeof(AsyncHttp));
+  delete[] list;
+  delete[] many;
+  delete[] bodies;
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Symbolise a T-Dongle-S3 crash report against the firmware ELF.
+
+    crash_decode.py report.json .pio/build/lilygo-t-dongle-s3/firmware.elf
+    crash_decode.py --listen 8080 [--elf firmware.elf]   # act as the collector
+
+Reports are the JSON documents the dongle POSTs to its collector URL after a crash.
+Needs xtensa-esp32s3-elf-addr2line on the PATH (it ships with the PlatformIO toolchain).
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import subprocess
+import sys
+import time
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+ADDR2LINE = os.environ.get("ADDR2LINE", "xtensa-esp32s3-elf-addr2line")
+
+RESET_REASONS = {
+    1: "power on", 3: "software reset", 4: "panic", 5: "interrupt watchdog",
+    6: "task watchdog", 7: "other watchdog", 8: "deep sleep", 9: "brownout",
+}
+
+
+def symbolise(elf, addresses):
+    if not elf or not addresses:
+        return {}
+    out = subprocess.run([ADDR2LINE, "-pfiaC", "-e", elf] + addresses,
+                         capture_output=True, text=True, check=False).stdout
+    # One block per address, starting with "0x...: "
+    lines, current = {}, None
+    for line in out.splitlines():
+        if line.startswith("0x") and ": " in line:
+            current, rest = line.split(": ", 1)
+            lines[int(current, 16)] = [rest]
+        elif current is not None:
+            lines[int(current, 16)].append(line.strip())
+    return lines
+
+
+def elf_matches(elf, prefix):
+    with open(elf, "rb") as f:
+        digest = hashlib.sha256(f.read()).hexdigest()
+    return digest.startswith(prefix)
+
+
+def decode(report, elf):
+    print(f"device        {report.get('device', '?')}")
+    reason = report.get("reset_reason")
+    print(f"reset reason  {reason} ({RESET_REASONS.get(reason, 'unknown')})")
+    sha = report.get("elf_sha256", "")
+    if elf and sha and not elf_matches(elf, sha):
+        print(f"WARNING: report is for firmware {sha}, which does not match {elf}")
+
+    heap = report.get("heap", {})
+    print(f"heap          free {heap.get('free')}  min free {heap.get('min_free')}  "
+          f"largest block {heap.get('largest_block')}")
+
+    if report.get("core_dump"):
+        print(f"task          {report.get('task')}")
+        print(f"exception     cause {report.get('exc_cause')}  vaddr {report.get('exc_vaddr')}")
+        frames = report.get("backtrace", [])
+        if not frames or frames[0] != report["pc"]:
+            frames = [report["pc"]] + frames
+        symbols = symbolise(elf, frames)
+        print("backtrace" + ("  (corrupted)" if report.get("bt_corrupted") else ""))
+        for i, addr in enumerate(frames):
+            where = symbols.get(int(addr, 16), ["?"])
+            print(f"  #{i:<2} {addr}  {where[0]}")
+            for inlined in where[1:]:
+                print(f"                    {inlined}")
+    else:
+        print("no core dump in this report")
+
+    print("last events")
+    for e in report.get("trace", []):
+        print(f"  {e['ms']:>10} ms  {e['event']:<12} {e['arg']}")
+
+
+def listen(port, elf, directory):
+    class Collector(BaseHTTPRequestHandler):
+        def do_POST(self):
+            body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+            try:
+                report = json.loads(body)
+            except ValueError:
+                self.send_response(400)
+                self.end_headers()
+                return
+            name = os.path.join(directory, f"crash-{report.get('device', 'unknown').replace(':', '')}"
+                                           f"-{int(time.time())}.json")
+            with open(name, "w") as f:
+                json.dump(report, f, indent=2)
+            self.send_response(200)
+            self.end_headers()
+            print(f"=== {name}")
+            decode(report, elf)
+            sys.stdout.flush()
+
+    HTTPServer(("", port), Collector).serve_forever()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("report", nargs="?", help="report JSON file")
+    parser.add_argument("elf", nargs="?", help="firmware ELF")
+    parser.add_argument("--elf", dest="elf_opt", help="firmware ELF (with --listen)")
+    parser.add_argument("--listen", type=int, metavar="PORT", help="receive reports over HTTP")
+    parser.add_argument("--dir", default=".", help="where --listen stores reports")
+    args = parser.parse_args()
+
+    elf = args.elf or args.elf_opt
+    if args.listen:
+        listen(args.listen, elf, args.dir)
+    elif args.report:
+        with open(args.report) as f:
+            decode(json.load(f), elf)
+    else:
+        parser.print_usage()
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
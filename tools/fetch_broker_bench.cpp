@@ -0,0 +1,245 @@
+// Checks the request broker (src/fetch_broker.cpp) on Linux sockets against a local server that
+// answers "/quote?symbols=A,B" with the symbols it was asked for after a fixed delay.
+// Several producers ask for overlapping symbol lists every frame, as the pages and the portfolio
+// would; the server side counts what actually went over the wire.
+//   g++ -O2 -I include -o fetch_broker_bench tools/fetch_broker_bench.cpp src/fetch_broker.cpp
+//       src/async_http.cpp src/xxhash32.cpp -lpthread
+//   ./fetch_broker_bench [symbols] [delay ms]
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/fetch_broker.h"
+
+static int delay_ms = 30;
+static std::mutex lock;
+static std::vector<uint32_t> request_times;
+static int wire_symbols = 0;
+
+static uint32_t nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// One kept-alive connection; the body is the symbol list, decoded
+static void serve(int fd) {
+  std::string in;
+  char buf[4096];
+  for (;;) {
+    size_t end;
+    while ((end = in.find("\r\n\r\n")) == std::string::npos) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0) {
+        close(fd);
+        return;
+      }
+      in.append(buf, n);
+    }
+    std::string path = in.substr(4, in.find(' ', 4) - 4);
+    in.erase(0, end + 4);
+    std::string body;
+    size_t q = path.find("symbols=");
+    for (size_t i = q == std::string::npos ? path.size() : q + 8; i < path.size(); i++) {
+      if (path[i] == '%' && i + 2 < path.size()) {
+        body += (char)strtol(path.substr(i + 1, 2).c_str(), nullptr, 16);
+        i += 2;
+      } else {
+        body += path[i];
+      }
+    }
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      request_times.push_back(nowMs());
+      wire_symbols += 1 + std::count(body.begin(), body.end(), ',');
+    }
+    usleep(delay_ms * 1000);
+    std::string out = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+  }
+}
+
+static int startServer() {
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(s, (struct sockaddr *)&addr, sizeof(addr));
+  listen(s, 64);
+  socklen_t len = sizeof(addr);
+  getsockname(s, (struct sockaddr *)&addr, &len);
+  std::thread([s]() {
+    for (;;) {
+      int c = accept(s, nullptr, nullptr);
+      if (c >= 0) {
+        std::thread(serve, c).detach();
+      }
+    }
+  }).detach();
+  return ntohs(addr.sin_port);
+}
+
+static int failures = 0;
+static std::vector<std::string> symbols;
+static std::vector<int> answered;          // Times each symbol came back
+static int responses = 0;
+static int live_response = 0;              // Position of the response carrying LIVE1
+
+// Check a response carries exactly the items it asked for, and count them
+static void take(const broker_response &r) {
+  std::string expect;
+  responses++;
+  for (int i = 0; i < r.count; i++) {
+    expect += (i ? "," : "") + std::string(r.items[i]);
+    if (strcmp(r.items[i], "LIVE1") == 0 && r.priority == PRIORITY_LIVE) {
+      live_response = responses;
+    }
+    for (size_t s = 0; s < symbols.size(); s++) {
+      if (symbols[s] == r.items[i]) {
+        answered[s]++;
+      }
+    }
+  }
+  if (r.status != 200 || expect != std::string(r.body, r.length)) {
+    printf("response FAILED (status %d, %d items)\n", r.status, r.count);
+    failures++;
+  }
+}
+
+// Poll until nothing is pending
+static void drain() {
+  broker_response r;
+  while (brokerPending() > 0) {
+    while (brokerPoll(nowMs(), r)) {
+      take(r);
+    }
+    if (brokerInFlight()) {
+      brokerWait(10);
+    } else {
+      usleep(5000);
+    }
+  }
+}
+
+static void expect(bool ok, const char *what) {
+  printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+  failures += !ok;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 150;
+  delay_ms = argc > 2 ? atoi(argv[2]) : 30;
+  count = count < BROKER_QUEUE - 2 ? count : BROKER_QUEUE - 2;
+  int port = startServer();
+  char prefix[96];
+  snprintf(prefix, sizeof(prefix), "http://127.0.0.1:%d/quote?symbols=", port);
+  // Slow bucket so the limit shows within a few seconds
+  broker_limits limits = { 4.0f, 2, 2 };
+  brokerHost("127.0.0.1", limits);
+  int endpoint = brokerEndpoint(prefix);
+  for (int i = 0; i < count; i++) {
+    char s[BROKER_ITEM_SIZE];
+    const char *format[] = { "^IDX%03d", "SYM%03d.EX", "ES%03d=F", "EUR%03d=X" };
+    snprintf(s, sizeof(s), format[i % 4], i);
+    symbols.push_back(s);
+  }
+  answered.assign(count, 0);
+
+  // Batching: every symbol once, in as few URLs as fit
+  uint32_t t0 = nowMs();
+  for (int i = 0; i < count; i++) {
+    brokerSubmit(endpoint, symbols[i].c_str(), PRIORITY_LIVE, nowMs());
+  }
+  drain();
+  const broker_stats &st = brokerStats();
+  printf("%d symbols in %u requests of up to %d URL bytes, %u ms\n", count, st.requests, BROKER_URL_MAX,
+         nowMs() - t0);
+  bool once = true;
+  for (int i = 0; i < count; i++) {
+    once &= answered[i] == 1;
+  }
+  expect(once, "every symbol answered exactly once");
+
+  // Priority: a long backfill is queued, then a few live symbols; they go first, not after it
+  responses = 0;
+  for (int i = 0; i < count; i++) {
+    brokerSubmit(endpoint, symbols[i].c_str(), PRIORITY_BACKFILL, nowMs());
+  }
+  brokerSubmit(endpoint, "LIVE1", PRIORITY_LIVE, nowMs());
+  brokerSubmit(endpoint, "LIVE2", PRIORITY_LIVE, nowMs());
+  drain();
+  printf("backfill of %d symbols took %d requests, the live ones came back in response %d\n", count, responses,
+         live_response);
+  expect(live_response > 0 && live_response <= limits.connections, "live symbols go out ahead of the backfill");
+  broker_response r;
+
+  // Coalescing and the token bucket: three producers ask every 10 ms for 3 s
+  int before_wire;
+  size_t before_requests;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    before_wire = wire_symbols;
+    before_requests = request_times.size();
+  }
+  uint32_t submitted = st.submitted, coalesced = st.coalesced;
+  t0 = nowMs();
+  while (nowMs() - t0 < 3000) {
+    for (int i = 0; i < count / 2; i++) {
+      brokerSubmit(endpoint, symbols[i].c_str(), PRIORITY_LIVE, nowMs());                // Pages
+      brokerSubmit(endpoint, symbols[count / 4 + i].c_str(), PRIORITY_LIVE, nowMs());    // Portfolio
+    }
+    for (int i = 0; i < count; i += 3) {
+      brokerSubmit(endpoint, symbols[i].c_str(), PRIORITY_BACKFILL, nowMs());            // History
+    }
+    uint32_t frame = nowMs();
+    while (nowMs() - frame < 10) {
+      while (brokerPoll(nowMs(), r)) {
+        take(r);
+      }
+      if (brokerInFlight()) {
+        brokerWait(10);
+      } else {
+        usleep(2000);
+      }
+    }
+  }
+  drain();
+  std::vector<uint32_t> times;
+  int wire;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    times.assign(request_times.begin() + before_requests, request_times.end());
+    wire = wire_symbols - before_wire;
+  }
+  size_t window = 0;
+  for (size_t i = 0, j = 0; i < times.size(); i++) {
+    while (times[i] - times[j] >= 1000) {
+      j++;
+    }
+    window = i - j + 1 > window ? i - j + 1 : window;
+  }
+  printf("producers asked for %u symbols, %u coalesced, %d went over the wire in %zu requests\n",
+         st.submitted - submitted, st.coalesced - coalesced, wire, times.size());
+  printf("busiest second: %zu requests (bucket: %.0f/s, burst %d), %u held back by the bucket\n", window,
+         limits.rate, limits.burst, st.throttled);
+  expect(window <= (size_t)(limits.rate + limits.burst), "host kept within its token bucket");
+
+  for (int p = 0; p < PRIORITIES; p++) {
+    printf("%-8s %5u requests, queue depth max %3d, wait avg %4u ms, max %4u ms\n", PRIORITY_NAMES[p],
+           st.started[p], st.depthMax[p], st.started[p] ? st.waitMs[p] / st.started[p] : 0, st.waitMaxMs[p]);
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// Stand-in for the libFuzzer driver, for compilers without -fsanitize=fuzzer: runs
+// LLVMFuzzerTestOneInput once over every file named on the command line, or every file in a
+// named directory, e.g. a seed corpus or the crash file libFuzzer left behind. Included by the
+// fuzz targets when they are built with -D FUZZ_MAIN.
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Run the target over one file. Returns false if it could not be read.
+static bool fuzzRunFile(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    data.insert(data.end(), buf, buf + n);
+  }
+  fclose(f);
+  // A copy of exactly the input's size, so the sanitizers catch reads past its end
+  std::vector<uint8_t> exact(data);
+  LLVMFuzzerTestOneInput(exact.data(), exact.size());
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int runs = 0;
+  for (int i = 1; i < argc; i++) {
+    DIR *dir = opendir(argv[i]);
+    if (dir == nullptr) {
+      runs += fuzzRunFile(argv[i]);
+      continue;
+    }
+    struct dirent *e;
+    while ((e = readdir(dir)) != nullptr) {
+      if (e->d_name[0] != '.') {
+        runs += fuzzRunFile(std::string(argv[i]) + "/" + e->d_name);
+      }
+    }
+    closedir(dir);
+  }
+  printf("%d inputs run\n", runs);
+  return 0;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino-ESP32 core the firmware uses, so its modules build
+// on Linux for the tools: time, the serial port, a few ESP and FreeRTOS calls. Build the tools
+// with -I tools/host ahead of -I include. See tools/render_golden.cpp and tools/replay_sim.cpp.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "WString.h"
+
+using std::abs;
+using std::isinf;
+using std::isnan;
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define OUTPUT 0x03
+#define INPUT 0x01
+#define LOW 0
+#define HIGH 1
+
+inline uint64_t hostMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+inline unsigned long millis() { return hostMicros() / 1000; }
+inline unsigned long micros() { return hostMicros(); }
+inline void delay(unsigned long ms) { usleep(ms * 1000); }
+inline void yield() {}
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline bool psramFound() { return false; }
+
+inline void configTzTime(const char *tz, const char *, const char * = nullptr, const char * = nullptr) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+// FreeRTOS tasks as detached threads; ticks are milliseconds
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+#define pdPASS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+inline BaseType_t xTaskCreate(void (*task)(void *), const char *, uint32_t, void *arg, int, TaskHandle_t *handle) {
+  std::thread(task, arg).detach();
+  if (handle != nullptr) {
+    *handle = nullptr;
+  }
+  return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t ticks) { usleep(ticks * 1000); }
+
+// The USB CDC port: stdout unless a tool points it elsewhere
+class HostSerial {
+public:
+  void begin(unsigned long) {}
+  size_t write(const uint8_t *data, size_t len) { return fwrite(data, 1, len, out); }
+  size_t write(uint8_t c) { return fputc(c, out) == EOF ? 0 : 1; }
+  int availableForWrite() { return 4096; }
+  size_t print(const char *s) { return fputs(s, out) >= 0 ? strlen(s) : 0; }
+  size_t println(const char *s = "") { return print(s) + print("\n"); }
+  template <typename... Args>
+  int printf(const char *fmt, Args... args) { return fprintf(out, fmt, args...); }
+  void flush() { fflush(out); }
+  operator bool() const { return true; }
+
+  FILE *out = stdout;
+};
+
+inline HostSerial Serial;
+
+// Heap figures of a board without PSRAM, and a restart that ends the program
+class EspClass {
+public:
+  uint32_t getFreeHeap() { return 200 * 1024; }
+  uint32_t getMinFreeHeap() { return 160 * 1024; }
+  uint32_t getMaxAllocHeap() { return 100 * 1024; }
+  uint64_t getEfuseMac() { return 0x0000A1B2C3D4E5F6ull; }
+  [[noreturn]] void restart() {
+    fprintf(stderr, "ESP.restart()\n");
+    fflush(stdout);
+    exit(3);
+  }
+};
+
+inline EspClass ESP;
@@ -0,0 +1,79 @@
+#pragma once
+
+// Host stand-in for the ESP32 NVS Preferences library: one in-memory store per process, so
+// what a module saves is there for the next begin() of the same namespace, as after a reboot.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "WString.h"
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false) {
+    _ns = &store()[name];
+    _readOnly = readOnly;
+    return true;
+  }
+  void end() { _ns = nullptr; }
+  bool clear() { return writable() && (_ns->clear(), true); }
+  bool isKey(const char *key) { return _ns != nullptr && _ns->count(key) > 0; }
+  bool remove(const char *key) { return writable() && _ns->erase(key) > 0; }
+
+  size_t putBytes(const char *key, const void *value, size_t len) {
+    if (!writable()) {
+      return 0;
+    }
+    (*_ns)[key].assign((const uint8_t *)value, (const uint8_t *)value + len);
+    return len;
+  }
+  size_t getBytesLength(const char *key) {
+    const std::vector<uint8_t> *v = find(key);
+    return v ? v->size() : 0;
+  }
+  size_t getBytes(const char *key, void *buf, size_t maxLen) {
+    const std::vector<uint8_t> *v = find(key);
+    if (v == nullptr || v->size() > maxLen) {
+      return 0;
+    }
+    memcpy(buf, v->data(), v->size());
+    return v->size();
+  }
+
+  size_t putInt(const char *key, int32_t value) { return putBytes(key, &value, sizeof(value)); }
+  int32_t getInt(const char *key, int32_t defaultValue = 0) {
+    int32_t value;
+    return getBytesLength(key) == sizeof(value) && getBytes(key, &value, sizeof(value)) ? value : defaultValue;
+  }
+  size_t putUInt(const char *key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0) {
+    uint32_t value;
+    return getBytesLength(key) == sizeof(value) && getBytes(key, &value, sizeof(value)) ? value : defaultValue;
+  }
+  size_t putString(const char *key, const char *value) { return putBytes(key, value, strlen(value) + 1); }
+  size_t putString(const char *key, const String &value) { return putString(key, value.c_str()); }
+  String getString(const char *key, const String &defaultValue = String()) {
+    const std::vector<uint8_t> *v = find(key);
+    return v && !v->empty() ? String((const char *)v->data()) : defaultValue;
+  }
+
+private:
+  typedef std::map<std::string, std::vector<uint8_t>> name_space;
+
+  static std::map<std::string, name_space> &store() {
+    static std::map<std::string, name_space> s;
+    return s;
+  }
+  bool writable() const { return _ns != nullptr && !_readOnly; }
+  const std::vector<uint8_t> *find(const char *key) const {
+    if (_ns == nullptr) {
+      return nullptr;
+    }
+    auto it = _ns->find(key);
+    return it == _ns->end() ? nullptr : &it->second;
+  }
+
+  name_space *_ns = nullptr;
+  bool _readOnly = false;
+};
@@ -0,0 +1,279 @@
+#pragma once
+
+// Host stand-in for TFT_eSPI: a headless framebuffer of the T-Dongle-S3 panel, so the page
+// renderers draw on Linux and the result can be compared pixel for pixel (tools/render_golden.cpp).
+// The virtual primitives are the ones TFT_eSPI has and are reached the same way: fillScreen()
+// through fillRect(), drawLine() as runs of fastH/VLine() and single pixels, drawString() one
+// drawChar() at a time, so CountingTFT counts what it would on the device.
+// The font metrics follow the device fonts (height, and digits of fonts 2 and 4 about as wide),
+// but every glyph is the classic 5x7 one scaled up: the images check layout, colours and what
+// gets redrawn, not the shapes of the letters.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Arduino.h"
+
+#ifndef TFT_WIDTH
+#define TFT_WIDTH 80
+#endif
+#ifndef TFT_HEIGHT
+#define TFT_HEIGHT 160
+#endif
+
+#define TFT_BLACK       0x0000
+#define TFT_NAVY        0x000F
+#define TFT_DARKGREEN   0x03E0
+#define TFT_DARKCYAN    0x03EF
+#define TFT_MAROON      0x7800
+#define TFT_PURPLE      0x780F
+#define TFT_OLIVE       0x7BE0
+#define TFT_LIGHTGREY   0xD69A
+#define TFT_DARKGREY    0x7BEF
+#define TFT_BLUE        0x001F
+#define TFT_GREEN       0x07E0
+#define TFT_CYAN        0x07FF
+#define TFT_RED         0xF800
+#define TFT_MAGENTA     0xF81F
+#define TFT_YELLOW      0xFFE0
+#define TFT_WHITE       0xFFFF
+#define TFT_ORANGE      0xFDA0
+#define TFT_GREENYELLOW 0xB7E0
+#define TFT_PINK        0xFE19
+
+#define TL_DATUM 0
+#define TC_DATUM 1
+#define TR_DATUM 2
+#define ML_DATUM 3
+#define CL_DATUM 3
+#define MC_DATUM 4
+#define CC_DATUM 4
+#define MR_DATUM 5
+#define CR_DATUM 5
+#define BL_DATUM 6
+#define BC_DATUM 7
+#define BR_DATUM 8
+#define L_BASELINE 9
+#define C_BASELINE 10
+#define R_BASELINE 11
+
+class TFT_eSPI {
+public:
+  TFT_eSPI(int16_t w = TFT_WIDTH, int16_t h = TFT_HEIGHT) : _init_width(w), _init_height(h), _width(w), _height(h) {}
+  virtual ~TFT_eSPI() {}
+
+  void init() { memset(_fb, 0, sizeof(_fb)); }
+  void begin() { init(); }
+
+  // Odd rotations are landscape. The buffer keeps its contents, laid out for the new width.
+  void setRotation(uint8_t r) {
+    _rotation = r & 3;
+    _width = _rotation & 1 ? _init_height : _init_width;
+    _height = _rotation & 1 ? _init_width : _init_height;
+  }
+  uint8_t getRotation() const { return _rotation; }
+  int16_t width() const { return _width; }
+  int16_t height() const { return _height; }
+
+  virtual void drawPixel(int32_t x, int32_t y, uint32_t color) {
+    if (x >= 0 && y >= 0 && x < _width && y < _height) {
+      _fb[y * _width + x] = color;
+    }
+  }
+
+  virtual void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color) { fill(x, y, 1, h, color); }
+  virtual void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color) { fill(x, y, w, 1, color); }
+  virtual void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) { fill(x, y, w, h, color); }
+  void fillScreen(uint32_t color) { fillRect(0, 0, _width, _height, color); }
+
+  // Bresenham in runs, as TFT_eSPI draws it
+  virtual void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color) {
+    bool steep = abs32(y1 - y0) > abs32(x1 - x0);
+    if (steep) {
+      swap(x0, y0);
+      swap(x1, y1);
+    }
+    if (x0 > x1) {
+      swap(x0, x1);
+      swap(y0, y1);
+    }
+    int32_t dx = x1 - x0, dy = abs32(y1 - y0);
+    int32_t err = dx >> 1, ystep = y0 < y1 ? 1 : -1, xs = x0, dlen = 0;
+    for (; x0 <= x1; x0++) {
+      dlen++;
+      err -= dy;
+      if (err < 0) {
+        run(steep, xs, y0, dlen, color);
+        dlen = 0;
+        y0 += ystep;
+        xs = x0 + 1;
+        err += dx;
+      }
+    }
+    if (dlen) {
+      run(steep, xs, y0, dlen, color);
+    }
+  }
+
+  void setTextColor(uint16_t color) { _textcolor = _textbgcolor = color; }
+  void setTextColor(uint16_t fgcolor, uint16_t bgcolor, bool = false) {
+    _textcolor = fgcolor;
+    _textbgcolor = bgcolor;
+  }
+  void setTextDatum(uint8_t datum) { _textdatum = datum; }
+  uint8_t getTextDatum() const { return _textdatum; }
+  void setTextFont(uint8_t font) { _textfont = font; }
+  void setTextSize(uint8_t) {}
+
+  int16_t textWidth(const char *string, uint8_t font) { return strlen(string) * metrics(font).advance; }
+  int16_t textWidth(const char *string) { return textWidth(string, _textfont); }
+  int16_t textWidth(const String &string, uint8_t font) { return textWidth(string.c_str(), font); }
+  int16_t textWidth(const String &string) { return textWidth(string.c_str(), _textfont); }
+  int16_t fontHeight(int16_t font) { return metrics(font).height; }
+  int16_t fontHeight() { return fontHeight(_textfont); }
+
+  // One glyph cell with its top left at x, y; the cell is filled when the background differs
+  virtual int16_t drawChar(uint16_t uniCode, int32_t x, int32_t y, uint8_t font) {
+    const font_metrics &m = metrics(font);
+    if (_textbgcolor != _textcolor) {
+      fill(x, y, m.advance, m.height, _textbgcolor);
+    }
+    if (uniCode < 0x20 || uniCode > 0x7E) {
+      return m.advance;
+    }
+    const uint8_t *glyph = GLYPHS[uniCode - 0x20];
+    int32_t left = x + (m.advance - 5 * m.sx) / 2, top = y + (m.height - 7 * m.sy) / 2;
+    for (int col = 0; col < 5; col++) {
+      for (int row = 0; row < 7; row++) {
+        if (glyph[col] & (1 << row)) {
+          fill(left + col * m.sx, top + row * m.sy, m.sx, m.sy, _textcolor);
+        }
+      }
+    }
+    return m.advance;
+  }
+
+  int16_t drawString(const char *string, int32_t x, int32_t y, uint8_t font) {
+    int16_t w = textWidth(string, font), h = fontHeight(font);
+    switch (_textdatum) {
+      case TC_DATUM: x -= w / 2; break;
+      case TR_DATUM: x -= w; break;
+      case ML_DATUM: y -= h / 2; break;
+      case MC_DATUM: x -= w / 2; y -= h / 2; break;
+      case MR_DATUM: x -= w; y -= h / 2; break;
+      case BL_DATUM: y -= h; break;
+      case BC_DATUM: x -= w / 2; y -= h; break;
+      case BR_DATUM: x -= w; y -= h; break;
+      case L_BASELINE: y -= h * 3 / 4; break;
+      case C_BASELINE: x -= w / 2; y -= h * 3 / 4; break;
+      case R_BASELINE: x -= w; y -= h * 3 / 4; break;
+    }
+    for (const char *c = string; *c; c++) {
+      x += drawChar((uint8_t)*c, x, y, font);
+    }
+    return w;
+  }
+  int16_t drawString(const char *string, int32_t x, int32_t y) { return drawString(string, x, y, _textfont); }
+  int16_t drawString(const String &string, int32_t x, int32_t y, uint8_t font) {
+    return drawString(string.c_str(), x, y, font);
+  }
+  int16_t drawString(const String &string, int32_t x, int32_t y) { return drawString(string.c_str(), x, y, _textfont); }
+
+  uint16_t color565(uint8_t r, uint8_t g, uint8_t b) { return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3); }
+
+  // Host only: the picture as it stands, _width x _height RGB565 pixels, row by row
+  const uint16_t *frameBuffer() const { return _fb; }
+  uint16_t readPixel(int32_t x, int32_t y) const {
+    return x >= 0 && y >= 0 && x < _width && y < _height ? _fb[y * _width + x] : 0;
+  }
+
+private:
+  typedef struct {
+    int16_t height;
+    int16_t advance;
+    uint8_t sx, sy;                         // Scale of the 5x7 glyph
+  } font_metrics;
+
+  static const font_metrics &metrics(int16_t font) {
+    static const font_metrics FONTS[] = {
+      { 8, 6, 1, 1 },                       // 1: GLCD
+      { 16, 7, 1, 2 },                      // 2
+      { 26, 14, 2, 3 },                     // 4
+      { 48, 18, 3, 6 },                     // 6 and 7
+      { 75, 30, 5, 10 },                    // 8
+    };
+    switch (font) {
+      case 2: return FONTS[1];
+      case 4: return FONTS[2];
+      case 6: case 7: return FONTS[3];
+      case 8: return FONTS[4];
+      default: return FONTS[0];
+    }
+  }
+
+  static int32_t abs32(int32_t v) { return v < 0 ? -v : v; }
+  static void swap(int32_t &a, int32_t &b) { int32_t t = a; a = b; b = t; }
+
+  void run(bool steep, int32_t xs, int32_t y, int32_t len, uint32_t color) {
+    if (len == 1) {
+      steep ? drawPixel(y, xs, color) : drawPixel(xs, y, color);
+    } else {
+      steep ? drawFastVLine(y, xs, len, color) : drawFastHLine(xs, y, len, color);
+    }
+  }
+
+  void fill(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+    int32_t x1 = x < 0 ? 0 : x, y1 = y < 0 ? 0 : y;
+    int32_t x2 = x + w > _width ? _width : x + w, y2 = y + h > _height ? _height : y + h;
+    for (int32_t j = y1; j < y2; j++) {
+      for (int32_t i = x1; i < x2; i++) {
+        _fb[j * _width + i] = color;
+      }
+    }
+  }
+
+  // ASCII 0x20 - 0x7E, five columns each, bit 0 at the top
+  static constexpr uint8_t GLYPHS[95][5] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 },
+    { 0x14, 0x7F, 0x14, 0x7F, 0x14 }, { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+    { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 }, { 0x00, 0x1C, 0x22, 0x41, 0x00 },
+    { 0x00, 0x41, 0x22, 0x1C, 0x00 }, { 0x08, 0x2A, 0x1C, 0x2A, 0x08 }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+    { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 },
+    { 0x20, 0x10, 0x08, 0x04, 0x02 }, { 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 },
+    { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4B, 0x31 }, { 0x18, 0x14, 0x12, 0x7F, 0x10 },
+    { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+    { 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1E }, { 0x00, 0x36, 0x36, 0x00, 0x00 },
+    { 0x00, 0x56, 0x36, 0x00, 0x00 }, { 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },
+    { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 }, { 0x32, 0x49, 0x79, 0x41, 0x3E },
+    { 0x7E, 0x11, 0x11, 0x11, 0x7E }, { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+    { 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 }, { 0x7F, 0x09, 0x09, 0x01, 0x01 },
+    { 0x3E, 0x41, 0x41, 0x51, 0x32 }, { 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 },
+    { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 }, { 0x7F, 0x40, 0x40, 0x40, 0x40 },
+    { 0x7F, 0x02, 0x04, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+    { 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E }, { 0x7F, 0x09, 0x19, 0x29, 0x46 },
+    { 0x46, 0x49, 0x49, 0x49, 0x31 }, { 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F },
+    { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x7F, 0x20, 0x18, 0x20, 0x7F }, { 0x63, 0x14, 0x08, 0x14, 0x63 },
+    { 0x03, 0x04, 0x78, 0x04, 0x03 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7F, 0x41, 0x41, 0x00 },
+    { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7F, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 },
+    { 0x40, 0x40, 0x40, 0x40, 0x40 }, { 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 },
+    { 0x7F, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 }, { 0x38, 0x44, 0x44, 0x48, 0x7F },
+    { 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7E, 0x09, 0x01, 0x02 }, { 0x08, 0x14, 0x54, 0x54, 0x3C },
+    { 0x7F, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7D, 0x40, 0x00 }, { 0x20, 0x40, 0x44, 0x3D, 0x00 },
+    { 0x00, 0x7F, 0x10, 0x28, 0x44 }, { 0x00, 0x41, 0x7F, 0x40, 0x00 }, { 0x7C, 0x04, 0x18, 0x04, 0x78 },
+    { 0x7C, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 }, { 0x7C, 0x14, 0x14, 0x14, 0x08 },
+    { 0x08, 0x14, 0x14, 0x18, 0x7C }, { 0x7C, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },
+    { 0x04, 0x3F, 0x44, 0x40, 0x20 }, { 0x3C, 0x40, 0x40, 0x20, 0x7C }, { 0x1C, 0x20, 0x40, 0x20, 0x1C },
+    { 0x3C, 0x40, 0x30, 0x40, 0x3C }, { 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0C, 0x50, 0x50, 0x50, 0x3C },
+    { 0x44, 0x64, 0x54, 0x4C, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 }, { 0x00, 0x00, 0x7F, 0x00, 0x00 },
+    { 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x08, 0x04, 0x08, 0x10, 0x08 },
+  };
+
+  int16_t _init_width, _init_height;
+  int16_t _width, _height;
+  uint8_t _rotation = 0;
+  uint16_t _textcolor = TFT_WHITE, _textbgcolor = TFT_BLACK;
+  uint8_t _textdatum = TL_DATUM;
+  uint8_t _textfont = 1;
+  uint16_t _fb[TFT_WIDTH * TFT_HEIGHT] = {};
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+// Host stand-in for the Arduino String class, over std::string. Only what the firmware uses.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+class String {
+public:
+  String() {}
+  String(const char *s) : _s(s ? s : "") {}
+  String(const std::string &s) : _s(s) {}
+  explicit String(char c) : _s(1, c) {}
+  explicit String(int v) : _s(std::to_string(v)) {}
+  explicit String(unsigned int v) : _s(std::to_string(v)) {}
+  explicit String(long v) : _s(std::to_string(v)) {}
+  explicit String(unsigned long v) : _s(std::to_string(v)) {}
+  explicit String(float v, unsigned int decimals = 2) : String((double)v, decimals) {}
+  explicit String(double v, unsigned int decimals = 2) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    _s = buf;
+  }
+
+  const char *c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.length(); }
+  bool isEmpty() const { return _s.empty(); }
+  char charAt(unsigned int i) const { return i < _s.length() ? _s[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  void reserve(unsigned int n) { _s.reserve(n); }
+
+  String &operator+=(const String &o) { _s += o._s; return *this; }
+  String &operator+=(const char *o) { _s += o ? o : ""; return *this; }
+  String &operator+=(char c) { _s += c; return *this; }
+  String &operator+=(int v) { _s += std::to_string(v); return *this; }
+  String &operator+=(unsigned int v) { _s += std::to_string(v); return *this; }
+  String &operator+=(long v) { _s += std::to_string(v); return *this; }
+  String &operator+=(unsigned long v) { _s += std::to_string(v); return *this; }
+  String &operator+=(double v) { return *this += String(v); }
+  bool concat(const String &o) { *this += o; return true; }
+
+  bool operator==(const String &o) const { return _s == o._s; }
+  bool operator==(const char *o) const { return _s == (o ? o : ""); }
+  bool operator!=(const String &o) const { return !(*this == o); }
+  bool operator!=(const char *o) const { return !(*this == o); }
+  bool operator<(const String &o) const { return _s < o._s; }
+  bool equals(const String &o) const { return *this == o; }
+  bool equalsIgnoreCase(const String &o) const { return strcasecmp(c_str(), o.c_str()) == 0; }
+  bool startsWith(const String &o) const { return _s.compare(0, o._s.size(), o._s) == 0; }
+  bool endsWith(const String &o) const {
+    return _s.size() >= o._s.size() && _s.compare(_s.size() - o._s.size(), o._s.size(), o._s) == 0;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const { return found(_s.find(c, from)); }
+  int indexOf(const String &o, unsigned int from = 0) const { return found(_s.find(o._s, from)); }
+  int lastIndexOf(char c) const { return found(_s.rfind(c)); }
+  String substring(unsigned int from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    return from < to && from < _s.size() ? String(_s.substr(from, to - from)) : String();
+  }
+
+  void remove(unsigned int index) { if (index < _s.size()) _s.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < _s.size()) _s.erase(index, count); }
+  void trim() {
+    size_t a = 0, b = _s.size();
+    while (a < b && isspace((unsigned char)_s[a])) a++;
+    while (b > a && isspace((unsigned char)_s[b - 1])) b--;
+    _s = _s.substr(a, b - a);
+  }
+  void toUpperCase() { for (auto &c : _s) c = toupper((unsigned char)c); }
+  void toLowerCase() { for (auto &c : _s) c = tolower((unsigned char)c); }
+  void replace(const String &from, const String &to) {
+    for (size_t p = 0; !from._s.empty() && (p = _s.find(from._s, p)) != std::string::npos; p += to._s.size()) {
+      _s.replace(p, from._s.size(), to._s);
+    }
+  }
+  long toInt() const { return strtol(c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(c_str(), nullptr); }
+  double toDouble() const { return strtod(c_str(), nullptr); }
+
+private:
+  static int found(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+
+  std::string _s;
+};
+
+inline String operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, const char *b) { String r(a); r += b; return r; }
+inline String operator+(const char *a, const String &b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, char b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, int b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, unsigned int b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, long b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, unsigned long b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, double b) { String r(a); r += b; return r; }
+inline bool operator==(const char *a, const String &b) { return b == a; }
+inline bool operator!=(const char *a, const String &b) { return b != a; }
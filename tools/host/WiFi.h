@@ -0,0 +1,29 @@
+#pragma once
+
+// Host stand-in for the Arduino-ESP32 WiFi object: only the link figures the loop reads.
+// The replay simulator sets them from its network trace.
+
+#include "Arduino.h"
+
+class IPAddress {
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : _a{ a, b, c, d } {}
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _a[0], _a[1], _a[2], _a[3]);
+    return String(buf);
+  }
+
+private:
+  uint8_t _a[4];
+};
+
+class WiFiClass {
+public:
+  int8_t RSSI() { return rssi; }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+
+  int8_t rssi = -60;                        // Host only: what RSSI() reports
+};
+
+inline WiFiClass WiFi;
@@ -0,0 +1,71 @@
+// Host stand-ins for the modules that only make sense on the board: the backlight PWM, CPU
+// frequency scaling, crash reports and the two MQTT clients. They keep the interfaces of their
+// headers and do nothing, apart from counting the CPU boost time on the virtual clock, so the
+// loop runs on Linux as it would on a board with no MQTT broker and no collector configured.
+
+#include <Arduino.h>
+
+#include "backlight.h"
+#include "cpu_power.h"
+#include "crash_report.h"
+#include "mqtt_publish.h"
+#include "mqtt_source.h"
+#include "vclock.h"
+
+// ------------------------------------------------------------------------------------
+static int boost_depth = 0;
+static unsigned long boost_since;
+static uint32_t boost_ms = 0;
+static unsigned long power_since;
+static mqtt_stats mqtt_counters;
+static mqtt_source_stats source_counters;
+// ------------------------------------------------------------------------------------
+
+void backlightBegin() {}
+void backlightPoll() {}
+uint32_t backlightAverageDuty() { return 0; }
+
+void cpuPowerBegin() {
+  power_since = clockMillis();
+}
+
+void cpuBoostAcquire() {
+  if (boost_depth++ == 0) {
+    boost_since = clockMillis();
+  }
+}
+
+void cpuBoostRelease() {
+  if (--boost_depth == 0) {
+    boost_ms += clockMillis() - boost_since;
+  }
+}
+
+uint32_t cpuPowerBoostMs() { return boost_ms; }
+uint32_t cpuPowerIdleMs() { return clockMillis() - power_since - boost_ms; }
+uint32_t cpuPowerAverageMa() { return 0; }
+
+void crashTrace(trace_event, int32_t) {}
+void crashReportBegin() {}
+void crashReportPoll(bool) {}
+void crashReportSetCollector(const char *) {}
+
+void mqttBegin() {}
+void mqttPoll(bool) {}
+int mqttPublishQuotes() { return 0; }
+void mqttSetBroker(const char *, const char *, int) {}
+String mqttBroker() { return String(); }
+String mqttPrefix() { return String(); }
+int mqttQos() { return 0; }
+const mqtt_stats &mqttStats() { return mqtt_counters; }
+
+void mqttSourceBegin() {}
+void mqttSourcePoll(bool) {}
+bool mqttSourceActive() { return false; }
+void mqttSourceSubscribe(const char *const *, int) {}
+int mqttSourceTake(quote *, bool *, int64_t &) { return 0; }
+void mqttSourceSet(const char *, const char *, payload_format) {}
+String mqttSourceBroker() { return String(); }
+String mqttSourcePrefix() { return String(); }
+payload_format mqttSourceFormat() { return PAYLOAD_JSON; }
+const mqtt_source_stats &mqttSourceStats() { return source_counters; }
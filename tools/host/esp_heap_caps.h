@@ -0,0 +1,11 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF capability allocator: there is no PSRAM, every request is malloc
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+
+inline void *heap_caps_malloc(size_t size, uint32_t caps) { return caps & MALLOC_CAP_SPIRAM ? nullptr : malloc(size); }
@@ -0,0 +1,24 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF task watchdog and reset reason: nothing is watched, every boot
+// is a power-on
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_SW,
+  ESP_RST_PANIC,
+  ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT,
+  ESP_RST_WDT,
+} esp_reset_reason_t;
+
+inline esp_reset_reason_t esp_reset_reason() { return ESP_RST_POWERON; }
+inline esp_err_t esp_task_wdt_init(uint32_t, bool) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_add(void *) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_reset() { return ESP_OK; }
@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF high resolution timer: the monotonic clock, in µs
+
+#include <stdint.h>
+#include <time.h>
+
+inline int64_t esp_timer_get_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
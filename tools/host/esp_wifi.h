@@ -0,0 +1,43 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF Wi-Fi calls of src/wifi_power.cpp. The power save mode and the
+// listen interval are kept, so a host tool can see what the firmware asked the radio to do.
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+typedef enum { WIFI_IF_STA, WIFI_IF_AP } wifi_interface_t;
+
+typedef union {
+  struct {
+    uint16_t listen_interval;
+  } sta;
+} wifi_config_t;
+
+inline wifi_ps_type_t host_wifi_ps = WIFI_PS_MIN_MODEM;
+inline wifi_config_t host_wifi_config = {};
+inline uint32_t host_wifi_ps_changes = 0;
+
+inline esp_err_t esp_wifi_set_ps(wifi_ps_type_t type) {
+  host_wifi_ps_changes += type != host_wifi_ps;
+  host_wifi_ps = type;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_get_ps(wifi_ps_type_t *type) {
+  *type = host_wifi_ps;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_get_config(wifi_interface_t, wifi_config_t *conf) {
+  *conf = host_wifi_config;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_set_config(wifi_interface_t, wifi_config_t *conf) {
+  host_wifi_config = *conf;
+  return ESP_OK;
+}
@@ -0,0 +1,112 @@
+// Cost of keeping the chart pages up to date (src/lttb.cpp): a full downsampling of the
+// history against the incremental update done once per minute as new samples arrive, then the
+// chart page's own rotation (every symbol at every zoom in turn) through the series cache.
+//   g++ -O2 -I include -o lttb_bench tools/lttb_bench.cpp src/tsdb.cpp src/lttb.cpp
+//   ./lttb_bench [days] [columns]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <random>
+
+#include "../include/lttb.h"
+#include "../include/tsdb.h"
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  int days = argc > 1 ? atoi(argv[1]) : 5;
+  int columns = argc > 2 ? atoi(argv[2]) : 160;
+  const int MINUTES = 1440;
+  int samples = days * MINUTES;
+  uint32_t window = days * MINUTES * 60;
+
+  const int SYMBOLS = 3;                    // The default watchlist
+  if (!tsdbBegin(SYMBOLS, 8 * 1024 * 1024)) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  std::mt19937 rng(42);
+  std::normal_distribution<double> step(0.0, 1.0);
+  double p = 4500.0;
+  uint32_t t0 = 1700000000;
+  for (int i = 0; i < samples; i++) {
+    p = fmax(0.01, p + step(rng) * p * 0.0005);
+    tsdbAppend(0, t0 + i * 60, round(p * 100) / 100);
+  }
+  uint32_t now = t0 + samples * 60;
+
+  // Full rebuild, as without the cache
+  const int ROUNDS = 20;
+  double start = nowNs();
+  for (int r = 0; r < ROUNDS; r++) {
+    ChartCache chart(0, window, columns);
+    chart.update(now);
+  }
+  double full = (nowNs() - start) / ROUNDS;
+
+  // One new sample per minute, one update each
+  ChartCache chart(0, window, columns);
+  chart.update(now);
+  const int UPDATES = 600;
+  uint64_t scanned = 0;
+  start = nowNs();
+  for (int i = 0; i < UPDATES; i++) {
+    p = fmax(0.01, p + step(rng) * p * 0.0005);
+    tsdbAppend(0, now, round(p * 100) / 100);
+    now += 60;
+    chart.update(now);
+    scanned += chart.lastScanned();
+  }
+  double incremental = (nowNs() - start) / UPDATES;
+
+  printf("%d samples -> %d columns\n", samples, columns);
+  printf("full:        %8.1f us (%.0f samples/us)\n", full / 1e3, samples / (full / 1e3));
+  printf("incremental: %8.1f us, %.1f samples read per update\n", incremental / 1e3, (double)scanned / UPDATES);
+
+  // The chart page rotation as in drawChart(): next symbol each page cycle, next zoom after
+  // each pass, one sample per symbol and minute, through chartCacheFor() as on the device
+  const uint32_t ZOOM_WINDOW[] = { 2 * 3600, 24 * 3600, 5 * 24 * 3600 };
+  const int ZOOMS = 3;
+  const uint32_t CYCLE = 12;                // s per page cycle with the default pages
+  for (int s = 1; s < SYMBOLS; s++) {
+    for (int i = 0; i < samples; i++) {
+      tsdbAppend(s, now - (samples - i) * 60, 100.0 * s + i % 97);
+    }
+  }
+  const int PAGES = 3000;
+  int symbol = 0, zoom = 0;
+  uint32_t last_sample = now;
+  scanned = 0;
+  start = nowNs();
+  for (int i = 0; i < PAGES; i++) {
+    now += CYCLE;
+    while (now - last_sample >= 60) {
+      last_sample += 60;
+      for (int s = 0; s < SYMBOLS; s++) {
+        tsdbAppend(s, last_sample, 100.0 * s + i % 89);
+      }
+    }
+    ChartCache *cached = chartCacheFor(symbol, zoom, ZOOM_WINDOW[zoom], columns);
+    cached->update(now);
+    scanned += cached->lastScanned();
+    if (++symbol >= SYMBOLS) {
+      symbol = 0;
+      zoom = (zoom + 1) % ZOOMS;
+    }
+  }
+  double page = (nowNs() - start) / PAGES;
+  chart_cache_stats cs = chartCacheStats();
+  double hit_rate = 100.0 * cs.hits / (cs.hits + cs.misses);
+  printf("rotation:    %8.1f us, %.1f samples read per page, cache %u hits %u misses (%.1f%%)\n", page / 1e3,
+         (double)scanned / PAGES, cs.hits, cs.misses, hit_rate);
+  bool ok = cs.hits > 0 && cs.misses == (uint32_t)(SYMBOLS * ZOOMS);
+  printf("%-52s %s\n", "every (symbol, zoom) built once, then incremental", ok ? "ok" : "FAILED");
+  chartCacheClear();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+// Cost of turning one MQTT quote message into a quote (see src/quote_decode.cpp), JSON against
+// binary payloads, next to parsing the same quote out of a one symbol Yahoo response.
+//   g++ -O2 -I include -I .pio/libdeps/lilygo-t-dongle-s3/ArduinoJson/src -o mqtt_decode_bench
+//     tools/mqtt_decode_bench.cpp src/quote_decode.cpp src/quote_parser.cpp
+//   ./mqtt_decode_bench [messages]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "../include/quote_decode.h"
+#include "../include/quote_feed.h"
+#include "../include/quote_parser.h"
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  int messages = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  char json[128];
+  int json_len = snprintf(json, sizeof(json),
+                          "{\"p\":4512.34,\"pc\":4490.12,\"chg\":0.4949,\"open\":1,\"cur\":\"USD\",\"t\":1700000000}");
+  uint8_t binary[sizeof(feed_quote) + 3];
+  feed_quote fq = {};
+  memcpy(fq.symbol, "SPX", 3);
+  fq.price = 45123400;
+  fq.previousClose = 44901200;
+  fq.changeBp = 49;
+  fq.marketOpen = 1;
+  memcpy(binary, &fq, sizeof(fq));
+  memcpy(binary + sizeof(fq), "USD", 3);
+  char yahoo[512];
+  int yahoo_len = snprintf(yahoo, sizeof(yahoo),
+                           "{\"quoteResponse\":{\"result\":[{\"symbol\":\"^SPX\",\"currency\":\"USD\","
+                           "\"marketState\":\"REGULAR\",\"regularMarketPrice\":4512.34,"
+                           "\"regularMarketPreviousClose\":4490.12,\"regularMarketChangePercent\":0.4949}],"
+                           "\"error\":null}}");
+  const char *symbols[] = { "^SPX" };
+
+  quote q;
+  bool updated;
+  double sum = 0.0;
+  double start = nowNs();
+  for (int i = 0; i < messages; i++) {
+    json[7] = '0' + i % 10;                 // Keep the compiler from hoisting the work
+    if (!decodeQuote(PAYLOAD_JSON, (const uint8_t *)json, json_len, q)) {
+      printf("JSON decode failed\n");
+      return 1;
+    }
+    sum += q.current;
+  }
+  double json_ns = (nowNs() - start) / messages;
+
+  start = nowNs();
+  for (int i = 0; i < messages; i++) {
+    binary[8] = i & 0xFF;
+    if (!decodeQuote(PAYLOAD_BINARY, binary, sizeof(binary), q)) {
+      printf("binary decode failed\n");
+      return 1;
+    }
+    sum += q.current;
+  }
+  double binary_ns = (nowNs() - start) / messages;
+
+  int yahoo_messages = messages / 10;
+  start = nowNs();
+  for (int i = 0; i < yahoo_messages; i++) {
+    parseQuotes(yahoo, yahoo_len, symbols, 1, &q, &updated);
+    sum += q.current;
+  }
+  double yahoo_ns = (nowNs() - start) / yahoo_messages;
+
+  printf("%d messages (checksum %.0f)\n", messages, fmod(sum, 1000.0));
+  printf("binary (%2zu bytes): %8.1f ns per quote\n", sizeof(binary), binary_ns);
+  printf("json   (%2d bytes): %8.1f ns per quote, %.0fx binary\n", json_len, json_ns, json_ns / binary_ns);
+  printf("yahoo  (%d bytes): %8.1f ns per quote\n", yahoo_len, yahoo_ns);
+  return 0;
+}
@@ -0,0 +1,367 @@
+#!/usr/bin/env python3
+"""Minimal MQTT 3.1.1 broker standing in for Mosquitto, with publish rate statistics.
+
+    mqtt_standin.py [--port 1883]            # point the dongle at mqtt://<this host>:1883
+    mqtt_standin.py --bench [--symbols 64]   # publish rate benchmark against itself
+    mqtt_standin.py --ticks ^SPX,^NDX --feed /dev/ttyACM0 [--format binary] [--rate 10]
+
+It keeps retained messages, forwards publishes to subscribers (at QoS 0), answers QoS 1 with
+PUBACK and sends the will of clients that drop. Every --interval seconds it prints the message
+rate and how the messages arrived in batches (a burst with no gap over --gap ms is one batch,
+which for the dongle is one fetch cycle). No QoS 2, no persistence, no authentication.
+
+With --ticks it is also the market data bus for a dongle whose quote source is this broker: it
+publishes synthetic ticks for the given symbols under --prefix, reads the binary quote feed the
+dongle sends back over USB for each quote it applies, and reports the latency from publish to
+feed frame, which is the tick to pixel path minus the drawing.
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import struct
+import sys
+import threading
+import time
+import tty
+
+CONNECT, CONNACK, PUBLISH, PUBACK = 1, 2, 3, 4
+SUBSCRIBE, SUBACK, UNSUBSCRIBE, UNSUBACK = 8, 9, 10, 11
+PINGREQ, PINGRESP, DISCONNECT = 12, 13, 14
+
+
+def packet(kind, body, flags=0):
+    header = bytearray([kind << 4 | flags])
+    n = len(body)
+    while True:
+        byte, n = n % 128, n // 128
+        header.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(header) + body
+
+
+def utf8(text):
+    data = text.encode() if isinstance(text, str) else text
+    return struct.pack(">H", len(data)) + data
+
+
+def publish_packet(topic, payload, qos=0, retain=False, packet_id=1):
+    body = utf8(topic) + (struct.pack(">H", packet_id) if qos else b"") + payload
+    return packet(PUBLISH, body, qos << 1 | (1 if retain else 0))
+
+
+async def read_packet(reader):
+    first = (await reader.readexactly(1))[0]
+    length, shift = 0, 0
+    while True:
+        byte = (await reader.readexactly(1))[0]
+        length |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return first >> 4, first & 0x0F, await reader.readexactly(length)
+
+
+def read_string(body, pos):
+    n = struct.unpack_from(">H", body, pos)[0]
+    return body[pos + 2:pos + 2 + n], pos + 2 + n
+
+
+def matches(pattern, topic):
+    p, t = pattern.split("/"), topic.split("/")
+    for i, level in enumerate(p):
+        if level == "#":
+            return True
+        if i >= len(t) or (level != "+" and level != t[i]):
+            return False
+    return len(p) == len(t)
+
+
+class Stats:
+    def __init__(self, gap):
+        self.gap = gap
+        self.messages = self.bytes = 0
+        self.batches = []              # [messages, first, last]
+        self.last = 0.0
+
+    def add(self, size):
+        now = time.monotonic()
+        self.messages += 1
+        self.bytes += size
+        if self.batches and now - self.last <= self.gap:
+            self.batches[-1][0] += 1
+            self.batches[-1][2] = now
+        else:
+            self.batches.append([1, now, now])
+        self.last = now
+
+    def report(self, seconds):
+        batches, self.batches = self.batches, self.batches[-1:] if self.batches else []
+        if not batches:
+            print("no messages")
+            return
+        sizes = [b[0] for b in batches]
+        spreads = [(b[2] - b[1]) * 1000 for b in batches]
+        print(f"{self.messages / seconds:8.1f} msg/s {self.bytes / seconds:9.0f} B/s, "
+              f"{len(batches)} batches of {min(sizes)}-{max(sizes)} messages, "
+              f"spread up to {max(spreads):.1f} ms")
+        self.messages = self.bytes = 0
+
+
+class Broker:
+    def __init__(self, stats, verbose=False):
+        self.stats = stats
+        self.verbose = verbose
+        self.retained = {}
+        self.sessions = {}             # writer -> set of filters
+
+    def deliver(self, topic, payload, retain=False):
+        for writer, filters in self.sessions.items():
+            if any(matches(f, topic) for f in filters):
+                writer.write(publish_packet(topic, payload, retain=retain))
+
+    async def client(self, reader, writer):
+        will, clean = None, False
+        self.sessions[writer] = set()
+        try:
+            while True:
+                kind, flags, body = await read_packet(reader)
+                if kind == CONNECT:
+                    _, pos = read_string(body, 0)
+                    connect_flags = body[pos + 1]
+                    client_id, pos = read_string(body, pos + 4)
+                    if connect_flags & 0x04:
+                        will_topic, pos = read_string(body, pos)
+                        will_msg, pos = read_string(body, pos)
+                        will = (will_topic.decode(), will_msg, bool(connect_flags & 0x20))
+                    print(f"connect {client_id.decode()}", file=sys.stderr)
+                    writer.write(packet(CONNACK, b"\x00\x00"))
+                elif kind == PUBLISH:
+                    qos, retain = (flags >> 1) & 3, flags & 1
+                    topic, pos = read_string(body, 0)
+                    if qos:
+                        writer.write(packet(PUBACK, body[pos:pos + 2]))
+                        pos += 2
+                    topic, payload = topic.decode(), body[pos:]
+                    if retain:
+                        self.retained[topic] = payload
+                    self.stats.add(len(body))
+                    if self.verbose:
+                        print(f"{topic} {payload.decode(errors='replace')}")
+                    self.deliver(topic, payload)
+                elif kind == SUBSCRIBE:
+                    pos, granted = 2, b""
+                    while pos < len(body):
+                        topic_filter, pos = read_string(body, pos)
+                        self.sessions[writer].add(topic_filter.decode())
+                        granted += b"\x00"
+                        pos += 1
+                    writer.write(packet(SUBACK, body[:2] + granted))
+                    for topic, payload in self.retained.items():
+                        if any(matches(f, topic) for f in self.sessions[writer]):
+                            writer.write(publish_packet(topic, payload, retain=True))
+                elif kind == UNSUBSCRIBE:
+                    pos = 2
+                    while pos < len(body):
+                        topic_filter, pos = read_string(body, pos)
+                        self.sessions[writer].discard(topic_filter.decode())
+                    writer.write(packet(UNSUBACK, body[:2]))
+                elif kind == PINGREQ:
+                    writer.write(packet(PINGRESP, b""))
+                elif kind == DISCONNECT:
+                    clean = True
+                    break
+                await writer.drain()
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            del self.sessions[writer]
+            writer.close()
+            if will and not clean:
+                if will[2]:
+                    self.retained[will[0]] = will[1]
+                self.deliver(*will[:2])
+
+
+async def serve(args):
+    stats = Stats(args.gap / 1000)
+    broker = Broker(stats, args.verbose)
+    server = await asyncio.start_server(broker.client, args.host, args.port)
+    print(f"listening on {args.host}:{args.port}", file=sys.stderr)
+    if args.ticks:
+        asyncio.ensure_future(ticks(args, broker))
+    async with server:
+        while True:
+            await asyncio.sleep(args.interval)
+            stats.report(args.interval)
+
+
+FEED_HEADER = struct.Struct("<BBBBHIQ")
+FEED_QUOTE = struct.Struct("<8sqqiB")
+FEED_PRICE_SCALE = 10000
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xFFFF
+    return crc
+
+
+def read_feed(path, on_quote):
+    """Decode the dongle's binary quote feed (include/quote_feed.h), calling on_quote(price)."""
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    tty.setraw(fd)
+    buf = bytearray()
+    while True:
+        buf += os.read(fd, 4096)
+        while True:
+            start = buf.find(b"\xa5\x5a")
+            if start < 0:
+                del buf[:-1]           # Text between frames, keeping a possible first sync byte
+                break
+            del buf[:start]
+            if len(buf) < FEED_HEADER.size:
+                break
+            _, _, version, kind, length, _, _ = FEED_HEADER.unpack_from(buf)
+            if version != 1 or length > 64:
+                del buf[:1]
+                continue
+            end = FEED_HEADER.size + length + 2
+            if len(buf) < end:
+                break
+            frame = bytes(buf[:end])
+            del buf[:end]
+            if crc16(frame[2:-2]) == frame[-2] | frame[-1] << 8 and kind == 2:
+                on_quote(FEED_QUOTE.unpack_from(frame, FEED_HEADER.size)[1])
+
+
+async def ticks(args, broker):
+    """Publish ticks through the broker and time them until they come back on the feed."""
+    symbols = args.ticks.split(",")
+    sent, latencies, lock = {}, [], threading.Lock()
+
+    def on_quote(price):
+        now = time.monotonic()
+        with lock:
+            t = sent.pop(price, None)
+            if t is not None:
+                latencies.append(now - t)
+
+    threading.Thread(target=read_feed, args=(args.feed, on_quote), daemon=True).start()
+    seq, last_report = 0, time.monotonic()
+    while True:
+        for i, symbol in enumerate(symbols):
+            # A slow sawtooth, distinct per symbol, that the bad print filter lets through
+            k = seq % 20000
+            price = 1000 + 100 * i + 0.01 * (k if k < 10000 else 20000 - k)
+            fixed = round(price * FEED_PRICE_SCALE)
+            if args.format == "binary":
+                payload = FEED_QUOTE.pack(symbol.encode()[:8], fixed, 1000 * FEED_PRICE_SCALE,
+                                          round((price / 1000 - 1) * 10000), 1) + b"USD"
+            else:
+                payload = json.dumps({"p": round(price, 2), "pc": 1000, "open": 1, "cur": "USD"},
+                                     separators=(",", ":")).encode()
+            topic = f"{args.prefix}/{symbol}"
+            broker.retained[topic] = payload
+            with lock:
+                sent[fixed] = time.monotonic()
+            broker.deliver(topic, payload)
+        seq += 1
+        await asyncio.sleep(1 / args.rate)
+        if time.monotonic() - last_report >= args.interval:
+            with lock:
+                done = sorted(latencies)
+                latencies.clear()
+            last_report = time.monotonic()
+            if done:
+                print(f"{len(done)} ticks back on the feed, publish to feed p50 {done[len(done) // 2] * 1000:.1f} ms "
+                      f"p99 {done[len(done) * 99 // 100] * 1000:.1f} ms max {done[-1] * 1000:.1f} ms")
+
+
+async def connect(port, client_id):
+    reader, writer = await asyncio.open_connection("127.0.0.1", port)
+    body = utf8("MQTT") + bytes([4, 0x02]) + struct.pack(">H", 60) + utf8(client_id)
+    writer.write(packet(CONNECT, body))
+    await read_packet(reader)
+    return reader, writer
+
+
+async def bench(args):
+    stats = Stats(args.gap / 1000)
+    broker = Broker(stats)
+    server = await asyncio.start_server(broker.client, "127.0.0.1", 0)
+    port = server.sockets[0].getsockname()[1]
+
+    # A subscriber measures publish to delivery latency from the timestamp in the payload
+    sub_reader, sub_writer = await connect(port, "bench-sub")
+    sub_writer.write(packet(SUBSCRIBE, struct.pack(">H", 1) + utf8("bench/#") + b"\x00", 2))
+    await read_packet(sub_reader)
+    latencies = []
+
+    async def receive(total):
+        while len(latencies) < total:
+            kind, flags, body = await read_packet(sub_reader)
+            if kind == PUBLISH:
+                _, pos = read_string(body, 0)
+                latencies.append(time.perf_counter() - json.loads(body[pos:])["t"])
+
+    reader, writer = await connect(port, "bench-pub")
+    for qos in (0, 1):
+        latencies.clear()
+        total = args.cycles * args.symbols
+        receiver = asyncio.ensure_future(receive(total))
+        start = time.perf_counter()
+        packet_id = 0
+        for _ in range(args.cycles):
+            for s in range(args.symbols):
+                packet_id = packet_id % 65535 + 1
+                payload = json.dumps({"p": 4512.34 + s, "pc": 4490.12, "chg": 0.4877, "open": 1,
+                                      "cur": "USD", "t": time.perf_counter()},
+                                     separators=(",", ":")).encode()
+                writer.write(publish_packet(f"bench/SYM{s}", payload, qos, True, packet_id))
+            await writer.drain()
+            if qos:
+                for _ in range(args.symbols):
+                    await read_packet(reader)
+        await receiver
+        elapsed = time.perf_counter() - start
+        latencies.sort()
+        print(f"QoS {qos}: {total} messages in {elapsed * 1000:.0f} ms, {total / elapsed:.0f} msg/s, "
+              f"latency p50 {latencies[len(latencies) // 2] * 1e6:.0f} us "
+              f"p99 {latencies[len(latencies) * 99 // 100] * 1e6:.0f} us")
+    writer.write(packet(DISCONNECT, b""))
+    sub_writer.write(packet(DISCONNECT, b""))
+    server.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--interval", type=float, default=10, help="seconds between reports")
+    parser.add_argument("--gap", type=float, default=200, help="ms of silence that ends a batch")
+    parser.add_argument("--verbose", action="store_true", help="print every message")
+    parser.add_argument("--bench", action="store_true", help="run the publish rate benchmark and exit")
+    parser.add_argument("--ticks", help="comma separated symbols to publish ticks for")
+    parser.add_argument("--feed", help="tty of the dongle's binary quote feed (with --ticks)")
+    parser.add_argument("--prefix", default="market/quotes", help="topic prefix of the ticks")
+    parser.add_argument("--format", choices=("json", "binary"), default="json", help="payload of the ticks")
+    parser.add_argument("--rate", type=float, default=10, help="ticks per second per symbol")
+    parser.add_argument("--symbols", type=int, default=64, help="messages per batch (--bench)")
+    parser.add_argument("--cycles", type=int, default=200, help="batches (--bench)")
+    args = parser.parse_args()
+    if args.ticks and not args.feed:
+        parser.error("--ticks needs --feed")
+    try:
+        asyncio.get_event_loop().run_until_complete(bench(args) if args.bench else serve(args))
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
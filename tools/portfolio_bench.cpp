@@ -0,0 +1,109 @@
+// Cost of keeping the portfolio P&L (src/portfolio.cpp) up to date as quotes arrive, against
+// recomputing every position, and a check that the incremental totals match the full ones.
+//   g++ -O2 -I include -D PORTFOLIO_MAX=512 -o portfolio_bench tools/portfolio_bench.cpp src/portfolio.cpp
+//   ./portfolio_bench [positions] [symbols]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <random>
+#include <vector>
+
+#include "../include/portfolio.h"
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static const char *CURRENCIES[] = { "USD", "EUR", "GBP" };
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 500;
+  int symbols = argc > 2 ? atoi(argv[2]) : 50;
+  if (count > PORTFOLIO_MAX || symbols > PORTFOLIO_SERIES) {
+    fprintf(stderr, "at most %d positions (build with -D PORTFOLIO_MAX=...) and %d symbols\n", PORTFOLIO_MAX, PORTFOLIO_SERIES);
+    return 1;
+  }
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> pick(0, symbols - 1);
+  std::uniform_real_distribution<double> qty(1, 500);
+  std::normal_distribution<double> step(0.0, 1.0);
+
+  std::vector<int> series(count);
+  std::vector<double> price(symbols), close(symbols);
+  for (int s = 0; s < symbols; s++) {
+    close[s] = price[s] = 10.0 + s * 13.7;
+  }
+
+  portfolioClear();
+  for (int i = 0; i < count; i++) {
+    position p;
+    memset(&p, 0, sizeof(p));
+    series[i] = pick(rng);
+    snprintf(p.symbol, sizeof(p.symbol), "SYM%d", series[i]);
+    strcpy(p.currency, CURRENCIES[series[i] % 3]);
+    p.quantity = (int64_t)llround(qty(rng) * PORTFOLIO_SCALE);
+    p.cost = (int64_t)llround(price[series[i]] * (0.8 + 0.4 * (i % 7) / 6.0) * PORTFOLIO_SCALE);
+    portfolioAdd(p, series[i]);
+  }
+  for (int s = 0; s < symbols; s++) {
+    portfolioUpdate(s, price[s], close[s]);
+  }
+
+  // A poll: every symbol gets a quote, a third of them moved
+  const int POLLS = 2000;
+  uint32_t before = portfolioTouched();
+  double start = nowNs();
+  for (int r = 0; r < POLLS; r++) {
+    for (int s = r % 3; s < symbols; s += 3) {
+      price[s] = fmax(0.01, round((price[s] + step(rng) * price[s] * 0.001) * 100) / 100);
+    }
+    for (int s = 0; s < symbols; s++) {
+      portfolioUpdate(s, price[s], close[s]);
+    }
+  }
+  double incremental = (nowNs() - start) / POLLS;
+  double per_poll = (double)(portfolioTouched() - before) / POLLS;
+
+  // Full recomputation of every position, as without the engine
+  int64_t value[PORTFOLIO_CURRENCIES] = {}, cost[PORTFOLIO_CURRENCIES] = {}, day[PORTFOLIO_CURRENCIES] = {};
+  auto scaled = [](int64_t a, int64_t b) {
+    int64_t p = a * b;
+    return (p >= 0 ? p + PORTFOLIO_SCALE / 2 : p - PORTFOLIO_SCALE / 2) / PORTFOLIO_SCALE;
+  };
+  start = nowNs();
+  for (int r = 0; r < POLLS; r++) {
+    memset(value, 0, sizeof(value));
+    memset(cost, 0, sizeof(cost));
+    memset(day, 0, sizeof(day));
+    for (int i = 0; i < count; i++) {
+      const position &p = portfolioPosition(i);
+      int c = 0;
+      while (strcmp(portfolioTotal(c).currency, p.currency) != 0) c++;
+      int64_t pr = (int64_t)llround(price[series[i]] * PORTFOLIO_SCALE);
+      int64_t cl = (int64_t)llround(close[series[i]] * PORTFOLIO_SCALE);
+      value[c] += scaled(p.quantity, pr);
+      cost[c] += scaled(p.quantity, p.cost);
+      day[c] += scaled(p.quantity, pr - cl);
+    }
+  }
+  double full = (nowNs() - start) / POLLS;
+
+  int mismatches = 0;
+  printf("%d positions over %d symbols\n", count, symbols);
+  for (int c = 0; c < portfolioCurrencies(); c++) {
+    const portfolio_total &t = portfolioTotal(c);
+    if (t.value != value[c] || t.cost != cost[c] || t.dayPnl != day[c]) mismatches++;
+    printf("  %s  value %14.4f  day %+12.4f  total %+14.4f\n", t.currency, (double)t.value / PORTFOLIO_SCALE,
+           (double)t.dayPnl / PORTFOLIO_SCALE, (double)(t.value - t.cost) / PORTFOLIO_SCALE);
+  }
+  printf("incremental: %8.2f us per poll, %.0f positions touched\n", incremental / 1e3, per_poll);
+  printf("full:        %8.2f us per poll\n", full / 1e3);
+  printf("totals %s the full recomputation\n", mismatches == 0 ? "match" : "DO NOT match");
+  return mismatches == 0 ? 0 : 1;
+}
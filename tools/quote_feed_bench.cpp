@@ -0,0 +1,103 @@
+// Throughput and latency of the feed decoder over a pseudo-terminal standing in for the CDC port.
+//   g++ -O2 -o quote_feed_bench tools/quote_feed_bench.cpp
+//   ./quote_feed_bench [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "quote_feed_client.h"
+
+static uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  long frames = argc > 1 ? atol(argv[1]) : 200000;
+
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) || unlockpt(master)) {
+    perror("pty");
+    return 1;
+  }
+  struct termios tio;
+  tcgetattr(master, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(master, TCSANOW, &tio);
+
+  QuoteFeedClient feed;
+  if (!feed.open(ptsname(master))) {
+    perror("ptsname");
+    return 1;
+  }
+
+  // Pure decode cost, no I/O
+  feed_quote q = { "SPX", 45123400, 44987600, 30, 1 };
+  uint8_t frame[FEED_MAX_FRAME];
+  size_t n = feedEncode(frame, FEED_QUOTE, 0, 0, &q, sizeof(q));
+  FeedDecoder dec;
+  uint64_t t0 = nowNs();
+  long ok = 0;
+  for (long i = 0; i < frames; i++) {
+    for (size_t j = 0; j < n; j++) ok += dec.push(frame[j]);
+  }
+  uint64_t t1 = nowNs();
+  printf("decode:   %.1f ns/frame, %.1f MB/s (%ld frames)\n",
+         (double)(t1 - t0) / frames, (double)frames * n * 1000.0 / (t1 - t0), ok);
+
+  // Resync: a frame whose length byte was corrupted swallows the frame after it as payload;
+  // that one must still come out once the bad frame fails its CRC
+  uint8_t stream[FEED_MAX_FRAME * 3];
+  size_t sn = feedEncode(stream, FEED_QUOTE, 1, 0, &q, sizeof(q));
+  stream[4] = FEED_MAX_PAYLOAD;
+  sn += feedEncode(stream + sn, FEED_QUOTE, 2, 0, &q, sizeof(q));
+  sn += feedEncode(stream + sn, FEED_QUOTE, 3, 0, &q, sizeof(q));
+  FeedDecoder resync;
+  uint32_t seqs = 0;
+  for (size_t j = 0; j < sn; j++) {
+    if (resync.push(stream[j])) seqs = seqs * 10 + resync.header().seq;
+  }
+  while (resync.next()) seqs = seqs * 10 + resync.header().seq;
+  printf("resync:   frames %u after a corrupted length, %u bad %s\n", seqs, resync.badFrames(),
+         seqs == 23 ? "ok" : "FAILED");
+
+  // Round trip latency: write one frame, wait until the client hands it back
+  const long rounds = frames / 100 > 0 ? frames / 100 : 1;
+  uint64_t worst = 0, total = 0;
+  for (long i = 0; i < rounds; i++) {
+    uint64_t start = nowNs();
+    n = feedEncode(frame, FEED_QUOTE, i, start / 1000, &q, sizeof(q));
+    if (write(master, frame, n) != (ssize_t)n) break;
+    int got = 0;
+    while (got == 0) got = feed.poll([](const feed_header &, const feed_quote &) {}, 100);
+    uint64_t lat = nowNs() - start;
+    total += lat;
+    if (lat > worst) worst = lat;
+  }
+  printf("latency:  %.1f us avg, %.1f us worst (%ld round trips)\n",
+         total / 1000.0 / rounds, worst / 1000.0, rounds);
+
+  // Throughput: a writer burst of back-to-back frames drained by the client
+  uint8_t burst[FEED_MAX_FRAME * 64];
+  size_t bn = 0;
+  for (int i = 0; i < 64; i++) bn += feedEncode(burst + bn, FEED_QUOTE, i, 0, &q, sizeof(q));
+  long received = 0, sent = 0;
+  t0 = nowNs();
+  while (sent < frames) {
+    if (write(master, burst, bn) == (ssize_t)bn) sent += 64;
+    int r;
+    while ((r = feed.poll([](const feed_header &, const feed_quote &) {}, 0)) > 0) received += r;
+  }
+  while (received < sent) {
+    int r = feed.poll([](const feed_header &, const feed_quote &) {}, 100);
+    if (r <= 0) break;
+    received += r;
+  }
+  t1 = nowNs();
+  printf("pty:      %.0f frames/s (%ld of %ld received)\n",
+         received * 1e9 / (t1 - t0), received, sent);
+  close(master);
+  return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Reference Linux client for the T-Dongle-S3 binary quote feed.
+// Opens the CDC tty in raw mode and hands every decoded quote to a callback.
+//
+//   QuoteFeedClient feed;
+//   if (!feed.open("/dev/ttyACM0")) ...
+//   feed.poll([](const feed_header &h, const feed_quote &q) { ... }, 100);
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "../include/quote_feed.h"
+
+class QuoteFeedClient {
+public:
+  ~QuoteFeedClient() { close(); }
+
+  // Open a tty (or pty) in raw, non-blocking mode
+  bool open(const char *path) {
+    _fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (_fd < 0) return false;
+    _haveSeq = false;                       // A new port starts a new sequence
+    _lastSeq = 0;
+    struct termios tio;
+    if (tcgetattr(_fd, &tio) == 0) {
+      cfmakeraw(&tio);
+      tcsetattr(_fd, TCSANOW, &tio);
+    }
+    return true;
+  }
+
+  void close() {
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+  }
+
+  // Wait up to timeout_ms for data and dispatch every complete quote frame.
+  // Returns the number of quotes delivered, or -1 on a read error / closed port.
+  template <typename Callback>
+  int poll(Callback on_quote, int timeout_ms) {
+    struct pollfd pfd = { _fd, POLLIN, 0 };
+    if (::poll(&pfd, 1, timeout_ms) <= 0) return 0;
+
+    uint8_t buf[4096];
+    ssize_t n = ::read(_fd, buf, sizeof(buf));
+    if (n <= 0) return -1;
+
+    int delivered = 0;
+    for (ssize_t i = 0; i < n; i++) {
+      if (_decoder.push(buf[i])) delivered += dispatch(on_quote);
+    }
+    while (_decoder.next()) delivered += dispatch(on_quote);   // Found behind a corrupted frame
+    return delivered;
+  }
+
+  int fd() const { return _fd; }
+  uint32_t droppedFrames() const { return _gaps; }   // Sequence gaps seen so far
+  uint32_t badFrames() const { return _decoder.badFrames(); }
+
+private:
+  // Hand the decoder's current frame to on_quote if it is a quote. Returns 1 if it was.
+  template <typename Callback>
+  int dispatch(Callback &on_quote) {
+    const feed_header &hdr = _decoder.header();
+    // The device restarted (seq is back at 0 after a HELLO): resync rather than count a gap
+    if (hdr.type == FEED_HELLO || (_haveSeq && hdr.seq <= _lastSeq)) _haveSeq = false;
+    if (_haveSeq && hdr.seq != _lastSeq + 1) _gaps += hdr.seq - _lastSeq - 1;
+    _lastSeq = hdr.seq;
+    _haveSeq = true;
+    if (hdr.type != FEED_QUOTE || hdr.length < sizeof(feed_quote)) return 0;
+    feed_quote q;
+    memcpy(&q, _decoder.payload(), sizeof(q));
+    on_quote(hdr, q);
+    return 1;
+  }
+
+  int _fd = -1;
+  FeedDecoder _decoder;
+  bool _haveSeq = false;
+  uint32_t _lastSeq = 0;
+  uint32_t _gaps = 0;
+};
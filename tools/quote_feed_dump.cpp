@@ -0,0 +1,31 @@
+// Print the quotes streamed by the dongle.
+//   g++ -O2 -o quote_feed_dump tools/quote_feed_dump.cpp
+//   ./quote_feed_dump /dev/ttyACM0
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "quote_feed_client.h"
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : "/dev/ttyACM0";
+  QuoteFeedClient feed;
+  if (!feed.open(path)) {
+    perror(path);
+    return 1;
+  }
+
+  for (;;) {
+    int r = feed.poll([](const feed_header &h, const feed_quote &q) {
+      printf("%10" PRIu32 " %14" PRIu64 " %-8.8s %12.4f %12.4f %+7.2f%% %s\n",
+             h.seq, h.timestamp_us, q.symbol,
+             (double)q.price / FEED_PRICE_SCALE, (double)q.previousClose / FEED_PRICE_SCALE,
+             q.changeBp / 100.0, q.marketOpen ? "open" : "closed");
+      fflush(stdout);
+    }, 1000);
+    if (r < 0) break;
+  }
+  fprintf(stderr, "port closed (%" PRIu32 " dropped, %" PRIu32 " bad frames)\n",
+          feed.droppedFrames(), feed.badFrames());
+  return 0;
+}
@@ -0,0 +1,61 @@
+// libFuzzer target for the binary feed decoder (FeedDecoder in include/quote_feed.h). The input
+// is a byte stream as it could come off the tty: every frame the decoder hands out must be in
+// it verbatim with a good CRC, and once the stream is flushed with zeros a good frame sent after
+// it must come out at once, however the stream before it was corrupted.
+//   clang++ -g -O1 -fsanitize=fuzzer,address,undefined -I include -o quote_feed_fuzz
+//     tools/quote_feed_fuzz.cpp
+//   ./quote_feed_fuzz tools/corpus/quote_feed
+// Without libFuzzer (g++), add -D FUZZ_MAIN and drop "fuzzer," to replay the corpus or a crash.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../include/quote_feed.h"
+
+static void check(bool ok) {
+  if (!ok) {
+    abort();
+  }
+}
+
+// The frame the decoder holds now is a good one, present in the stream
+static void checkFrame(const FeedDecoder &dec, const std::vector<uint8_t> &stream) {
+  const feed_header &h = dec.header();
+  check(h.sync0 == FEED_SYNC0 && h.sync1 == FEED_SYNC1 && h.version == FEED_VERSION);
+  check(h.length <= FEED_MAX_PAYLOAD);
+  uint8_t frame[FEED_MAX_FRAME];
+  size_t n = feedEncode(frame, h.type, h.seq, h.timestamp_us, dec.payload(), h.length);
+  check(memmem(stream.data(), stream.size(), frame, n) != nullptr);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  // Any frame begun in the input is complete after FEED_MAX_FRAME more bytes
+  std::vector<uint8_t> stream(data, data + size);
+  stream.resize(size + FEED_MAX_FRAME, 0);
+
+  FeedDecoder dec;
+  for (size_t i = 0; i < stream.size(); i++) {
+    if (dec.push(stream[i])) {
+      checkFrame(dec, stream);
+    }
+  }
+  while (dec.next()) {
+    checkFrame(dec, stream);
+  }
+
+  feed_quote q = { "SPX", 45123400, 44987600, 30, 1 };
+  uint8_t frame[FEED_MAX_FRAME];
+  size_t n = feedEncode(frame, FEED_QUOTE, 0xC0FFEE, 1, &q, sizeof(q));
+  for (size_t i = 0; i < n; i++) {
+    check(dec.push(frame[i]) == (i == n - 1));
+  }
+  check(dec.header().seq == 0xC0FFEE && memcmp(dec.payload(), &q, sizeof(q)) == 0);
+  check(!dec.next());
+  return 0;
+}
+
+#ifdef FUZZ_MAIN
+#include "fuzz_main.h"
+#endif
@@ -0,0 +1,88 @@
+// Runs the quote filter (src/quote_filter.cpp) over synthetic streams with known corruption and
+// reports what it caught. Exits non-zero if a bad print got through or too many good ticks were
+// rejected.
+//   g++ -O2 -I include -o quote_filter_check tools/quote_filter_check.cpp src/quote_filter.cpp
+//   ./quote_filter_check [ticks]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <random>
+
+#include "../include/quote_filter.h"
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef enum { GOOD, ZERO, NOT_A_NUMBER, SPIKE_UP, SPIKE_DOWN, SPIKE_SMALL, BAD_CLOSE, KINDS } tick_kind;
+static const char *KIND_NAMES[KINDS] = { "good", "zero", "NaN", "spike x10", "spike /10", "spike 15%", "bad close" };
+
+int main(int argc, char **argv) {
+  int ticks = argc > 1 ? atoi(argv[1]) : 200000;
+  const int SERIES = 8;
+  std::mt19937 rng(7);
+  std::normal_distribution<double> step(0.0, 1.0);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  double price[SERIES], close[SERIES];
+  for (int s = 0; s < SERIES; s++) {
+    close[s] = price[s] = 50.0 + 700.0 * s;
+  }
+
+  uint32_t seen[KINDS] = {}, passed[KINDS] = {};
+  int shifts = 0;
+  double filter_ns = 0;
+  for (int i = 0; i < ticks; i++) {
+    int s = i % SERIES;
+    if (i % (SERIES * 2000) < SERIES) {
+      close[s] = price[s];                // A new trading day
+    }
+    // Random walk with a few percent of corrupt ticks, and now and then a real 3% jump
+    price[s] *= 1.0 + step(rng) * 0.0003;
+    if (uniform(rng) < 0.0005) {
+      price[s] *= uniform(rng) < 0.5 ? 1.03 : 0.97;
+      shifts++;
+    }
+    quote q = { price[s], close[s], (price[s] / close[s] - 1) * 100, true, "USD" };
+    double r = uniform(rng);
+    tick_kind kind = r < 0.01 ? ZERO : r < 0.02 ? NOT_A_NUMBER : r < 0.03 ? SPIKE_UP : r < 0.04 ? SPIKE_DOWN :
+                     r < 0.05 ? SPIKE_SMALL : r < 0.055 ? BAD_CLOSE : GOOD;
+    switch (kind) {
+      case ZERO: q.current = 0.0; break;
+      case NOT_A_NUMBER: q.current = NAN; break;
+      case SPIKE_UP: q.current *= 10.0; break;
+      case SPIKE_DOWN: q.current /= 10.0; break;
+      case SPIKE_SMALL: q.current *= uniform(rng) < 0.5 ? 1.15 : 1 / 1.15; break;
+      case BAD_CLOSE: q.previousClose = 0.0; break;
+      default: break;
+    }
+
+    double start = nowNs();
+    filter_result result = quoteFilter(s, q);
+    filter_ns += nowNs() - start;
+    seen[kind]++;
+    if (result == FILTER_OK) {
+      passed[kind]++;
+    }
+  }
+
+  filter_stats st = quoteFilterStats();
+  printf("%d ticks over %d series, %d real jumps, %.0f ns per tick\n", ticks, SERIES, shifts, filter_ns / ticks);
+  for (int k = 0; k < KINDS; k++) {
+    printf("  %-10s %7u seen, %7u passed\n", KIND_NAMES[k], seen[k], passed[k]);
+  }
+  printf("rejected: invalid %u, bounds %u, spike %u; level shifts %u\n", st.rejected[FILTER_INVALID],
+         st.rejected[FILTER_BOUNDS], st.rejected[FILTER_SPIKE], st.levelShifts);
+
+  uint32_t bad_passed = 0;
+  for (int k = GOOD + 1; k < KINDS; k++) {
+    bad_passed += passed[k];
+  }
+  double good_rejected = 1.0 - (double)passed[GOOD] / seen[GOOD];
+  printf("bad ticks passed: %u, good ticks rejected: %.3f%%\n", bad_passed, good_rejected * 100);
+  return bad_passed == 0 && good_rejected < 0.005 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+// libFuzzer target for the quote response parser (src/quote_parser.cpp). Every input is parsed
+// as a Yahoo response for a fixed set of symbols, with and without the reference data, and the
+// quotes it claims to have updated are checked to be usable: finite prices, a change that is
+// finite whenever the previous close is, terminated strings, an ordered 52-week range.
+//   clang++ -g -O1 -fsanitize=fuzzer,address,undefined -I include
+//     -I .pio/libdeps/lilygo-t-dongle-s3/ArduinoJson/src -o quote_parser_fuzz
+//     tools/quote_parser_fuzz.cpp src/quote_parser.cpp
+//   ./quote_parser_fuzz -max_len=65536 tools/corpus/quote_parser
+// Without libFuzzer (g++), add -D FUZZ_MAIN and drop "fuzzer," to replay the corpus or a crash.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/quote_parser.h"
+
+static const char *const SYMBOLS[] = { "^GSPC", "^NDX", "^TNX", "EURUSD=X", "VOD.L" };
+const int SYMBOL_COUNT = sizeof(SYMBOLS) / sizeof(SYMBOLS[0]);
+
+static void check(bool ok) {
+  if (!ok) {
+    abort();
+  }
+}
+
+static bool terminated(const char *text, size_t size) {
+  return memchr(text, '\0', size) != nullptr;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  quote out[SYMBOL_COUNT];
+  reference refs[SYMBOL_COUNT];
+  bool updated[SYMBOL_COUNT];
+  const char *payload = (const char *)data;
+
+  for (int pass = 0; pass < 2; pass++) {
+    memset(out, 0xA5, sizeof(out));
+    memset(refs, 0xA5, sizeof(refs));
+    parse_status status = parseQuotes(payload, size, SYMBOLS, SYMBOL_COUNT, out, updated, pass ? refs : nullptr);
+    check(parseStatusName(status) != nullptr);
+
+    int found = 0;
+    for (int i = 0; i < SYMBOL_COUNT; i++) {
+      if (!updated[i]) {
+        continue;
+      }
+      found++;
+      const quote &q = out[i];
+      check(isfinite(q.current));
+      check(isnan(q.previousClose) || isfinite(q.previousClose));
+      check(isfinite(q.percentageChange) || (isnan(q.percentageChange) && isnan(q.previousClose)));
+      check(terminated(q.currency, sizeof(q.currency)));
+      if (pass) {
+        const reference &r = refs[i];
+        check(isnan(r.previousClose) || isfinite(r.previousClose));
+        check(isnan(r.yearLow) == isnan(r.yearHigh));
+        check(isnan(r.yearLow) || r.yearLow <= r.yearHigh);
+        check(terminated(r.currency, sizeof(r.currency)));
+        check(terminated(r.timezone, sizeof(r.timezone)));
+      }
+    }
+    check(status == PARSE_OK ? found == SYMBOL_COUNT : status == PARSE_PARTIAL ? found > 0 && found < SYMBOL_COUNT
+                                                                                : found == 0);
+  }
+  return 0;
+}
+
+#ifdef FUZZ_MAIN
+#include "fuzz_main.h"
+#endif
@@ -0,0 +1,289 @@
+// Golden image check of the page renderers. The pages are built for the host against the
+// framebuffer TFT_eSPI in tools/host, drawn in fixed states (up, down, flat and closed quotes,
+// range bars, the portal banner, heatmap, portfolio with and without every FX rate, chart and
+// candles, and the partial redraws that follow a new quote) and compared pixel for pixel with
+// tools/golden/*.ppm. The draw calls and pixels CountingTFT counted for each state are compared
+// with tools/golden/render_counts.txt, so a change that draws the same picture with more work
+// shows up too.
+// On a mismatch the frame is written next to the golden as <name>.actual.ppm, with a
+// <name>.diff.ppm that shows the differing pixels in magenta.
+//   g++ -O2 -D VIRTUAL_CLOCK -I tools/host -I include -o render_golden tools/render_golden.cpp
+//       src/text_page.cpp src/heatmap_page.cpp src/portfolio_page.cpp src/chart_page.cpp
+//       src/candle_page.cpp src/render_stats.cpp src/tsdb.cpp src/lttb.cpp src/candles.cpp
+//       src/portfolio.cpp src/fx.cpp src/ref_data.cpp src/watchlist.cpp src/vclock.cpp src/log.cpp
+//       src/health.cpp -lpthread
+//   ./render_golden [--update] [golden dir, default tools/golden]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "candle_page.h"
+#include "candles.h"
+#include "chart_page.h"
+#include "display.h"
+#include "fx.h"
+#include "heatmap_page.h"
+#include "portfolio.h"
+#include "portfolio_page.h"
+#include "ref_data.h"
+#include "text_page.h"
+#include "tsdb.h"
+#include "vclock.h"
+#include "watchlist.h"
+
+CountingTFT tft;
+const char *PORTAL_AP_NAME = "T-Dongle-S3";
+
+static std::string dir = "tools/golden";
+static bool update = false;
+static int failures = 0;
+static std::map<std::string, std::string> counts;      // Name to "calls pixels", from the file
+
+static quote makeQuote(double current, double previous_close, bool open, const char *currency) {
+  quote q = {};
+  q.current = current;
+  q.previousClose = previous_close;
+  q.percentageChange = (current / previous_close - 1.0) * 100.0;
+  q.marketOpen = open;
+  snprintf(q.currency, sizeof(q.currency), "%s", currency);
+  return q;
+}
+
+static std::vector<uint8_t> toRgb(const uint16_t *fb, int n) {
+  std::vector<uint8_t> rgb(n * 3);
+  for (int i = 0; i < n; i++) {
+    uint16_t c = fb[i];
+    rgb[i * 3] = ((c >> 11) & 0x1F) * 255 / 31;
+    rgb[i * 3 + 1] = ((c >> 5) & 0x3F) * 255 / 63;
+    rgb[i * 3 + 2] = (c & 0x1F) * 255 / 31;
+  }
+  return rgb;
+}
+
+static bool writePpm(const std::string &path, int w, int h, const std::vector<uint8_t> &rgb) {
+  FILE *f = fopen(path.c_str(), "wb");
+  if (f == nullptr) {
+    return false;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", w, h);
+  bool ok = fwrite(rgb.data(), 1, rgb.size(), f) == rgb.size();
+  return fclose(f) == 0 && ok;
+}
+
+static bool readPpm(const std::string &path, int w, int h, std::vector<uint8_t> &rgb) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  int fw, fh, max;
+  bool ok = fscanf(f, "P6 %d %d %d", &fw, &fh, &max) == 3 && fgetc(f) != EOF && fw == w && fh == h && max == 255;
+  rgb.resize(w * h * 3);
+  ok = ok && fread(rgb.data(), 1, rgb.size(), f) == rgb.size();
+  fclose(f);
+  return ok;
+}
+
+// Compare what is on the screen with the golden of name, and the counts of the last frame
+static void check(const char *name) {
+  renderFrameEnd();
+  int w = tft.width(), h = tft.height();
+  std::vector<uint8_t> actual = toRgb(tft.frameBuffer(), w * h), golden;
+  char drawn[32];
+  snprintf(drawn, sizeof(drawn), "%u %u", render_frame.calls, render_frame.pixels);
+  std::string path = dir + "/" + name + ".ppm";
+  if (update) {
+    writePpm(path, w, h, actual);
+    counts[name] = drawn;
+    printf("%-20s %5u calls %6u pixels  written\n", name, render_frame.calls, render_frame.pixels);
+    return;
+  }
+
+  int differing = -1;
+  if (readPpm(path, w, h, golden)) {
+    std::vector<uint8_t> diff(actual.size() / 3 * 3, 0);
+    differing = 0;
+    for (size_t i = 0; i < actual.size(); i += 3) {
+      bool same = memcmp(&actual[i], &golden[i], 3) == 0;
+      differing += !same;
+      diff[i] = same ? actual[i] / 4 : 255;
+      diff[i + 1] = same ? actual[i + 1] / 4 : 0;
+      diff[i + 2] = same ? actual[i + 2] / 4 : 255;
+    }
+    if (differing > 0) {
+      writePpm(dir + "/" + name + ".actual.ppm", w, h, actual);
+      writePpm(dir + "/" + name + ".diff.ppm", w, h, diff);
+    }
+  }
+  bool same_counts = counts.count(name) && counts[name] == drawn;
+  bool ok = differing == 0 && same_counts;
+  printf("%-20s %5u calls %6u pixels  ", name, render_frame.calls, render_frame.pixels);
+  if (differing < 0) {
+    printf("no golden FAILED\n");
+  } else if (differing > 0) {
+    printf("%d pixels differ FAILED\n", differing);
+  } else if (!same_counts) {
+    printf("golden counts %s FAILED\n", counts.count(name) ? counts[name].c_str() : "missing");
+  } else {
+    printf("ok\n");
+  }
+  failures += !ok;
+}
+
+static void loadCounts() {
+  FILE *f = fopen((dir + "/render_counts.txt").c_str(), "r");
+  char name[64];
+  unsigned calls, pixels;
+  while (f != nullptr && fscanf(f, "%63s %u %u", name, &calls, &pixels) == 3) {
+    counts[name] = std::to_string(calls) + " " + std::to_string(pixels);
+  }
+  if (f != nullptr) {
+    fclose(f);
+  }
+}
+
+static void saveCounts() {
+  FILE *f = fopen((dir + "/render_counts.txt").c_str(), "w");
+  for (const auto &c : counts) {
+    fprintf(f, "%s %s\n", c.first.c_str(), c.second.c_str());
+  }
+  fclose(f);
+}
+
+// The default watchlist, one row up with its range known, one down, one closed
+static void textPages() {
+  watchlistSet("^SPX:SPX,^NDX:NDX,^TNX:T10");
+  watchlist[2].scale = 1000.0f;
+  watchlist[2].sep = '.';
+  refBind();
+  quotes[0] = makeQuote(5432.1, 5400.0, true, "USD");
+  quotes[1] = makeQuote(18750.5, 18900.0, true, "USD");
+  quotes[2] = makeQuote(4.256, 4.256, false, "");
+  reference r = { 5400.0, 5600.0, 4100.0, "USD", "EST", -5 * 3600 };
+  refStore(0, r, clockTime());
+  r = { 18900.0, 19000.0, 14500.0, "USD", "EST", -5 * 3600 };
+  refStore(1, r, clockTime());
+
+  renderFrameBegin();
+  drawStatusPage(false, "");
+  check("status_connecting");
+  renderFrameBegin();
+  drawStatusPage(true, "192.168.4.1");
+  check("status_portal");
+
+  renderFrameBegin();
+  drawValuesPage(true);
+  check("values");
+  quotes[1] = makeQuote(18950.0, 18900.0, true, "USD");
+  renderFrameBegin();
+  drawValuesPage(false);
+  check("values_update");
+
+  quotes[0] = makeQuote(5400.0, 5400.0, true, "USD");
+  renderFrameBegin();
+  drawChangePage(true);
+  check("change");
+}
+
+// Twelve symbols spread over the colour buckets, then one of them moving up a bucket
+static void heatmapPage() {
+  watchlistSet("AAPL,MSFT,NVDA,AMZN,GOOG,META,TSLA,BRK-B,JPM,V,XOM,VOD.L");
+  const double changes[] = { 0.2, 0.7, 1.5, 3.1, 0.0, -0.3, -0.8, -1.6, -4.2, 0.05, 0.0, 1.1 };
+  for (int i = 0; i < watchlist_count; i++) {
+    quotes[i] = makeQuote(100.0 * (1.0 + changes[i] / 100.0), 100.0, i != 10, "USD");
+  }
+  renderFrameBegin();
+  drawHeatmapPage(true);
+  check("heatmap");
+  quotes[0] = makeQuote(101.0, 100.0, true, "USD");
+  renderFrameBegin();
+  drawHeatmapPage(false);
+  check("heatmap_update");
+}
+
+// Positions in two currencies, both rates known, then one in a third with no rate
+static void portfolioPage() {
+  portfolioClear();
+  position p = { "AAPL", "USD", 120 * PORTFOLIO_SCALE, 150 * PORTFOLIO_SCALE };
+  portfolioAdd(p, 0);
+  p = { "SAP.DE", "EUR", 40 * PORTFOLIO_SCALE, 180 * PORTFOLIO_SCALE };
+  portfolioAdd(p, 1);
+  p = { "MSFT", "USD", 15 * PORTFOLIO_SCALE, 410 * PORTFOLIO_SCALE };
+  portfolioAdd(p, 2);
+  fxUpdate(fxCurrency("EUR"), 1.085);
+  portfolioUpdate(0, 227.35, 229.10);
+  portfolioUpdate(1, 201.40, 198.75);
+  portfolioUpdate(2, 415.20, 416.00);
+  renderFrameBegin();
+  drawPortfolioPage();
+  check("portfolio");
+
+  // A position entered in USD whose quote turns out to be in GBP, a currency with no rate yet
+  p = { "VOD.L", "USD", 2000 * PORTFOLIO_SCALE, 75 * PORTFOLIO_SCALE / 100 };
+  portfolioAdd(p, 3);
+  portfolioSetCurrency(3, "GBP");
+  portfolioUpdate(3, 0.7122, 0.7050);
+  renderFrameBegin();
+  drawPortfolioPage();
+  check("portfolio_unpriced");
+}
+
+// Two hours of a slow sine with noise, one sample a minute, then the same hours as candles
+static void chartPages() {
+  watchlistSet("^SPX:SPX,^NDX:NDX,^TNX:T10");
+  tsdbBegin(watchlist_count, 256 * 1024);
+  candlesBegin(watchlist_count);
+  uint32_t start = clockTime();
+  srand(7);
+  double price = 5400.0;
+  for (int m = 0; m < 120; m++) {
+    price += sin(m / 9.0) * 4.0 + (rand() % 100 - 50) / 25.0;
+    clockDelay(60 * 1000);
+    tsdbAppend(0, clockTime(), price);
+    for (int s = 0; s < 60; s += 20) {
+      candlesAdd(0, clockTime() + s, price + sin(s + m) * 3.0);
+    }
+  }
+  (void)start;
+  quotes[0] = makeQuote(price, 5400.0, true, "USD");
+
+  renderFrameBegin();
+  drawChartPage(0, ZOOM_HOURS);
+  check("chart");
+  renderFrameBegin();
+  drawCandlePage(0, CANDLE_5M, true);
+  check("candles");
+  candlesAdd(0, clockTime() + 59, price - 1.0);
+  quotes[0] = makeQuote(price - 1.0, 5400.0, true, "USD");
+  renderFrameBegin();
+  drawCandlePage(0, CANDLE_5M, false);
+  check("candles_update");
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--update") == 0) {
+      update = true;
+    } else {
+      dir = argv[i];
+    }
+  }
+  loadCounts();
+  virtual_epoch = 1718640000;               // 17 June 2024, 16:00 UTC
+  tft.init();
+  tft.setRotation(1);
+
+  textPages();
+  heatmapPage();
+  portfolioPage();
+  chartPages();
+
+  if (update) {
+    saveCounts();
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,520 @@
+// Replays a trading day through the complete firmware loop on Linux, much faster than real time.
+// src/main.cpp and the modules it calls are built unchanged against the stand-ins in tools/host,
+// with -D VIRTUAL_CLOCK so time only moves when the loop sleeps: the scheduler, the request
+// broker, parsing, the reference data, filters, history, candles, portfolio and every page
+// render run as on the device, and only the Wi-Fi link and the HTTP transport are replaced.
+// AsyncHttp is answered from a quote trace after the latency and with the status of a network
+// trace, both on the virtual clock; the provisioning state follows the trace's Wi-Fi events.
+// At the end it reports CPU time and heap allocations per stage, frames rendered, the fetch and
+// recovery counters and the radio schedule, and fails when nothing was fetched or drawn, when a
+// request went out with the radio in modem sleep or the listen interval lost track of how often
+// the fetches actually came, or when --budget is given and the loop spent more host CPU per
+// virtual hour than that.
+//
+// Quote trace, time ordered, '#' starts a comment:
+//   ref SYMBOL PREVIOUS_CLOSE YEAR_LOW YEAR_HIGH CURRENCY      once per symbol, before its ticks
+//   EPOCH_S SYMBOL PRICE                                       one tick
+// A symbol trades (marketState REGULAR) from its first tick to its last. Without --quotes a
+// regular session of the default watchlist on 17 June 2024 is made up, a tick every 5 s.
+// Network trace, offsets in s from the start of the replay (see tools/traces/):
+//   OFFSET latency MS | OFFSET status CODE (HTTP status, or an ahttp_error) | OFFSET wifi up|down |
+//   OFFSET rssi DBM
+//
+//   g++ -O2 -D ARDUINO=10812 -D VIRTUAL_CLOCK -D ARDUINOJSON_ENABLE_ARDUINO_STRING=0
+//       -D ARDUINOJSON_ENABLE_ARDUINO_STREAM=0 -D ARDUINOJSON_ENABLE_ARDUINO_PRINT=0
+//       -D ARDUINOJSON_ENABLE_PROGMEM=0 -I tools/host -I include
+//       -I .pio/libdeps/lilygo-t-dongle-s3/ArduinoJson/src -o replay_sim tools/replay_sim.cpp
+//       tools/host/device_standins.cpp src/main.cpp src/candle_page.cpp src/candles.cpp
+//       src/chart_page.cpp src/fetch_broker.cpp src/fx.cpp src/health.cpp src/heatmap_page.cpp
+//       src/log.cpp src/lttb.cpp src/metrics.cpp src/portfolio.cpp src/portfolio_page.cpp
+//       src/profile.cpp src/quote_filter.cpp src/quote_parser.cpp src/ref_data.cpp
+//       src/render_stats.cpp src/text_page.cpp src/tsdb.cpp src/usb_feed.cpp src/vclock.cpp
+//       src/watchlist.cpp src/wifi_power.cpp src/xxhash32.cpp -lpthread
+//       -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+//   ./replay_sim [--quotes FILE] [--network FILE] [--hours H] [--serial FILE] [--budget MS]
+// --serial keeps what the firmware writes to the USB port (log lines and binary feed frames).
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+
+#include "async_http.h"
+#include "fetch_broker.h"
+#include "health.h"
+#include "log.h"
+#include "metrics.h"
+#include "profile.h"
+#include "provisioning.h"
+#include "render_stats.h"
+#include "vclock.h"
+#include "wifi_power.h"
+
+void setup();
+void loop();
+extern bool have_quotes;
+
+// ------------------------------------------------------------------------------------
+typedef struct {
+  double previousClose, yearLow, yearHigh;
+  char currency[4];
+  std::vector<std::pair<time_t, double>> ticks;
+} symbol_trace;
+
+typedef struct {
+  uint32_t at;                              // s from the start
+  char what[8];
+  int value;
+} network_event;
+
+typedef struct {
+  uint32_t due;                             // clockMillis() when it completes
+  int status;
+  std::string url;
+} replay_request;
+
+const time_t SESSION_OPEN = 1718631000;     // 17 June 2024, 9:30 EDT
+const time_t SESSION_CLOSE = SESSION_OPEN + 390 * 60;
+const uint32_t ASSOCIATE_MS = 2000;         // Joining the network after it comes back or a restart
+const uint32_t CYCLE_GAP_MS = 1000;         // Requests further apart than this belong to separate fetches
+
+static std::map<std::string, symbol_trace> symbols;
+static std::vector<network_event> network;
+static size_t network_next = 0;
+static std::map<const AsyncHttp *, replay_request> requests;
+static time_t replay_start;
+
+// Conditions now, as the network trace last set them
+static uint32_t latency_ms = 150;
+static int http_status = 200;
+static bool wifi_up = true;
+
+static prov_state prov = PROV_CONNECTING;
+static unsigned long associate_at;
+
+static uint32_t http_requests = 0;
+static uint32_t http_failed = 0;
+static uint32_t http_asleep = 0;            // Sent with the radio in modem sleep
+static uint32_t fetch_cycles = 0;           // Bursts of requests, counted from the second one
+static uint32_t last_request_ms = 0;
+static uint32_t cycle_started_ms = 0;
+static uint64_t cycle_gaps_ms = 0;          // Between the starts of consecutive bursts
+static uint64_t loop_us = 0;
+static uint32_t loops = 0;
+// ------------------------------------------------------------------------------------
+
+// A made-up regular session: a random walk of the default watchlist, one tick every 5 s
+static void synthesize() {
+  const struct {
+    const char *symbol;
+    double close, low, high, step;
+  } made_up[] = {
+    { "^SPX", 5431.60, 4103.78, 5447.25, 0.6 },
+    { "^NDX", 19659.80, 14058.18, 19718.48, 3.0 },
+    { "^TNX", 4.220, 3.785, 4.997, 0.002 },
+  };
+  srand(17);
+  for (const auto &m : made_up) {
+    symbol_trace &s = symbols[m.symbol];
+    s.previousClose = m.close;
+    s.yearLow = m.low;
+    s.yearHigh = m.high;
+    strcpy(s.currency, "USD");
+    double price = m.close;
+    for (time_t t = SESSION_OPEN; t <= SESSION_CLOSE; t += 5) {
+      price += m.step * ((rand() % 2001) / 1000.0 - 1.0);
+      s.ticks.push_back({ t, price });
+    }
+  }
+}
+
+static bool loadQuotes(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f == nullptr) {
+    return false;
+  }
+  char line[256], sym[32], cur[8];
+  while (fgets(line, sizeof(line), f)) {
+    char *hash = strchr(line, '#');
+    if (hash) {
+      *hash = '\0';
+    }
+    double a, b, c;
+    long long t;
+    if (sscanf(line, "ref %31s %lf %lf %lf %3s", sym, &a, &b, &c, cur) == 5) {
+      symbol_trace &s = symbols[sym];
+      s.previousClose = a;
+      s.yearLow = b;
+      s.yearHigh = c;
+      strcpy(s.currency, cur);
+    } else if (sscanf(line, "%lld %31s %lf", &t, sym, &a) == 3) {
+      symbols[sym].ticks.push_back({ (time_t)t, a });
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static bool loadNetwork(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f == nullptr) {
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    network_event e = {};
+    char value[16];
+    if (sscanf(line, "%u %7s %15s", &e.at, e.what, value) == 3 && line[0] != '#') {
+      e.value = strcmp(value, "up") == 0 ? 1 : strcmp(value, "down") == 0 ? 0 : atoi(value);
+      network.push_back(e);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+// Take the network events that are due
+static void networkPoll() {
+  uint32_t offset = clockTime() - replay_start;
+  for (; network_next < network.size() && network[network_next].at <= offset; network_next++) {
+    const network_event &e = network[network_next];
+    if (strcmp(e.what, "latency") == 0) {
+      latency_ms = e.value;
+    } else if (strcmp(e.what, "status") == 0) {
+      http_status = e.value;
+    } else if (strcmp(e.what, "wifi") == 0) {
+      wifi_up = e.value != 0;
+    } else if (strcmp(e.what, "rssi") == 0) {
+      WiFi.rssi = e.value;
+    }
+  }
+}
+
+// ------------------------------------------------------------------------------------
+// Wi-Fi provisioning, as the network trace has it
+
+const char *PORTAL_AP_NAME = "T-Dongle-S3";
+
+void provisioningBegin() {
+  prov = PROV_CONNECTING;
+  associate_at = clockMillis() + ASSOCIATE_MS;
+}
+
+void provisioningPoll() {
+  if (!wifi_up) {
+    prov = PROV_CONNECTING;
+    associate_at = clockMillis() + ASSOCIATE_MS;
+  } else if (prov == PROV_CONNECTING && (long)(clockMillis() - associate_at) >= 0) {
+    prov = PROV_CONNECTED;
+    wifiPowerConfigure();
+  }
+}
+
+void provisioningRestart() {
+  provisioningBegin();
+}
+
+prov_state provisioningState() {
+  return prov;
+}
+
+// ------------------------------------------------------------------------------------
+// The HTTP transport, answering from the quote trace
+
+// Symbols of a Yahoo quote URL, decoded
+static std::vector<std::string> urlSymbols(const std::string &url) {
+  std::vector<std::string> out;
+  size_t p = url.find("symbols=");
+  std::string cur;
+  for (size_t i = p == std::string::npos ? url.size() : p + 8; i <= url.size(); i++) {
+    char c = i < url.size() ? url[i] : '&';
+    if (c == ',' || c == '&') {
+      if (!cur.empty()) {
+        out.push_back(cur);
+      }
+      cur.clear();
+      if (c == '&') {
+        break;
+      }
+    } else if (c == '%' && i + 2 < url.size()) {
+      cur += (char)strtol(url.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    } else {
+      cur += c;
+    }
+  }
+  return out;
+}
+
+// A Yahoo v7 response for the symbols of url at time now, with the reference fields if it asked for them
+static std::string quoteResponse(const std::string &url, time_t now) {
+  bool with_reference = url.find("regularMarketPreviousClose") != std::string::npos;
+  std::string body = "{\"quoteResponse\":{\"result\":[";
+  bool first = true;
+  for (const std::string &name : urlSymbols(url)) {
+    auto it = symbols.find(name);
+    if (it == symbols.end() || it->second.ticks.empty()) {
+      continue;
+    }
+    const symbol_trace &s = it->second;
+    double price = s.previousClose;
+    for (size_t i = 0; i < s.ticks.size() && s.ticks[i].first <= now; i++) {
+      price = s.ticks[i].second;
+    }
+    const char *state = now < s.ticks.front().first ? "PRE" : now <= s.ticks.back().first ? "REGULAR" : "POST";
+    char item[512];
+    int n = snprintf(item, sizeof(item),
+                     "%s{\"symbol\":\"%s\",\"regularMarketPrice\":%.4f,\"regularMarketChangePercent\":%.6f,"
+                     "\"marketState\":\"%s\"",
+                     first ? "" : ",", name.c_str(), price, (price / s.previousClose - 1.0) * 100.0, state);
+    if (with_reference) {
+      snprintf(item + n, sizeof(item) - n,
+               ",\"regularMarketPreviousClose\":%.4f,\"currency\":\"%s\",\"fiftyTwoWeekHigh\":%.4f,"
+               "\"fiftyTwoWeekLow\":%.4f,\"exchangeTimezoneShortName\":\"EDT\",\"gmtOffSetMilliseconds\":-14400000",
+               s.previousClose, s.currency, s.yearHigh, s.yearLow);
+    }
+    body += item;
+    body += "}";
+    first = false;
+  }
+  return body + "],\"error\":null}}";
+}
+
+AsyncHttp::AsyncHttp() {}
+
+AsyncHttp::~AsyncHttp() {
+  requests.erase(this);
+}
+
+bool AsyncHttp::get(const char *url, ahttp_sink sink, void *ctx, uint32_t now_ms) {
+  _sink = sink;
+  _ctx = ctx;
+  _received = 0;
+  _contentLength = -1;
+  _reused = false;
+  _status = 0;
+  http_requests++;
+  if (!wifi_up) {
+    http_failed++;
+    _state = AHTTP_FAILED;
+    _status = AHTTP_ERROR_CONNECT;
+    return false;
+  }
+  // The schedule: fetches start with the radio fully on, a burst of requests being one fetch
+  http_asleep += host_wifi_ps != WIFI_PS_NONE;
+  if (http_requests == 1 || now_ms - last_request_ms > CYCLE_GAP_MS) {
+    fetch_cycles += http_requests > 1;
+    cycle_gaps_ms += http_requests > 1 ? now_ms - cycle_started_ms : 0;
+    cycle_started_ms = now_ms;
+  }
+  last_request_ms = now_ms;
+
+  // A timeout takes the whole read timeout to show
+  uint32_t takes = http_status == AHTTP_ERROR_TIMEOUT ? _readTimeout : latency_ms;
+  requests[this] = { now_ms + takes, http_status, url };
+  _state = AHTTP_SENDING;
+  return true;
+}
+
+ahttp_state AsyncHttp::poll(uint32_t now_ms) {
+  auto it = requests.find(this);
+  if (!busy() || it == requests.end() || (int32_t)(now_ms - it->second.due) < 0) {
+    return _state;
+  }
+  replay_request r = it->second;
+  requests.erase(it);
+  if (r.status < 0 || !wifi_up) {
+    http_failed++;
+    _status = r.status < 0 ? r.status : AHTTP_ERROR_RECEIVE;
+    _state = AHTTP_FAILED;
+    return _state;
+  }
+  std::string body = r.status == 200 ? quoteResponse(r.url, clockTime())
+                                     : "{\"finance\":{\"result\":null,\"error\":{\"code\":\"Too Many Requests\"}}}";
+  _status = r.status;
+  _contentLength = body.size();
+  if (!_sink(_ctx, (const uint8_t *)body.data(), body.size())) {
+    http_failed++;
+    _status = AHTTP_ERROR_SINK;
+    _state = AHTTP_FAILED;
+    return _state;
+  }
+  _received = body.size();
+  _state = AHTTP_DONE;
+  return _state;
+}
+
+void AsyncHttp::stop() {
+  requests.erase(this);
+  _state = AHTTP_IDLE;
+}
+
+bool AsyncHttp::wantsWrite() const {
+  return false;
+}
+
+bool AsyncHttp::readable() const {
+  return false;
+}
+
+// Sleeping moves the virtual clock to the first request due, or by timeout_ms
+int asyncHttpWait(AsyncHttp *const *waiting, int count, uint32_t timeout_ms) {
+  uint32_t now = clockMillis(), until = now + timeout_ms;
+  for (int i = 0; i < count; i++) {
+    auto it = requests.find(waiting[i]);
+    if (it != requests.end() && (int32_t)(it->second.due - until) < 0) {
+      until = (int32_t)(it->second.due - now) > 0 ? it->second.due : now;
+    }
+  }
+  clockAdvance((uint64_t)(until - now) * 1000);
+  int ready = 0;
+  for (int i = 0; i < count; i++) {
+    auto it = requests.find(waiting[i]);
+    ready += it != requests.end() && (int32_t)(clockMillis() - it->second.due) >= 0;
+  }
+  return ready;
+}
+
+const char *asyncHttpErrorName(int status) {
+  switch (status) {
+    case AHTTP_ERROR_URL: return "bad URL";
+    case AHTTP_ERROR_DNS: return "DNS lookup failed";
+    case AHTTP_ERROR_CONNECT: return "connect failed";
+    case AHTTP_ERROR_TLS: return "TLS handshake failed";
+    case AHTTP_ERROR_SEND: return "send failed";
+    case AHTTP_ERROR_RECEIVE: return "receive failed";
+    case AHTTP_ERROR_CLOSED: return "connection closed";
+    case AHTTP_ERROR_PROTOCOL: return "protocol error";
+    case AHTTP_ERROR_TIMEOUT: return "timeout";
+    case AHTTP_ERROR_SINK: return "response too large";
+    default: return "unknown error";
+  }
+}
+
+// ------------------------------------------------------------------------------------
+
+static double hours = 0.0;
+static double budget_ms = 0.0;
+static int64_t wall_started;
+
+static void report() {
+  static bool done = false;
+  if (done) {
+    return;
+  }
+  done = true;
+  double virtual_h = (clockTime() - replay_start) / 3600.0;
+  double wall_s = (esp_timer_get_time() - wall_started) / 1e6;
+  printf("Replayed %.2f h in %.2f s (%.0fx real time), %u loop iterations, %.1f ms host CPU per virtual hour\n",
+         virtual_h, wall_s, virtual_h * 3600.0 / (wall_s > 0 ? wall_s : 1e-9), loops,
+         virtual_h > 0 ? loop_us / 1000.0 / virtual_h : 0.0);
+  printf("%-8s %8s %10s %12s %12s\n", "stage", "calls", "CPU ms", "us/call", "allocations");
+  for (int s = 0; s < STAGE_COUNT; s++) {
+    const stage_stats &st = stage_totals[s];
+    printf("%-8s %8u %10.1f %12.1f %12u\n", STAGE_NAMES[s], st.calls, st.us / 1000.0,
+           st.calls ? (double)st.us / st.calls : 0.0, st.allocs);
+  }
+  printf("frames   %u rendered, %u skipped, %llu draw calls, %llu pixels, largest %u pixels\n", render_total.frames,
+         metrics.framesSkipped, (unsigned long long)render_total.calls, (unsigned long long)render_total.pixels,
+         render_total.maxPixels);
+  const broker_stats &b = brokerStats();
+  printf("fetch    %u cycles (%u failed), %u HTTP requests (%u failed), %u throttled, %u parsed (%u errors), "
+         "%u unchanged\n",
+         metrics.fetches, metrics.fetchErrors, http_requests, http_failed, b.throttled, metrics.parses,
+         metrics.parseErrors, metrics.unchanged);
+  const health_counters &h = healthCounters();
+  printf("recovery %u aborts, %u socket resets, %u Wi-Fi restarts\n", h.steps[RECOVER_ABORT], h.steps[RECOVER_SOCKET],
+         h.steps[RECOVER_WIFI]);
+  printf("wifi     radio on %u ms per hour, %u power save changes, listen interval %u\n", wifiPowerRadioOnPerHour(),
+         host_wifi_ps_changes, host_wifi_config.sta.listen_interval);
+  printf("schedule %u fetches, every %.1f s on average, %u requests with the radio asleep, listen interval %u "
+         "for the next association\n",
+         fetch_cycles, fetch_cycles ? cycle_gaps_ms / 1000.0 / fetch_cycles : 0.0, http_asleep,
+         wifiPowerListenInterval());
+  printf("log      %u messages dropped\n", logDropped());
+  fflush(stdout);
+}
+
+static bool expect(bool ok, const char *what) {
+  printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  const char *quotes_path = nullptr, *network_path = nullptr, *serial_path = "/dev/null";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--quotes") == 0) {
+      quotes_path = argv[i + 1];
+    } else if (strcmp(argv[i], "--network") == 0) {
+      network_path = argv[i + 1];
+    } else if (strcmp(argv[i], "--hours") == 0) {
+      hours = atof(argv[i + 1]);
+    } else if (strcmp(argv[i], "--serial") == 0) {
+      serial_path = argv[i + 1];
+    } else if (strcmp(argv[i], "--budget") == 0) {
+      budget_ms = atof(argv[i + 1]);
+    }
+  }
+  if (quotes_path == nullptr) {
+    synthesize();
+  } else if (!loadQuotes(quotes_path)) {
+    fprintf(stderr, "Cannot read %s\n", quotes_path);
+    return 2;
+  }
+  if (network_path && !loadNetwork(network_path)) {
+    fprintf(stderr, "Cannot read %s\n", network_path);
+    return 2;
+  }
+
+  // From half an hour before the first tick to half an hour after the last
+  time_t first = 0, last = 0;
+  for (const auto &s : symbols) {
+    if (!s.second.ticks.empty()) {
+      first = first && first < s.second.ticks.front().first ? first : s.second.ticks.front().first;
+      last = last > s.second.ticks.back().first ? last : s.second.ticks.back().first;
+    }
+  }
+  replay_start = first - 1800;
+  time_t replay_end = hours > 0 ? replay_start + (time_t)(hours * 3600) : last + 1800;
+  virtual_epoch = replay_start;
+  Serial.out = fopen(serial_path, "wb");
+  if (Serial.out == nullptr) {
+    fprintf(stderr, "Cannot write %s\n", serial_path);
+    return 2;
+  }
+  atexit(report);                           // Also when the recovery ladder reboots the board
+  wall_started = esp_timer_get_time();
+
+  networkPoll();
+  setup();
+  while (clockTime() < replay_end) {
+    networkPoll();
+    int64_t t0 = esp_timer_get_time();
+    loop();
+    loop_us += esp_timer_get_time() - t0;
+    loops++;
+  }
+  report();
+
+  double per_hour = loop_us / 1000.0 / ((replay_end - replay_start) / 3600.0);
+  bool ok = expect(have_quotes && metrics.fetches > 0, "quotes fetched");
+  ok &= expect(render_total.frames > 0, "pages rendered");
+  ok &= expect(http_asleep == 0, "radio awake for every request");
+  double interval_ms = fetch_cycles ? (double)cycle_gaps_ms / fetch_cycles : 0.0;
+  int beacons = constrain((int)(interval_ms / 102.4 / 2), 1, 10);
+  ok &= expect(abs(wifiPowerListenInterval() - beacons) <= 1, "listen interval follows the fetch interval");
+  if (budget_ms > 0) {
+    ok &= expect(per_hour <= budget_ms, "loop CPU within the budget");
+  }
+  fflush(Serial.out);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+// Compression ratio and encode/decode speed of the tick history (src/tsdb.cpp) against
+// the naive layout of one timestamp and one double per sample.
+//   g++ -O2 -I include -o tsdb_bench tools/tsdb_bench.cpp src/tsdb.cpp
+//   ./tsdb_bench [symbols] [days]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <random>
+#include <vector>
+
+#include "../include/tsdb.h"
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  int symbols = argc > 1 ? atoi(argv[1]) : 50;
+  int days = argc > 2 ? atoi(argv[2]) : 3;
+  const int MINUTES = 1440;
+  int samples = days * MINUTES;
+
+  // Random walks at 1-minute resolution, moving only during the 390 minute session
+  std::mt19937 rng(42);
+  std::normal_distribution<double> step(0.0, 1.0);
+  std::vector<std::vector<double>> prices(symbols, std::vector<double>(samples));
+  for (int s = 0; s < symbols; s++) {
+    double p = 10.0 + s * 97.0;
+    for (int i = 0; i < samples; i++) {
+      if (i % MINUTES < 390) p = fmax(0.01, p + step(rng) * p * 0.0005);
+      prices[s][i] = round(p * 100) / 100;
+    }
+  }
+
+  size_t naive = (size_t)symbols * samples * TSDB_NAIVE_SAMPLE_BYTES;
+  if (!tsdbBegin(symbols, naive)) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  uint32_t t0 = 1700000000;
+  double start = nowNs();
+  for (int i = 0; i < samples; i++) {
+    for (int s = 0; s < symbols; s++) tsdbAppend(s, t0 + i * 60, prices[s][i]);
+  }
+  double encoded = nowNs();
+
+  long decoded = 0, mismatches = 0;
+  for (int s = 0; s < symbols; s++) {
+    TsdbReader reader(s);
+    uint32_t t;
+    double v;
+    int i = samples - tsdbCount(s);
+    while (reader.next(t, v)) {
+      if (t != t0 + (uint32_t)i * 60 || fabs(v - prices[s][i]) > 1e-9) mismatches++;
+      i++;
+      decoded++;
+    }
+  }
+  double done = nowNs();
+
+  tsdb_stats st = tsdbStats();
+  printf("%d symbols x %d days of 1-minute samples\n", symbols, days);
+  printf("naive:      %zu bytes\n", naive);
+  printf("compressed: %u bytes in %u blocks, %.2f bits/sample, ratio %.1fx\n",
+         st.bytes, st.blocks, st.bytes * 8.0 / st.samples, (double)naive / st.bytes);
+  printf("encode:     %.1f ns/sample\n", (encoded - start) / ((double)symbols * samples));
+  printf("decode:     %.1f ns/sample (%ld samples, %ld mismatches)\n", (done - encoded) / decoded, decoded, mismatches);
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// CPU saved by skipping identical responses (see getQuotes() in src/main.cpp) over a simulated
+// weekend: the same Yahoo response polled every 4 s for 48 hours, streamed in TCP sized chunks.
+// Compares hashing each body against parsing it every time.
+//   g++ -O2 -I include -I .pio/libdeps/lilygo-t-dongle-s3/ArduinoJson/src -o unchanged_bench
+//     tools/unchanged_bench.cpp src/quote_parser.cpp src/xxhash32.cpp
+//   ./unchanged_bench [symbols] [hours]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "../include/quote_parser.h"
+#include "../include/xxhash32.h"
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// A response shaped like Yahoo's, including the fields the parser filters out
+static std::string makeResponse(int symbols) {
+  std::string body = "{\"quoteResponse\":{\"result\":[";
+  char item[768];
+  for (int i = 0; i < symbols; i++) {
+    snprintf(item, sizeof(item),
+             "%s{\"language\":\"en-US\",\"region\":\"US\",\"quoteType\":\"EQUITY\",\"currency\":\"USD\","
+             "\"marketState\":\"CLOSED\",\"exchange\":\"NMS\",\"shortName\":\"Symbol %d Inc.\","
+             "\"regularMarketChange\":-1.25,\"regularMarketChangePercent\":-0.%02d,"
+             "\"regularMarketTime\":1700251200,\"regularMarketPrice\":%d.%02d,"
+             "\"regularMarketDayHigh\":%d.5,\"regularMarketDayLow\":%d.1,\"regularMarketVolume\":%d,"
+             "\"regularMarketPreviousClose\":%d.75,\"fiftyTwoWeekLow\":%d.0,\"fiftyTwoWeekHigh\":%d.0,"
+             "\"exchangeTimezoneName\":\"America/New_York\",\"symbol\":\"SYM%d\"}",
+             i ? "," : "", i, i % 100, 100 + i, i % 100, 100 + i, 99 + i, 1000000 + i, 101 + i, 80 + i, 130 + i, i);
+    body += item;
+  }
+  body += "],\"error\":null}}";
+  return body;
+}
+
+int main(int argc, char **argv) {
+  int symbols = argc > 1 ? atoi(argv[1]) : 3;
+  int hours = argc > 2 ? atoi(argv[2]) : 48;
+  const int POLL_S = 4;
+  const size_t CHUNK = 1436;                // One TCP segment of payload
+  int polls = hours * 3600 / POLL_S;
+
+  std::string body = makeResponse(symbols);
+  std::vector<std::string> names(symbols);
+  std::vector<const char *> syms(symbols);
+  for (int i = 0; i < symbols; i++) {
+    names[i] = "SYM" + std::to_string(i);
+    syms[i] = names[i].c_str();
+  }
+  std::vector<quote> out(symbols);
+  bool *updated = new bool[symbols];
+
+  // Parse every response
+  double start = nowNs();
+  int parsed_ok = 0;
+  for (int p = 0; p < polls; p++) {
+    if (parseQuotes(body.data(), body.size(), syms.data(), symbols, out.data(), updated) == PARSE_OK) {
+      parsed_ok++;
+    }
+  }
+  double parse_ns = nowNs() - start;
+
+  // Hash each response as it streams in, parse only the first
+  start = nowNs();
+  uint32_t last = 0;
+  int parses = 0;
+  for (int p = 0; p < polls; p++) {
+    XXHash32 h;
+    for (size_t o = 0; o < body.size(); o += CHUNK) {
+      h.update(body.data() + o, body.size() - o < CHUNK ? body.size() - o : CHUNK);
+    }
+    uint32_t d = h.digest();
+    if (p == 0 || d != last) {
+      parseQuotes(body.data(), body.size(), syms.data(), symbols, out.data(), updated);
+      parses++;
+      last = d;
+    }
+  }
+  double hash_ns = nowNs() - start;
+
+  printf("%d symbols, %zu byte response, %d polls over %d hours (%d parsed ok)\n", symbols, body.size(), polls,
+         hours, parsed_ok);
+  printf("parse every time: %8.1f ms, %6.2f us per poll\n", parse_ns / 1e6, parse_ns / 1e3 / polls);
+  printf("hash, skip same:  %8.1f ms, %6.2f us per poll (%d parsed)\n", hash_ns / 1e6, hash_ns / 1e3 / polls, parses);
+  printf("saved %.1f%% of the parse CPU\n", 100.0 * (1.0 - hash_ns / parse_ns));
+  delete[] updated;
+  return 0;
+}